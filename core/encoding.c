@@ -32,7 +32,7 @@ static int32_t base32_encode_call(hk_state_t *state, hk_value_t *args)
   hk_string_t *result = hk_string_new_with_capacity(length);
   result->length = length;
   result->chars[result->length] = '\0';
-  base32_encode((unsigned char *) str->chars, str->length, (unsigned char *) result->chars);
+  base32_encode((unsigned char *) hk_string_chars(str), str->length, (unsigned char *) result->chars);
   if (hk_state_push_string(state, result) == HK_STATUS_ERROR)
   {
     hk_string_free(result);
@@ -47,7 +47,7 @@ static int32_t base32_decode_call(hk_state_t *state, hk_value_t *args)
     return HK_STATUS_ERROR;
   hk_string_t *str = hk_as_string(args[1]);
   hk_string_t *result = hk_string_new_with_capacity(UNBASE32_LEN(str->length));
-  int32_t length = (int32_t) base32_decode((unsigned char *) str->chars,
+  int32_t length = (int32_t) base32_decode((unsigned char *) hk_string_chars(str),
     (unsigned char *) result->chars);
   result->length = length;
   result->chars[length] = '\0';
@@ -66,7 +66,7 @@ static int32_t base58_encode_call(hk_state_t *state, hk_value_t *args)
   hk_string_t *str = hk_as_string(args[1]);
   hk_string_t *result = hk_string_new_with_capacity(BASE58_ENCODE_OUT_SIZE(str->length));
   size_t out_len;
-  (void) base58_encode(str->chars, str->length, result->chars, &out_len);
+  (void) base58_encode(hk_string_chars(str), str->length, result->chars, &out_len);
   result->length = (int32_t) out_len;
   result->chars[result->length] = '\0';
   if (hk_state_push_string(state, result) == HK_STATUS_ERROR)
@@ -84,7 +84,7 @@ static int32_t base58_decode_call(hk_state_t *state, hk_value_t *args)
   hk_string_t *str = hk_as_string(args[1]);
   hk_string_t *result = hk_string_new_with_capacity(BASE58_DECODE_OUT_SIZE(str->length));
   size_t out_len;
-  (void) base58_decode(str->chars, str->length, result->chars, &out_len);
+  (void) base58_decode(hk_string_chars(str), str->length, result->chars, &out_len);
   result->length = (int32_t) out_len;
   result->chars[result->length] = '\0';
   if (hk_state_push_string(state, result) == HK_STATUS_ERROR)
@@ -104,7 +104,7 @@ static int32_t base64_encode_call(hk_state_t *state, hk_value_t *args)
   hk_string_t *result = hk_string_new_with_capacity(length);
   result->length = length;
   result->chars[length] = '\0';
-  (void) base64_encode((unsigned char *) str->chars, str->length, result->chars);
+  (void) base64_encode((unsigned char *) hk_string_chars(str), str->length, result->chars);
   if (hk_state_push_string(state, result) == HK_STATUS_ERROR)
   {
     hk_string_free(result);
@@ -122,7 +122,7 @@ static int32_t base64_decode_call(hk_state_t *state, hk_value_t *args)
   hk_string_t *result = hk_string_new_with_capacity(length);
   result->length = length;
   result->chars[length] = '\0';
-  (void) base64_decode(str->chars, str->length, (unsigned char *) result->chars);
+  (void) base64_decode(hk_string_chars(str), str->length, (unsigned char *) result->chars);
   if (hk_state_push_string(state, result) == HK_STATUS_ERROR)
   {
     hk_string_free(result);
@@ -138,7 +138,7 @@ static int32_t ascii85_encode_call(hk_state_t *state, hk_value_t *args)
   hk_string_t *str = hk_as_string(args[1]);
   int32_t max_length = ascii85_get_max_encoded_length(str->length);
   hk_string_t *result = hk_string_new_with_capacity(max_length);
-  int32_t length = encode_ascii85((const uint8_t *) str->chars, str->length, (uint8_t *) result->chars, max_length);
+  int32_t length = encode_ascii85((const uint8_t *) hk_string_chars(str), str->length, (uint8_t *) result->chars, max_length);
   result->length = length;
   result->chars[length] = '\0';
   if (hk_state_push_string(state, result) == HK_STATUS_ERROR)
@@ -156,7 +156,7 @@ static int32_t ascii85_decode_call(hk_state_t *state, hk_value_t *args)
   hk_string_t *str = hk_as_string(args[1]);
   int32_t max_length = ascii85_get_max_decoded_length(str->length);
   hk_string_t *result = hk_string_new_with_capacity(max_length);
-  int32_t length = decode_ascii85((const uint8_t *) str->chars, str->length, (uint8_t *) result->chars, max_length);
+  int32_t length = decode_ascii85((const uint8_t *) hk_string_chars(str), str->length, (uint8_t *) result->chars, max_length);
   result->length = length;
   result->chars[length] = '\0';
   if (hk_state_push_string(state, result) == HK_STATUS_ERROR)
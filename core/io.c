@@ -69,7 +69,7 @@ static int32_t open_call(hk_state_t *state, hk_value_t *args)
     return HK_STATUS_ERROR;
   hk_string_t *filename = hk_as_string(args[1]);
   hk_string_t *mode = hk_as_string(args[2]);
-  FILE *stream = fopen(filename->chars, mode->chars);
+  FILE *stream = fopen(hk_string_chars(filename), hk_string_chars(mode));
   if (!stream)
     return hk_state_push_nil(state);
   return hk_state_push_userdata(state, (hk_userdata_t *) file_new(stream));
@@ -91,7 +91,7 @@ static int32_t popen_call(hk_state_t *state, hk_value_t *args)
   hk_string_t *command = hk_as_string(args[1]);
   hk_string_t *mode = hk_as_string(args[2]);
   FILE *stream;
-  stream = popen(command->chars, mode->chars);
+  stream = popen(hk_string_chars(command), hk_string_chars(mode));
   if (!stream)
     return hk_state_push_nil(state);
   return hk_state_push_userdata(state, (hk_userdata_t *) file_new(stream));
@@ -203,7 +203,7 @@ static int32_t write_call(hk_state_t *state, hk_value_t *args)
   FILE *stream = ((file_t *) hk_as_userdata(args[1]))->stream;
   hk_string_t *str = hk_as_string(args[2]);
   size_t size = str->length;
-  if (fwrite(str->chars, 1, size, stream) < size)
+  if (fwrite(hk_string_chars(str), 1, size, stream) < size)
     return hk_state_push_nil(state);
   return hk_state_push_number(state, size);
 }
@@ -225,7 +225,7 @@ static int32_t writeln_call(hk_state_t *state, hk_value_t *args)
   FILE *stream = ((file_t *) hk_as_userdata(args[1]))->stream;
   hk_string_t *str = hk_as_string(args[2]);
   size_t size = str->length;
-  if (fwrite(str->chars, 1, size, stream) < size || fwrite("\n", 1, 1, stream) < 1)
+  if (fwrite(hk_string_chars(str), 1, size, stream) < size || fwrite("\n", 1, 1, stream) < 1)
     return hk_state_push_nil(state);
   return hk_state_push_number(state, size + 1);
 }
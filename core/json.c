@@ -18,7 +18,7 @@ static int32_t decode_call(hk_state_t *state, hk_value_t *args);
 static inline cJSON *value_to_json(hk_value_t val)
 {
   cJSON *json;
-  switch (val.type)
+  switch (hk_type(val))
   {
   case HK_TYPE_NIL:
     json = cJSON_CreateNull();
@@ -30,7 +30,7 @@ static inline cJSON *value_to_json(hk_value_t val)
     json = cJSON_CreateNumber(hk_as_number(val));
     break;
   case HK_TYPE_STRING:
-    json = cJSON_CreateString(hk_as_string(val)->chars);
+    json = cJSON_CreateString(hk_string_chars(hk_as_string(val)));
     break;
   case HK_TYPE_RANGE:
   case HK_TYPE_STRUCT:
@@ -62,7 +62,7 @@ static inline cJSON *value_to_json(hk_value_t val)
         hk_field_t field = fields[i];
         hk_value_t val = inst->values[i];
         cJSON *json_val = value_to_json(val);
-        hk_assert(cJSON_AddItemToObject(json, field.name->chars, json_val), "Failed to add item to object.");
+        hk_assert(cJSON_AddItemToObject(json, hk_string_chars(field.name), json_val), "Failed to add item to object.");
       }
     }
     break;
@@ -154,7 +154,7 @@ static int32_t decode_call(hk_state_t *state, hk_value_t *args)
   if (hk_check_argument_string(args, 1) == HK_STATUS_ERROR)
     return HK_STATUS_ERROR;
   hk_string_t *str = hk_as_string(args[1]);
-  cJSON *json = cJSON_ParseWithLength(str->chars, str->length);
+  cJSON *json = cJSON_ParseWithLength(hk_string_chars(str), str->length);
   if (!json)
   {
     hk_runtime_error("cannot parse json");
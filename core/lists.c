@@ -31,11 +31,14 @@ static inline linked_list_t *linked_list_copy(linked_list_t *list);
 static inline void linked_list_inplace_push_front(linked_list_t *list, hk_value_t elem);
 static inline void linked_list_inplace_push_back(linked_list_t *list, hk_value_t elem);
 static void linked_list_deinit(hk_userdata_t *udata);
+static void linked_list_traverse(hk_userdata_t *udata, void (*visit)(hk_value_t));
 static int32_t new_linked_list_call(hk_state_t *state, hk_value_t *args);
 static int32_t len_call(hk_state_t *state, hk_value_t *args);
 static int32_t is_empty_call(hk_state_t *state, hk_value_t *args);
 static int32_t push_front_call(hk_state_t *state, hk_value_t *args);
 static int32_t push_back_call(hk_state_t *state, hk_value_t *args);
+static int32_t inplace_push_front_call(hk_state_t *state, hk_value_t *args);
+static int32_t inplace_push_back_call(hk_state_t *state, hk_value_t *args);
 static int32_t pop_front_call(hk_state_t *state, hk_value_t *args);
 static int32_t pop_back_call(hk_state_t *state, hk_value_t *args);
 static int32_t front_call(hk_state_t *state, hk_value_t *args);
@@ -54,13 +57,14 @@ static inline linked_list_node_t *linked_list_node_new(hk_value_t elem)
 static inline void linked_list_node_free(linked_list_node_t *node)
 {
   hk_value_release(node->elem);
-  free(node);
+  hk_free(node);
 }
 
 static inline linked_list_t *linked_list_new(void)
 {
   linked_list_t *list = (linked_list_t *) hk_allocate(sizeof(*list));
   hk_userdata_init((hk_userdata_t *) list, &linked_list_deinit);
+  list->traverse = &linked_list_traverse;
   list->length = 0;
   list->head = NULL;
   list->tail = NULL;
@@ -123,6 +127,13 @@ static void linked_list_deinit(hk_userdata_t *udata)
   }
 }
 
+static void linked_list_traverse(hk_userdata_t *udata, void (*visit)(hk_value_t))
+{
+  linked_list_t *list = (linked_list_t *) udata;
+  for (linked_list_node_t *node = list->head; node; node = node->next)
+    visit(node->elem);
+}
+
 static int32_t new_linked_list_call(hk_state_t *state, hk_value_t *args)
 {
   (void) args;
@@ -167,6 +178,24 @@ static int32_t push_back_call(hk_state_t *state, hk_value_t *args)
   return hk_state_push_userdata(state, (hk_userdata_t *) result);
 }
 
+static int32_t inplace_push_front_call(hk_state_t *state, hk_value_t *args)
+{
+  if (hk_check_argument_userdata(args, 1) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  linked_list_t *list = (linked_list_t *) hk_as_userdata(args[1]);
+  linked_list_inplace_push_front(list, args[2]);
+  return hk_state_push_nil(state);
+}
+
+static int32_t inplace_push_back_call(hk_state_t *state, hk_value_t *args)
+{
+  if (hk_check_argument_userdata(args, 1) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  linked_list_t *list = (linked_list_t *) hk_as_userdata(args[1]);
+  linked_list_inplace_push_back(list, args[2]);
+  return hk_state_push_nil(state);
+}
+
 static int32_t pop_front_call(hk_state_t *state, hk_value_t *args)
 {
   if (hk_check_argument_userdata(args, 1) == HK_STATUS_ERROR)
@@ -245,6 +274,14 @@ HK_LOAD_FN(lists)
     return HK_STATUS_ERROR;
   if (hk_state_push_new_native(state, "push_back", 2, &push_back_call) == HK_STATUS_ERROR)
     return HK_STATUS_ERROR;
+  if (hk_state_push_string_from_chars(state, -1, "inplace_push_front") == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_new_native(state, "inplace_push_front", 2, &inplace_push_front_call) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_string_from_chars(state, -1, "inplace_push_back") == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_new_native(state, "inplace_push_back", 2, &inplace_push_back_call) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
   if (hk_state_push_string_from_chars(state, -1, "pop_front") == HK_STATUS_ERROR)
     return HK_STATUS_ERROR;
   if (hk_state_push_new_native(state, "pop_front", 1, &pop_front_call) == HK_STATUS_ERROR)
@@ -261,5 +298,5 @@ HK_LOAD_FN(lists)
     return HK_STATUS_ERROR;
   if (hk_state_push_new_native(state, "back", 1, &back_call) == HK_STATUS_ERROR)
     return HK_STATUS_ERROR;
-  return hk_state_construct(state, 9);
+  return hk_state_construct(state, 11);
 }
@@ -0,0 +1,127 @@
+//
+// The Hook Programming Language
+// memory.c
+//
+
+#include "memory.h"
+#include <hook/memory.h>
+#include <hook/check.h>
+#include <hook/status.h>
+
+static const struct
+{
+  const char *name;
+  hk_type_t type;
+} types[] = {
+  {"string", HK_TYPE_STRING},
+  {"array", HK_TYPE_ARRAY},
+  {"struct", HK_TYPE_STRUCT},
+  {"instance", HK_TYPE_INSTANCE},
+  {"closure", HK_TYPE_CALLABLE},
+  {"userdata", HK_TYPE_USERDATA}
+};
+
+static inline int32_t push_counters(hk_state_t *state, int64_t *counters);
+static int32_t used_call(hk_state_t *state, hk_value_t *args);
+static int32_t peak_call(hk_state_t *state, hk_value_t *args);
+static int32_t limit_call(hk_state_t *state, hk_value_t *args);
+static int32_t set_limit_call(hk_state_t *state, hk_value_t *args);
+static int32_t stats_call(hk_state_t *state, hk_value_t *args);
+
+static inline int32_t push_counters(hk_state_t *state, int64_t *counters)
+{
+  int32_t length = (int32_t) (sizeof(types) / sizeof(*types));
+  if (hk_state_push_nil(state) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  for (int32_t i = 0; i < length; ++i)
+  {
+    if (hk_state_push_string_from_chars(state, -1, types[i].name) == HK_STATUS_ERROR)
+      return HK_STATUS_ERROR;
+    if (hk_state_push_number(state, (double) counters[types[i].type]) == HK_STATUS_ERROR)
+      return HK_STATUS_ERROR;
+  }
+  return hk_state_construct(state, length);
+}
+
+static int32_t used_call(hk_state_t *state, hk_value_t *args)
+{
+  (void) args;
+  return hk_state_push_number(state, (double) hk_memory()->used);
+}
+
+static int32_t peak_call(hk_state_t *state, hk_value_t *args)
+{
+  (void) args;
+  return hk_state_push_number(state, (double) hk_memory()->peak);
+}
+
+static int32_t limit_call(hk_state_t *state, hk_value_t *args)
+{
+  (void) args;
+  return hk_state_push_number(state, (double) hk_memory()->limit);
+}
+
+static int32_t set_limit_call(hk_state_t *state, hk_value_t *args)
+{
+  if (hk_check_argument_int(args, 1) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  double limit = hk_as_number(args[1]);
+  hk_memory()->limit = limit > 0 ? (int64_t) limit : 0;
+  return hk_state_push_nil(state);
+}
+
+static int32_t stats_call(hk_state_t *state, hk_value_t *args)
+{
+  (void) args;
+  hk_memory_t *memory = hk_memory();
+  if (hk_state_push_nil(state) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_string_from_chars(state, -1, "used") == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_number(state, (double) memory->used) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_string_from_chars(state, -1, "peak") == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_number(state, (double) memory->peak) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_string_from_chars(state, -1, "limit") == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_number(state, (double) memory->limit) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_string_from_chars(state, -1, "objects") == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (push_counters(state, memory->objects) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_string_from_chars(state, -1, "bytes") == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (push_counters(state, memory->bytes) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  return hk_state_construct(state, 5);
+}
+
+HK_LOAD_FN(memory)
+{
+  if (hk_state_push_string_from_chars(state, -1, "memory") == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_string_from_chars(state, -1, "used") == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_new_native(state, "used", 0, &used_call) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_string_from_chars(state, -1, "peak") == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_new_native(state, "peak", 0, &peak_call) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_string_from_chars(state, -1, "limit") == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_new_native(state, "limit", 0, &limit_call) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_string_from_chars(state, -1, "set_limit") == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_new_native(state, "set_limit", 1, &set_limit_call) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_string_from_chars(state, -1, "stats") == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_new_native(state, "stats", 0, &stats_call) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  return hk_state_construct(state, 5);
+}
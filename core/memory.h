@@ -0,0 +1,14 @@
+//
+// The Hook Programming Language
+// memory.h
+//
+
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <hook/state.h>
+#include <hook/utils.h>
+
+HK_LOAD_FN(memory);
+
+#endif // MEMORY_H
@@ -41,14 +41,14 @@ static int32_t system_call(hk_state_t *state, hk_value_t *args)
 {
   if (hk_check_argument_string(args, 1) == HK_STATUS_ERROR)
     return HK_STATUS_ERROR;
-  return hk_state_push_number(state, system(hk_as_string(args[1])->chars));
+  return hk_state_push_number(state, system(hk_string_chars(hk_as_string(args[1]))));
 }
 
 static int32_t getenv_call(hk_state_t *state, hk_value_t *args)
 {
   if (hk_check_argument_string(args, 1) == HK_STATUS_ERROR)
     return HK_STATUS_ERROR;
-  const char *chars = getenv(hk_as_string(args[1])->chars);
+  const char *chars = getenv(hk_string_chars(hk_as_string(args[1])));
   chars = chars ? chars : "";
   return hk_state_push_string_from_chars(state, -1, chars);
 }
@@ -41,7 +41,7 @@ static int32_t new_call(hk_state_t *state, hk_value_t *args)
     return HK_STATUS_ERROR;
   hk_string_t *pattern = hk_as_string(args[1]);
   regex_t regex;
-  int32_t errcode = regcomp(&regex, pattern->chars, REG_EXTENDED);
+  int32_t errcode = regcomp(&regex, hk_string_chars(pattern), REG_EXTENDED);
   if (errcode)
   {
     char errbuf[1024];
@@ -61,7 +61,7 @@ static int32_t find_call(hk_state_t *state, hk_value_t *args)
   regex_wrapper_t *wrapper = (regex_wrapper_t *) hk_as_userdata(args[1]);
   hk_string_t *str = hk_as_string(args[2]);
   regmatch_t match;
-  int32_t errcode = regexec(&wrapper->regex, str->chars, 1, &match, 0);
+  int32_t errcode = regexec(&wrapper->regex, hk_string_chars(str), 1, &match, 0);
   if (errcode)
   {
     if (errcode == REG_NOMATCH)
@@ -89,7 +89,7 @@ static int32_t is_match_call(hk_state_t *state, hk_value_t *args)
     return HK_STATUS_ERROR;
   regex_wrapper_t *wrapper = (regex_wrapper_t *) hk_as_userdata(args[1]);
   hk_string_t *str = hk_as_string(args[2]);
-  int32_t errcode = regexec(&wrapper->regex, str->chars, 0, NULL, 0);
+  int32_t errcode = regexec(&wrapper->regex, hk_string_chars(str), 0, NULL, 0);
   if (errcode)
   {
     if (errcode == REG_NOMATCH)
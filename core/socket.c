@@ -179,9 +179,9 @@ static int32_t connect_call(hk_state_t *state, hk_value_t *args)
   hk_string_t *host = hk_as_string(args[2]);
   int32_t port = (int32_t) hk_as_number(args[3]);
   char address[ADDRESS_MAX_LEN];
-  if (!socket_resolve(wrapper->domain, wrapper->type, host->chars, address))
+  if (!socket_resolve(wrapper->domain, wrapper->type, hk_string_chars(host), address))
   {
-    hk_runtime_error("cannot resolve host '%s'", host->chars);
+    hk_runtime_error("cannot resolve host '%s'", hk_string_chars(host));
     return HK_STATUS_ERROR;
   }
   struct sockaddr_in sock_addr;
@@ -237,9 +237,9 @@ static int32_t bind_call(hk_state_t *state, hk_value_t *args)
   hk_string_t *host = hk_as_string(args[2]);
   int32_t port = (int32_t) hk_as_number(args[3]);
   char address[ADDRESS_MAX_LEN];
-  if (!socket_resolve(wrapper->domain, wrapper->type, host->chars, address))
+  if (!socket_resolve(wrapper->domain, wrapper->type, hk_string_chars(host), address))
   {
-    hk_runtime_error("cannot resolve host '%s'", host->chars);
+    hk_runtime_error("cannot resolve host '%s'", hk_string_chars(host));
     return HK_STATUS_ERROR;
   }
   struct sockaddr_in sock_addr;
@@ -283,7 +283,7 @@ static int32_t send_call(hk_state_t *state, hk_value_t *args)
   socket_wrapper_t *wrapper = (socket_wrapper_t *) hk_as_userdata(args[1]);
   hk_string_t *str = hk_as_string(args[2]);
   int32_t flags = (int32_t) hk_as_number(args[3]);
-  int32_t length = (int32_t) send(wrapper->sock, str->chars, str->length, flags);
+  int32_t length = (int32_t) send(wrapper->sock, hk_string_chars(str), str->length, flags);
   return hk_state_push_number(state, length);
 }
 
@@ -44,7 +44,7 @@ static int32_t repeat_call(hk_state_t *state, hk_value_t *args)
   int32_t length = str->length;
   int32_t new_length = length * count;
   hk_string_t *result = hk_string_new_with_capacity(new_length);
-  char *src = str->chars;
+  char *src = hk_string_chars(str);
   char *dest = result->chars;
   for (int32_t i = 0; i < count; ++i)
   {
@@ -29,10 +29,11 @@ static int32_t len_call(hk_state_t *state, hk_value_t *args)
   if (hk_check_argument_string(args, 1) == HK_STATUS_ERROR)
     return HK_STATUS_ERROR;
   hk_string_t *str = hk_as_string(args[1]);
+  char *chars = hk_string_chars(str);
   int32_t result = 0;
   for (int32_t i = 0; i < str->length;)
   {
-    int32_t length = decode_char((unsigned char) str->chars[i]);
+    int32_t length = decode_char((unsigned char) chars[i]);
     if (!length)
       break;
     i += length;
@@ -52,11 +53,12 @@ static int32_t sub_call(hk_state_t *state, hk_value_t *args)
   hk_string_t *str = hk_as_string(args[1]);
   int32_t start = (int32_t) hk_as_number(args[2]);
   int32_t end = (int32_t) hk_as_number(args[3]);
+  char *chars = hk_string_chars(str);
   int32_t length = 0;
   int32_t i = 0;
   while (i < str->length)
   {
-    int32_t n = decode_char((unsigned char) str->chars[i]);
+    int32_t n = decode_char((unsigned char) chars[i]);
     if (!n || length == start)
       break;
     i += n;
@@ -65,7 +67,7 @@ static int32_t sub_call(hk_state_t *state, hk_value_t *args)
   start = i;
   while (i < str->length)
   {
-    int32_t n = decode_char((unsigned char) str->chars[i]);
+    int32_t n = decode_char((unsigned char) chars[i]);
     if (!n || length == end)
       break;
     i += n;
@@ -73,8 +75,7 @@ static int32_t sub_call(hk_state_t *state, hk_value_t *args)
   }
   end = i;
   length = end - start;
-  char *chars = &str->chars[start];
-  return hk_state_push_string_from_chars(state, length, chars);
+  return hk_state_push_string_from_chars(state, length, &chars[start]);
 }
 
 HK_LOAD_FN(utf8)
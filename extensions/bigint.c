@@ -55,7 +55,7 @@ static int32_t new_call(hk_state_t *state, hk_value_t *args)
   if (hk_is_number(val))
     mpz_init_set_d(num, hk_as_number(val));
   else
-    mpz_init_set_str(num, hk_as_string(val)->chars, 10);
+    mpz_init_set_str(num, hk_string_chars(hk_as_string(val)), 10);
   bigint_t *bigint = bigint_new(num);
   return hk_state_push_userdata(state, (hk_userdata_t *) bigint);
 }
@@ -66,7 +66,7 @@ static int32_t from_hex_call(hk_state_t *state, hk_value_t *args)
     return HK_STATUS_ERROR;
   hk_string_t *str = hk_as_string(args[1]);
   mpz_t num;
-  mpz_init_set_str(num, str->chars, 16);
+  mpz_init_set_str(num, hk_string_chars(str), 16);
   bigint_t *bigint = bigint_new(num);
   return hk_state_push_userdata(state, (hk_userdata_t *) bigint);
 }
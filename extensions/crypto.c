@@ -53,8 +53,8 @@ static int32_t rc4_encrypt_call(hk_state_t *state, hk_value_t *args)
   int32_t length = input->length;
   hk_string_t *output = hk_string_new_with_capacity(length);
   rc4_ctx ctx;
-  rc4_ks(&ctx, (uint8 *) key->chars, (uint32) key_length);
-  rc4_encrypt(&ctx, (uint8 *) input->chars, (uint8 *) output->chars, (uint32) length);
+  rc4_ks(&ctx, (uint8 *) hk_string_chars(key), (uint32) key_length);
+  rc4_encrypt(&ctx, (uint8 *) hk_string_chars(input), (uint8 *) output->chars, (uint32) length);
   output->length = length;
   output->chars[length] = '\0';
   hk_array_t *arr;
@@ -93,8 +93,8 @@ static int32_t rc4_decrypt_call(hk_state_t *state, hk_value_t *args)
   int32_t length = input->length;
   hk_string_t *output = hk_string_new_with_capacity(length);
   rc4_ctx ctx;
-  rc4_ks(&ctx, (uint8 *) key->chars, (uint32) key_length);
-  rc4_decrypt(&ctx, (uint8 *) input->chars, (uint8 *) output->chars, (uint32) length);
+  rc4_ks(&ctx, (uint8 *) hk_string_chars(key), (uint32) key_length);
+  rc4_decrypt(&ctx, (uint8 *) hk_string_chars(input), (uint8 *) output->chars, (uint32) length);
   output->length = length;
   output->chars[length] = '\0';
   hk_array_t *arr;
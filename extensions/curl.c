@@ -61,7 +61,7 @@ static int32_t init_call(hk_state_t *state, hk_value_t *args)
   {
     hk_string_t *str = hk_as_string(val);
     CURLcode res;
-    res = curl_easy_setopt(curl, CURLOPT_URL, str->chars);
+    res = curl_easy_setopt(curl, CURLOPT_URL, hk_string_chars(str));
     res = curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
     if (res != CURLE_OK)
     {
@@ -83,7 +83,7 @@ static int32_t setopt_call(hk_state_t *state, hk_value_t *args)
   CURL *curl = ((curl_wrapper_t *) hk_as_userdata(args[1]))->curl;
   int32_t opt = (int32_t) hk_as_number(args[2]);
   hk_string_t *value = hk_as_string(args[3]);
-  CURLcode res = curl_easy_setopt(curl, opt, value->chars);
+  CURLcode res = curl_easy_setopt(curl, opt, hk_string_chars(value));
   if (res != CURLE_OK)
   {
     hk_runtime_error("cannot set option: %s", curl_easy_strerror(res));
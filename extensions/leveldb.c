@@ -154,7 +154,7 @@ static int32_t open_call(hk_state_t *state, hk_value_t *args)
   leveldb_options_t *options = hk_is_nil(val) ?  leveldb_options_create() :
     ((leveldb_options_wrapper_t *) hk_as_userdata(val))->options;
   char *err = NULL;
-  leveldb_t *db = leveldb_open(options, name->chars, &err);
+  leveldb_t *db = leveldb_open(options, hk_string_chars(name), &err);
   hk_array_t *arr = hk_array_new_with_capacity(2);
   if (err)
   {
@@ -201,7 +201,7 @@ static int32_t put_call(hk_state_t *state, hk_value_t *args)
   hk_string_t *key = hk_as_string(args[3]);
   hk_string_t *value = hk_as_string(args[4]);
   char *err = NULL;
-  leveldb_put(db, options, key->chars, key->length, value->chars, value->length, &err);
+  leveldb_put(db, options, hk_string_chars(key), key->length, hk_string_chars(value), value->length, &err);
   hk_array_t *arr = hk_array_new_with_capacity(2);
   if (err)
   {
@@ -231,7 +231,7 @@ static int32_t get_call(hk_state_t *state, hk_value_t *args)
   hk_string_t *key = hk_as_string(args[3]);
   size_t value_length;
   char *err = NULL;
-  char *value = leveldb_get(db, options, key->chars, key->length, &value_length, &err);
+  char *value = leveldb_get(db, options, hk_string_chars(key), key->length, &value_length, &err);
   hk_array_t *arr = hk_array_new_with_capacity(2);
   if (err)
   {
@@ -261,7 +261,7 @@ static int32_t delete_call(hk_state_t *state, hk_value_t *args)
     ((leveldb_write_options_wrapper_t *) hk_as_userdata(val))->options;
   hk_string_t *key = hk_as_string(args[3]);
   char *err = NULL;
-  leveldb_delete(db, options, key->chars, key->length, &err);
+  leveldb_delete(db, options, hk_string_chars(key), key->length, &err);
   hk_array_t *arr = hk_array_new_with_capacity(2);
   if (err)
   {
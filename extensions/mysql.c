@@ -88,11 +88,11 @@ static int32_t connect_call(hk_state_t *state, hk_value_t *args)
   }
   MYSQL *mysql = NULL;
   mysql = mysql_init(mysql);
-  const char *host = hk_is_nil(args[1]) ? NULL : hk_as_string(args[1])->chars;
+  const char *host = hk_is_nil(args[1]) ? NULL : hk_string_chars(hk_as_string(args[1]));
   int32_t port = hk_is_nil(args[2]) ? 0 : (int32_t) hk_as_number(args[2]);
-  const char *username = hk_is_nil(args[3]) ? NULL : hk_as_string(args[3])->chars;
-  const char *password = hk_is_nil(args[4]) ? NULL : hk_as_string(args[4])->chars;
-  const char *database = hk_is_nil(args[5]) ? NULL : hk_as_string(args[5])->chars;
+  const char *username = hk_is_nil(args[3]) ? NULL : hk_string_chars(hk_as_string(args[3]));
+  const char *password = hk_is_nil(args[4]) ? NULL : hk_string_chars(hk_as_string(args[4]));
+  const char *database = hk_is_nil(args[5]) ? NULL : hk_string_chars(hk_as_string(args[5]));
   hk_array_t *result = hk_array_new_with_capacity(2);
   result->length = 2;
   if (!mysql_real_connect(mysql, host, username, password, database, port, NULL, CLIENT_FOUND_ROWS))
@@ -151,7 +151,7 @@ static int32_t select_db_call(hk_state_t *state, hk_value_t *args)
   if (hk_check_argument_string(args, 2) == HK_STATUS_ERROR)
     return HK_STATUS_ERROR;
   MYSQL *mysql = ((mysql_wrapper_t *) hk_as_userdata(args[1]))->mysql;
-  const char *database = hk_as_string(args[2])->chars;
+  const char *database = hk_string_chars(hk_as_string(args[2]));
   return hk_state_push_bool(state, !mysql_select_db(mysql, database));
 }
 
@@ -162,7 +162,7 @@ static int32_t query_call(hk_state_t *state, hk_value_t *args)
   if (hk_check_argument_string(args, 2) == HK_STATUS_ERROR)
     return HK_STATUS_ERROR;
   MYSQL *mysql = ((mysql_wrapper_t *) hk_as_userdata(args[1]))->mysql;
-  const char *query = hk_as_string(args[2])->chars;
+  const char *query = hk_string_chars(hk_as_string(args[2]));
   hk_array_t *result = hk_array_new_with_capacity(2);
   result->length = 2;
   if (mysql_query(mysql, query))
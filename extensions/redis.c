@@ -100,7 +100,7 @@ static int32_t connect_call(hk_state_t *state, hk_value_t *args)
     return HK_STATUS_ERROR;
   hk_string_t *hostname = hk_as_string(args[1]);
   int32_t port = (int32_t) hk_as_number(args[2]);
-  redisContext *redis_context = redisConnect(hostname->chars, port);
+  redisContext *redis_context = redisConnect(hk_string_chars(hostname), port);
   if (!redis_context || redis_context->err)
     return hk_state_push_nil(state);
   return hk_state_push_userdata(state, (hk_userdata_t *) redis_context_wrapper_new(redis_context));
@@ -114,7 +114,7 @@ static int32_t command_call(hk_state_t *state, hk_value_t *args)
     return HK_STATUS_ERROR;
   redisContext *redis_context = ((redis_context_wrapper_t *) hk_as_userdata(args[1]))->redis_context;
   hk_string_t *command = hk_as_string(args[2]);
-  redisReply *reply = redisCommand(redis_context, command->chars);
+  redisReply *reply = redisCommand(redis_context, hk_string_chars(command));
   hk_assert(reply, "redisCommand returned NULL");
   hk_value_t result = redis_reply_to_value(reply);
   freeReplyObject(reply);
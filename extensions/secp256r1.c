@@ -55,8 +55,8 @@ static int32_t shared_secret_call(hk_state_t *state, hk_value_t *args)
   hk_string_t *secret = hk_string_new_with_capacity(SECRET_SIZE);
   secret->length = SECRET_SIZE;
   secret->chars[SECRET_SIZE] = '\0';
-  (void) ecdh_shared_secret((uint8_t *) pub_key->chars, (uint8_t *) priv_key->chars,
-    (uint8_t *) secret->chars);
+  (void) ecdh_shared_secret((uint8_t *) hk_string_chars(pub_key),
+    (uint8_t *) hk_string_chars(priv_key), (uint8_t *) secret->chars);
   if (hk_state_push_string(state, secret) == HK_STATUS_ERROR)
   {
     hk_string_free(secret);
@@ -76,7 +76,7 @@ static int32_t sign_hash_call(hk_state_t *state, hk_value_t *args)
   hk_string_t *signature = hk_string_new_with_capacity(SIGNATURE_SIZE);
   signature->length = SIGNATURE_SIZE;
   signature->chars[SIGNATURE_SIZE] = '\0';
-  (void) ecdsa_sign((uint8_t *) priv_key->chars, (uint8_t *) hash->chars,
+  (void) ecdsa_sign((uint8_t *) hk_string_chars(priv_key), (uint8_t *) hk_string_chars(hash),
     (uint8_t *) signature->chars);
   if (hk_state_push_string(state, signature) == HK_STATUS_ERROR)
   {
@@ -97,8 +97,8 @@ static int32_t verify_signature_call(hk_state_t *state, hk_value_t *args)
   hk_string_t *pub_key = hk_as_string(args[1]);
   hk_string_t *hash = hk_as_string(args[2]);
   hk_string_t *signature = hk_as_string(args[3]);
-  bool valid = (bool) ecdsa_verify((uint8_t *) pub_key->chars, (uint8_t *) hash->chars,
-    (uint8_t *) signature->chars);
+  bool valid = (bool) ecdsa_verify((uint8_t *) hk_string_chars(pub_key),
+    (uint8_t *) hk_string_chars(hash), (uint8_t *) hk_string_chars(signature));
   return hk_state_push_bool(state, valid);
 }
 
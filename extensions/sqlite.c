@@ -66,10 +66,10 @@ static int32_t open_call(hk_state_t *state, hk_value_t *args)
     return HK_STATUS_ERROR;
   hk_string_t *filename = hk_as_string(args[1]);
   sqlite3 *sqlite;
-  if (sqlite3_open(filename->chars, &sqlite) != SQLITE_OK)
+  if (sqlite3_open(hk_string_chars(filename), &sqlite) != SQLITE_OK)
   {
     hk_runtime_error("cannot open database `%.*s`", filename->length,
-      filename->chars);
+      hk_string_chars(filename));
     sqlite3_close(sqlite);
     return HK_STATUS_ERROR;
   }
@@ -92,7 +92,7 @@ static int32_t execute_call(hk_state_t *state, hk_value_t *args)
   sqlite3 *sqlite = ((sqlite_wrapper_t *) hk_as_userdata(args[1]))->sqlite;
   hk_string_t *sql = hk_as_string(args[2]);
   char *err = NULL;
-  if (sqlite3_exec(sqlite, sql->chars, NULL, NULL, &err) != SQLITE_OK)
+  if (sqlite3_exec(sqlite, hk_string_chars(sql), NULL, NULL, &err) != SQLITE_OK)
   {
     hk_runtime_error("cannot execute SQL: %s", err);
     sqlite3_free(err);
@@ -110,7 +110,7 @@ static int32_t prepare_call(hk_state_t *state, hk_value_t *args)
   sqlite3 *sqlite = ((sqlite_wrapper_t *) hk_as_userdata(args[1]))->sqlite;
   hk_string_t *sql = hk_as_string(args[2]);
   sqlite3_stmt *sqlite_stmt;
-  if (sqlite3_prepare_v2(sqlite, sql->chars, sql->length, &sqlite_stmt, NULL) != SQLITE_OK)
+  if (sqlite3_prepare_v2(sqlite, hk_string_chars(sql), sql->length, &sqlite_stmt, NULL) != SQLITE_OK)
   {
     hk_runtime_error("cannot prepare SQL: %s", sqlite3_errmsg(sqlite));
     return HK_STATUS_ERROR;
@@ -150,7 +150,7 @@ static int32_t bind_call(hk_state_t *state, hk_value_t *args)
     return hk_state_push_number(state, sqlite3_bind_double(sqlite_stmt, index, data));
   }
   hk_string_t *str = hk_as_string(val);
-  return hk_state_push_number(state, sqlite3_bind_text(sqlite_stmt, index, str->chars, str->length,
+  return hk_state_push_number(state, sqlite3_bind_text(sqlite_stmt, index, hk_string_chars(str), str->length,
     NULL));
 }
 
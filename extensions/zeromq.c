@@ -114,9 +114,9 @@ static int32_t connect_call(hk_state_t *state, hk_value_t *args)
   zeromq_socket_wrapper_t *wrapper = (zeromq_socket_wrapper_t *) hk_as_userdata(args[1]);
   hk_string_t *host = hk_as_string(args[2]);
   void *sock = wrapper->sock;
-  if (zmq_connect(sock, host->chars))
+  if (zmq_connect(sock, hk_string_chars(host)))
   {
-    hk_runtime_error("cannot connect to address '%.*s'", host->length, host->chars);
+    hk_runtime_error("cannot connect to address '%.*s'", host->length, hk_string_chars(host));
     return HK_STATUS_ERROR;
   }
   return hk_state_push_nil(state);
@@ -131,9 +131,9 @@ static int32_t bind_call(hk_state_t *state, hk_value_t *args)
   zeromq_socket_wrapper_t *wrapper = (zeromq_socket_wrapper_t *) hk_as_userdata(args[1]);
   hk_string_t *host = hk_as_string(args[2]);
   void *sock = wrapper->sock;
-  if (zmq_bind(sock, host->chars))
+  if (zmq_bind(sock, hk_string_chars(host)))
   {
-    hk_runtime_error("cannot bind to address '%.*s'", host->length, host->chars);
+    hk_runtime_error("cannot bind to address '%.*s'", host->length, hk_string_chars(host));
     return HK_STATUS_ERROR;
   }
   return hk_state_push_nil(state);
@@ -150,7 +150,7 @@ static int32_t send_call(hk_state_t *state, hk_value_t *args)
   zeromq_socket_wrapper_t *wrapper = (zeromq_socket_wrapper_t *) hk_as_userdata(args[1]);
   hk_string_t *str = hk_as_string(args[2]);
   int32_t flags = (int32_t) hk_as_number(args[3]);
-  int32_t length = (int32_t) zmq_send(wrapper->sock, str->chars, str->length, flags);
+  int32_t length = (int32_t) zmq_send(wrapper->sock, hk_string_chars(str), str->length, flags);
   return hk_state_push_number(state, length);
 }
 
@@ -15,7 +15,7 @@
 
 typedef struct
 {
-  HK_OBJECT_HEADER
+  HK_CONTAINER_HEADER
   int32_t capacity;
   int32_t length;
   hk_value_t *elements;
@@ -9,6 +9,8 @@
 #include <hook/string.h>
 #include <hook/chunk.h>
 
+struct hk_state;
+
 typedef struct hk_function
 {
   HK_OBJECT_HEADER
@@ -16,21 +18,23 @@ typedef struct hk_function
   hk_string_t *name;
   hk_string_t *file;
   hk_chunk_t chunk;
-  uint8_t functions_capacity;
-  uint8_t functions_length;
+  int32_t functions_capacity;
+  int32_t functions_length;
   struct hk_function **functions;
   uint8_t num_nonlocals;
+  int32_t max_stack;
+  int32_t num_removed;
+  int32_t num_calls;
+  int32_t (*jit_code)(struct hk_state *);
 } hk_function_t;
 
 typedef struct
 {
-  HK_OBJECT_HEADER
+  HK_CONTAINER_HEADER
   hk_function_t *fn;
   hk_value_t nonlocals[1];
 } hk_closure_t;
 
-struct hk_state;
-
 typedef struct
 {
   HK_OBJECT_HEADER
@@ -7,6 +7,7 @@
 #define HK_CHUNK_H
 
 #include <hook/array.h>
+#include <hook/struct.h>
 
 typedef enum
 {
@@ -32,7 +33,17 @@ typedef enum
   HK_OP_QUOTIENT,               HK_OP_REMAINDER,           HK_OP_NEGATE,
   HK_OP_NOT,                    HK_OP_BITWISE_NOT,         HK_OP_INCREMENT,
   HK_OP_DECREMENT,              HK_OP_CALL,                HK_OP_LOAD_MODULE,
-  HK_OP_RETURN,                 HK_OP_RETURN_NIL
+  HK_OP_RETURN,                 HK_OP_RETURN_NIL,          HK_OP_LOAD_LOAD,
+  HK_OP_INCREMENT_LOCAL,        HK_OP_DECREMENT_LOCAL,     HK_OP_JUMP_IF_NOT_LESS,
+  HK_OP_GREATER_NUM,            HK_OP_LESS_NUM,            HK_OP_NOT_GREATER_NUM,
+  HK_OP_NOT_LESS_NUM,           HK_OP_ADD_NUM,             HK_OP_SUBTRACT_NUM,
+  HK_OP_MULTIPLY_NUM,           HK_OP_DIVIDE_NUM,          HK_OP_TAIL_CALL,
+  HK_OP_RANGE_LOOP,             HK_OP_RANGE_STEP,          HK_OP_MOVE,
+  HK_OP_LOAD_ELEMENT,           HK_OP_LOAD_FIELD,          HK_OP_NONLOCAL_ELEMENT,
+  HK_OP_NONLOCAL_FIELD,         HK_OP_GREATER_UNCHECKED,   HK_OP_LESS_UNCHECKED,
+  HK_OP_NOT_GREATER_UNCHECKED,  HK_OP_NOT_LESS_UNCHECKED,  HK_OP_ADD_UNCHECKED,
+  HK_OP_SUBTRACT_UNCHECKED,     HK_OP_MULTIPLY_UNCHECKED,  HK_OP_DIVIDE_UNCHECKED,
+  HK_OP_INCREMENT_NUM,          HK_OP_DECREMENT_NUM,       HK_OP_WIDE
 } hk_opcode_t;
 
 typedef struct
@@ -41,6 +52,20 @@ typedef struct
   int32_t offset;
 } hk_line_t;
 
+typedef struct
+{
+  int32_t start;
+  int32_t end;
+  int32_t line;
+  hk_string_t *name;
+} hk_inline_t;
+
+typedef struct
+{
+  hk_struct_t *ztruct;
+  int32_t index;
+} hk_field_cache_t;
+
 typedef struct
 {
   int32_t code_capacity;
@@ -49,7 +74,13 @@ typedef struct
   int32_t lines_capacity;
   int32_t lines_length;
   hk_line_t *lines;
+  int32_t inlines_capacity;
+  int32_t inlines_length;
+  hk_inline_t *inlines;
   hk_array_t *consts;
+  int32_t caches_capacity;
+  int32_t caches_length;
+  hk_field_cache_t *caches;
 } hk_chunk_t;
 
 void hk_chunk_init(hk_chunk_t *chunk);
@@ -59,6 +90,9 @@ void hk_chunk_emit_word(hk_chunk_t *chunk, uint16_t word);
 void hk_chunk_emit_opcode(hk_chunk_t *chunk, hk_opcode_t op);
 void hk_chunk_add_line(hk_chunk_t *chunk, int32_t line_no);
 int32_t hk_chunk_get_line(hk_chunk_t *chunk, int32_t offset);
+void hk_chunk_add_inline(hk_chunk_t *chunk, int32_t start, int32_t end, int32_t line,
+  hk_string_t *name);
+int32_t hk_chunk_add_cache(hk_chunk_t *chunk);
 void hk_chunk_serialize(hk_chunk_t *chunk, FILE *stream);
 bool hk_chunk_deserialize(hk_chunk_t *chunk, FILE *stream);
 
@@ -8,6 +8,10 @@
 
 #include <hook/callable.h>
 
-hk_closure_t *hk_compile(hk_string_t *file, hk_string_t *source);
+#define HK_COMPILER_FLAG_NONE     0x00
+#define HK_COMPILER_FLAG_OPTIMIZE 0x01
+#define HK_COMPILER_FLAG_INLINE   0x02
+
+hk_closure_t *hk_compile(hk_string_t *file, hk_string_t *source, int32_t flags);
 
 #endif // HK_COMPILER_H
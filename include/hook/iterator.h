@@ -8,12 +8,15 @@
 
 #include <hook/value.h>
 
+#define HK_ITERATOR_POOL_CAPACITY (1 << 5)
+
 #define HK_ITERATOR_HEADER HK_OBJECT_HEADER \
                            void (*deinit)(struct hk_iterator *); \
                            bool (*is_valid)(struct hk_iterator *); \
                            hk_value_t (*get_current)(struct hk_iterator *); \
                            struct hk_iterator *(*next)(struct hk_iterator *); \
-                           void (*inplace_next)(struct hk_iterator *);
+                           void (*inplace_next)(struct hk_iterator *); \
+                           void (*recycle)(struct hk_iterator *);
 
 typedef struct hk_iterator
 {
@@ -22,7 +25,8 @@ typedef struct hk_iterator
 
 void hk_iterator_init(hk_iterator_t *it, void (*deinit)(struct hk_iterator *),
   bool (*is_valid)(struct hk_iterator *), hk_value_t (*get_current)(struct hk_iterator *),
-  struct hk_iterator *(*next)(struct hk_iterator *), void (*inplace_next)(struct hk_iterator *));
+  struct hk_iterator *(*next)(struct hk_iterator *), void (*inplace_next)(struct hk_iterator *),
+  void (*recycle)(struct hk_iterator *));
 void hk_iterator_free(hk_iterator_t *it);
 void hk_iterator_release(hk_iterator_t *it);
 bool hk_iterator_is_valid(hk_iterator_t *it);
@@ -6,9 +6,34 @@
 #ifndef HK_MEMORY_H
 #define HK_MEMORY_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
+#define HK_MEMORY_NUM_TYPES 16
+#define HK_MEMORY_TYPE_MASK 0x0f
+#define HK_MEMORY_OBJECT    0x80
+
+#define HK_MEMORY_ATTACH_FN "hk_memory_attach"
+
+typedef struct
+{
+  int64_t used;
+  int64_t peak;
+  int64_t limit;
+  int64_t objects[HK_MEMORY_NUM_TYPES];
+  int64_t bytes[HK_MEMORY_NUM_TYPES];
+} hk_memory_t;
+
 void *hk_allocate(int32_t size);
 void *hk_reallocate(void *ptr, int32_t size);
+void hk_free(void *ptr);
+void hk_memory_tag(void *ptr, int32_t tag);
+hk_memory_t *hk_memory(void);
+#ifdef _WIN32
+void __declspec(dllexport) hk_memory_attach(hk_memory_t *memory);
+#else
+void hk_memory_attach(hk_memory_t *memory);
+#endif
+bool hk_memory_exceeded(void);
 
 #endif // HK_MEMORY_H
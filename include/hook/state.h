@@ -11,16 +11,33 @@
 #include <hook/callable.h>
 #include <hook/userdata.h>
 
-#define HK_STACK_MIN_CAPACITY (1 << 8)
+#define HK_STACK_MIN_CAPACITY    (1 << 8)
+#define HK_STACK_MAX_CAPACITY    (1 << 20)
+#define HK_STACK_NATIVE_CAPACITY (1 << 5)
+#define HK_FRAMES_MIN_CAPACITY   (1 << 4)
+
+typedef struct hk_frame
+{
+  hk_closure_t *cl;
+  uint8_t *pc;
+  int32_t base;
+} hk_frame_t;
 
 typedef struct hk_state
 {
+  int32_t stack_limit;
   int32_t stack_end;
   int32_t stack_top;
   hk_value_t *stack;
+  int32_t frames_end;
+  int32_t frames_top;
+  hk_frame_t *frames;
+  int64_t num_inplace_next;
+  int64_t num_copying_next;
 } hk_state_t;
 
 void hk_state_init(hk_state_t *state, int32_t min_capacity);
+void hk_state_set_stack_limit(hk_state_t *state, int32_t max_capacity);
 void hk_state_free(hk_state_t *state);
 int32_t hk_state_push(hk_state_t *state, hk_value_t val);
 int32_t hk_state_push_nil(hk_state_t *state);
@@ -8,13 +8,18 @@
 
 #include <hook/value.h>
 
-#define HK_STRING_MIN_CAPACITY (1 << 3)
+#define HK_STRING_MIN_CAPACITY    (1 << 3)
+#define HK_STRING_INLINE_CAPACITY 24
+#define HK_STRING_INTERN_CAPACITY (1 << 8)
+
+#define hk_string_chars(s) ((s)->chars ? (s)->chars : hk_string_flatten(s))
 
 typedef struct
 {
   HK_OBJECT_HEADER
   int32_t capacity;
   int32_t length;
+  bool interned;
   char *chars;
   int64_t hash;
 } hk_string_t;
@@ -23,10 +28,13 @@ hk_string_t *hk_string_new(void);
 hk_string_t *hk_string_new_with_capacity(int32_t min_capacity);
 hk_string_t *hk_string_from_chars(int32_t length, const char *chars);
 hk_string_t *hk_string_from_stream(FILE *stream, const char terminal);
+hk_string_t *hk_string_intern(hk_string_t *str);
 void hk_string_ensure_capacity(hk_string_t *str, int32_t min_capacity);
 void hk_string_free(hk_string_t *str);
 void hk_string_release(hk_string_t *str);
 hk_string_t *hk_string_concat(hk_string_t *str1, hk_string_t *str2);
+hk_string_t *hk_string_rope(hk_string_t *str1, hk_string_t *str2);
+char *hk_string_flatten(hk_string_t *str);
 void hk_string_inplace_concat_char(hk_string_t *dest, char c);
 void hk_string_inplace_concat_chars(hk_string_t *dest, int32_t length, const char *chars);
 void hk_string_inplace_concat(hk_string_t *dest, hk_string_t *src);
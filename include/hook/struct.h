@@ -10,6 +10,7 @@
 
 #define STRUCT_MIN_CAPACITY    (1 << 3)
 #define STRUCT_MAX_LOAD_FACTOR 0.75
+#define STRUCT_POOL_CAPACITY   (1 << 8)
 
 #define hk_instance_get_field(inst, i) ((inst)->values[(i)])
 
@@ -28,11 +29,13 @@ typedef struct
   hk_string_t *name;
   hk_field_t *fields;
   hk_field_t **table;
+  int32_t pool_length;
+  struct hk_instance **pool;
 } hk_struct_t;
 
-typedef struct
+typedef struct hk_instance
 {
-  HK_OBJECT_HEADER
+  HK_CONTAINER_HEADER
   hk_struct_t *ztruct;
   hk_value_t values[1];
 } hk_instance_t;
@@ -8,8 +8,9 @@
 
 #include <hook/value.h>
 
-#define HK_USERDATA_HEADER HK_OBJECT_HEADER \
-                           void (*deinit)(struct hk_userdata *);
+#define HK_USERDATA_HEADER HK_CONTAINER_HEADER \
+                           void (*deinit)(struct hk_userdata *); \
+                           void (*traverse)(struct hk_userdata *, void (*)(hk_value_t));
 
 typedef struct hk_userdata
 {
@@ -32,6 +32,69 @@ typedef enum
 #define HK_FLAG_ITERABLE   0x08
 #define HK_FLAG_NATIVE     0x10
 
+#ifdef HK_NAN_BOXING
+
+#define HK_BOX_BITS     UINT64_C(0xfff8000000000000)
+#define HK_TAG_SHIFT    47
+#define HK_TAG_NATIVE   (HK_TYPE_USERDATA + 2)
+#define HK_PAYLOAD_MASK ((UINT64_C(1) << HK_TAG_SHIFT) - 1)
+
+#define hk_box(t, p) (HK_BOX_BITS | ((uint64_t) (t) << HK_TAG_SHIFT) | (uint64_t) (p))
+#define hk_tag(v)    ((int32_t) (((v) >> HK_TAG_SHIFT) & 0xf))
+
+#define HK_NIL_VALUE         hk_box(HK_TYPE_NIL + 1, 0)
+#define HK_FALSE_VALUE       hk_box(HK_TYPE_BOOL + 1, 0)
+#define HK_TRUE_VALUE        hk_box(HK_TYPE_BOOL + 1, 1)
+#define hk_number_value(n)   (((union { double number; hk_value_t bits; }) {.number = (n)}).bits)
+#define hk_string_value(s)   hk_box(HK_TYPE_STRING + 1, (uintptr_t) (s))
+#define hk_range_value(r)    hk_box(HK_TYPE_RANGE + 1, (uintptr_t) (r))
+#define hk_array_value(a)    hk_box(HK_TYPE_ARRAY + 1, (uintptr_t) (a))
+#define hk_struct_value(s)   hk_box(HK_TYPE_STRUCT + 1, (uintptr_t) (s))
+#define hk_instance_value(i) hk_box(HK_TYPE_INSTANCE + 1, (uintptr_t) (i))
+#define hk_iterator_value(i) hk_box(HK_TYPE_ITERATOR + 1, (uintptr_t) (i))
+#define hk_closure_value(c)  hk_box(HK_TYPE_CALLABLE + 1, (uintptr_t) (c))
+#define hk_native_value(n)   hk_box(HK_TAG_NATIVE, (uintptr_t) (n))
+#define hk_userdata_value(u) hk_box(HK_TYPE_USERDATA + 1, (uintptr_t) (u))
+
+#define hk_as_bool(v)     ((bool) ((v) & 1))
+#define hk_as_number(v)   (((union { hk_value_t bits; double number; }) {.bits = (v)}).number)
+#define hk_as_pointer(v)  ((void *) (uintptr_t) ((v) & HK_PAYLOAD_MASK))
+#define hk_as_string(v)   ((hk_string_t *) hk_as_pointer(v))
+#define hk_as_range(v)    ((hk_range_t *) hk_as_pointer(v))
+#define hk_as_array(v)    ((hk_array_t *) hk_as_pointer(v))
+#define hk_as_struct(v)   ((hk_struct_t *) hk_as_pointer(v))
+#define hk_as_instance(v) ((hk_instance_t *) hk_as_pointer(v))
+#define hk_as_iterator(v) ((hk_iterator_t *) hk_as_pointer(v))
+#define hk_as_closure(v)  ((hk_closure_t *) hk_as_pointer(v))
+#define hk_as_native(v)   ((hk_native_t *) hk_as_pointer(v))
+#define hk_as_userdata(v) ((hk_userdata_t *) hk_as_pointer(v))
+#define hk_as_object(v)   ((hk_object_t *) hk_as_pointer(v))
+
+#define hk_type(v)  (hk_is_number(v) ? HK_TYPE_NUMBER : (hk_type_t) (hk_tag(v) == HK_TAG_NATIVE \
+  ? HK_TYPE_CALLABLE : hk_tag(v) - 1))
+#define hk_flags(v) ((hk_is_object(v) ? HK_FLAG_OBJECT : 0) | (hk_is_falsey(v) ? HK_FLAG_FALSEY : 0) \
+  | (hk_is_comparable(v) ? HK_FLAG_COMPARABLE : 0) | (hk_is_iterable(v) ? HK_FLAG_ITERABLE : 0) \
+  | (hk_is_native(v) ? HK_FLAG_NATIVE : 0))
+
+#define hk_is_nil(v)        ((v) == HK_NIL_VALUE)
+#define hk_is_bool(v)       (((v) | 1) == HK_TRUE_VALUE)
+#define hk_is_number(v)     ((v) < hk_box(1, 0))
+#define hk_is_string(v)     (((v) & ~HK_PAYLOAD_MASK) == hk_box(HK_TYPE_STRING + 1, 0))
+#define hk_is_range(v)      (((v) & ~HK_PAYLOAD_MASK) == hk_box(HK_TYPE_RANGE + 1, 0))
+#define hk_is_array(v)      (((v) & ~HK_PAYLOAD_MASK) == hk_box(HK_TYPE_ARRAY + 1, 0))
+#define hk_is_struct(v)     (((v) & ~HK_PAYLOAD_MASK) == hk_box(HK_TYPE_STRUCT + 1, 0))
+#define hk_is_instance(v)   (((v) & ~HK_PAYLOAD_MASK) == hk_box(HK_TYPE_INSTANCE + 1, 0))
+#define hk_is_iterator(v)   (((v) & ~HK_PAYLOAD_MASK) == hk_box(HK_TYPE_ITERATOR + 1, 0))
+#define hk_is_callable(v)   (((v) & ~HK_PAYLOAD_MASK) == hk_box(HK_TYPE_CALLABLE + 1, 0) || hk_is_native(v))
+#define hk_is_userdata(v)   (((v) & ~HK_PAYLOAD_MASK) == hk_box(HK_TYPE_USERDATA + 1, 0))
+#define hk_is_object(v)     ((v) >= hk_box(HK_TYPE_STRING + 1, 0))
+#define hk_is_falsey(v)     ((v) == HK_NIL_VALUE || (v) == HK_FALSE_VALUE)
+#define hk_is_comparable(v) ((v) < hk_box(HK_TYPE_STRUCT + 1, 0))
+#define hk_is_iterable(v)   (hk_is_range(v) || hk_is_array(v))
+#define hk_is_native(v)     (((v) & ~HK_PAYLOAD_MASK) == hk_box(HK_TAG_NATIVE, 0))
+
+#else
+
 #define HK_NIL_VALUE         ((hk_value_t) {.type = HK_TYPE_NIL, .flags = HK_FLAG_FALSEY | HK_FLAG_COMPARABLE})
 #define HK_FALSE_VALUE       ((hk_value_t) {.type = HK_TYPE_BOOL, .flags = HK_FLAG_FALSEY | HK_FLAG_COMPARABLE, .as.bool_value = false})
 #define HK_TRUE_VALUE        ((hk_value_t) {.type = HK_TYPE_BOOL, .flags = HK_FLAG_COMPARABLE, .as.bool_value = true})
@@ -59,10 +122,12 @@ typedef enum
 #define hk_as_userdata(v) ((hk_userdata_t *) (v).as.pointer_value)
 #define hk_as_object(v)   ((hk_object_t *) (v).as.pointer_value)
 
+#define hk_type(v)  ((v).type)
+#define hk_flags(v) ((v).flags)
+
 #define hk_is_nil(v)        ((v).type == HK_TYPE_NIL)
 #define hk_is_bool(v)       ((v).type == HK_TYPE_BOOL)
 #define hk_is_number(v)     ((v).type == HK_TYPE_NUMBER)
-#define hk_is_int(v)        (hk_is_number(v) && hk_as_number(v) == (int64_t) hk_as_number(v))
 #define hk_is_string(v)     ((v).type == HK_TYPE_STRING)
 #define hk_is_range(v)      ((v).type == HK_TYPE_RANGE)
 #define hk_is_array(v)      ((v).type == HK_TYPE_ARRAY)
@@ -73,13 +138,20 @@ typedef enum
 #define hk_is_userdata(v)   ((v).type == HK_TYPE_USERDATA)
 #define hk_is_object(v)     ((v).flags & HK_FLAG_OBJECT)
 #define hk_is_falsey(v)     ((v).flags & HK_FLAG_FALSEY)
-#define hk_is_truthy(v)     (!hk_is_falsey(v))
 #define hk_is_comparable(v) ((v).flags & HK_FLAG_COMPARABLE)
 #define hk_is_iterable(v)   ((v).flags & HK_FLAG_ITERABLE)
 #define hk_is_native(v)     ((v).flags & HK_FLAG_NATIVE)
 
+#endif
+
+#define hk_is_int(v)        (hk_is_number(v) && hk_as_number(v) == (int64_t) hk_as_number(v))
+#define hk_is_truthy(v)     (!hk_is_falsey(v))
+
 #define HK_OBJECT_HEADER int32_t ref_count;
 
+#define HK_CONTAINER_HEADER HK_OBJECT_HEADER \
+                            int32_t gc_flags;
+
 #define hk_incr_ref(o)       ++(o)->ref_count
 #define hk_decr_ref(o)       --(o)->ref_count
 #define hk_is_unreachable(o) (!(o)->ref_count)
@@ -88,6 +160,12 @@ typedef enum
 #define hk_value_incr_ref(v)  if (hk_is_object(v)) hk_incr_ref(hk_as_object(v))
 #define hk_value_decr_ref(v)  if (hk_is_object(v)) hk_decr_ref(hk_as_object(v))
 
+#ifdef HK_NAN_BOXING
+
+typedef uint64_t hk_value_t;
+
+#else
+
 typedef struct
 {
   hk_type_t type;
@@ -100,6 +178,8 @@ typedef struct
   } as;
 } hk_value_t;
 
+#endif
+
 typedef struct
 {
   HK_OBJECT_HEADER
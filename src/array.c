@@ -8,6 +8,7 @@
 #include <hook/memory.h>
 #include <hook/status.h>
 #include <hook/utils.h>
+#include "gc.h"
 
 typedef struct
 {
@@ -16,6 +17,9 @@ typedef struct
   int32_t current;
 } array_iterator_t;
 
+static array_iterator_t *iterator_pool[HK_ITERATOR_POOL_CAPACITY];
+static int32_t iterator_pool_length = 0;
+
 static inline hk_array_t *array_allocate(int32_t min_capacity);
 static inline array_iterator_t *array_iterator_allocate(hk_array_t *arr);
 static void array_iterator_deinit(hk_iterator_t *it);
@@ -23,6 +27,7 @@ static bool array_iterator_is_valid(hk_iterator_t *it);
 static hk_value_t array_iterator_get_current(hk_iterator_t *it);
 static hk_iterator_t *array_iterator_next(hk_iterator_t *it);
 static void array_iterator_inplace_next(hk_iterator_t *it);
+static void array_iterator_recycle(hk_iterator_t *it);
 
 static inline hk_array_t *array_allocate(int32_t min_capacity)
 {
@@ -30,17 +35,29 @@ static inline hk_array_t *array_allocate(int32_t min_capacity)
   int32_t capacity = min_capacity < HK_ARRAY_MIN_CAPACITY ? HK_ARRAY_MIN_CAPACITY : min_capacity;
   capacity = hk_power_of_two_ceil(capacity);
   arr->ref_count = 0;
+  arr->gc_flags = 0;
   arr->capacity = capacity;
   arr->elements = (hk_value_t *) hk_allocate(sizeof(*arr->elements) * capacity);
+  hk_memory_tag(arr, HK_TYPE_ARRAY | HK_MEMORY_OBJECT);
+  hk_memory_tag(arr->elements, HK_TYPE_ARRAY);
   return arr;
 }
 
 static inline array_iterator_t *array_iterator_allocate(hk_array_t *arr)
 {
-  array_iterator_t *arr_it = (array_iterator_t *) hk_allocate(sizeof(*arr_it));
-  hk_iterator_init((hk_iterator_t *) arr_it, &array_iterator_deinit,
-    &array_iterator_is_valid, &array_iterator_get_current,
-    &array_iterator_next, &array_iterator_inplace_next);
+  array_iterator_t *arr_it;
+  if (iterator_pool_length)
+  {
+    arr_it = iterator_pool[--iterator_pool_length];
+    arr_it->ref_count = 0;
+  }
+  else
+  {
+    arr_it = (array_iterator_t *) hk_allocate(sizeof(*arr_it));
+    hk_iterator_init((hk_iterator_t *) arr_it, &array_iterator_deinit,
+      &array_iterator_is_valid, &array_iterator_get_current,
+      &array_iterator_next, &array_iterator_inplace_next, &array_iterator_recycle);
+  }
   hk_incr_ref(arr);
   arr_it->arr = arr;
   return arr_it;
@@ -78,6 +95,16 @@ static void array_iterator_inplace_next(hk_iterator_t *it)
   ++arr_it->current;
 }
 
+static void array_iterator_recycle(hk_iterator_t *it)
+{
+  if (iterator_pool_length == HK_ITERATOR_POOL_CAPACITY)
+  {
+    hk_free(it);
+    return;
+  }
+  iterator_pool[iterator_pool_length++] = (array_iterator_t *) it;
+}
+
 hk_array_t *hk_array_new(void)
 {
   return hk_array_new_with_capacity(0);
@@ -104,15 +131,21 @@ void hk_array_free(hk_array_t *arr)
 {
   for (int32_t i = 0; i < arr->length; ++i)
     hk_value_release(arr->elements[i]);
-  free(arr->elements);
-  free(arr);
+  hk_free(arr->elements);
+  if (gc_is_buffered(arr))
+    return;
+  hk_free(arr);
 }
 
 void hk_array_release(hk_array_t *arr)
 {
   hk_decr_ref(arr);
   if (hk_is_unreachable(arr))
+  {
     hk_array_free(arr);
+    return;
+  }
+  gc_possible_root(hk_array_value(arr));
 }
 
 int32_t hk_array_index_of(hk_array_t *arr, hk_value_t elem)
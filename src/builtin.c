@@ -124,7 +124,7 @@ static inline int32_t string_to_double(hk_string_t *str, double *result)
     hk_runtime_error("type error: argument #1 must be a non-empty string");
     return HK_STATUS_ERROR;
   }
-  if (!hk_double_from_chars(result, str->chars, true))
+  if (!hk_double_from_chars(result, hk_string_chars(str), true))
   {
     hk_runtime_error("type error: argument #1 is not a convertible string");
     return HK_STATUS_ERROR;
@@ -135,9 +135,9 @@ static inline int32_t string_to_double(hk_string_t *str, double *result)
 static inline hk_array_t *split(hk_string_t *str, hk_string_t *separator)
 {
   hk_array_t *arr = hk_array_new();
-  char *cur = str->chars;
+  char *cur = hk_string_chars(str);
   char *tk;
-  while ((tk = strtok_r(cur, separator->chars, &cur)))
+  while ((tk = strtok_r(cur, hk_string_chars(separator), &cur)))
   {
     hk_value_t elem = hk_string_value(hk_string_from_chars(-1, tk));
     hk_array_inplace_add_element(arr, elem);
@@ -176,7 +176,7 @@ static int32_t println_call(hk_state_t *state, hk_value_t *args)
 
 static int32_t type_call(hk_state_t *state, hk_value_t *args)
 {
-  return hk_state_push_string_from_chars(state, -1, hk_type_name(args[1].type));
+  return hk_state_push_string_from_chars(state, -1, hk_type_name(hk_type(args[1])));
 }
 
 static int32_t is_nil_call(hk_state_t *state, hk_value_t *args)
@@ -332,7 +332,7 @@ static int32_t ord_call(hk_state_t *state, hk_value_t *args)
     hk_runtime_error("type error: argument #1 must be a non-empty string");
     return HK_STATUS_ERROR;
   }
-  return hk_state_push_number(state, (uint32_t) str->chars[0]);
+  return hk_state_push_number(state, (uint32_t) hk_string_chars(str)[0]);
 }
 
 static int32_t chr_call(hk_state_t *state, hk_value_t *args)
@@ -370,9 +370,10 @@ static int32_t hex_call(hk_state_t *state, hk_value_t *args)
   result->length = length;
   result->chars[length] = '\0';
   char *chars = result->chars;
+  char *src = hk_string_chars(str);
   for (int32_t i = 0; i < str->length; ++i)
   {
-    snprintf(chars, INT32_MAX, "%.2x", (unsigned char) str->chars[i]);
+    snprintf(chars, INT32_MAX, "%.2x", (unsigned char) src[i]);
     chars += 2;
   }
   if (hk_state_push_string(state, result) == HK_STATUS_ERROR)
@@ -399,7 +400,7 @@ static int32_t bin_call(hk_state_t *state, hk_value_t *args)
   hk_string_t *result = hk_string_new_with_capacity(length);
   result->length = length;
   result->chars[length] = '\0';
-  char *chars = str->chars;
+  char *chars = hk_string_chars(str);
   for (int32_t i = 0; i < length; ++i)
   {
     sscanf(chars, "%2hhx", (unsigned char *) &result->chars[i]);
@@ -416,7 +417,7 @@ static int32_t bin_call(hk_state_t *state, hk_value_t *args)
 static int32_t address_call(hk_state_t *state, hk_value_t *args)
 {
   hk_value_t val = args[1];
-  void *ptr = (int64_t) hk_is_object(val) ? val.as.pointer_value : NULL;
+  void *ptr = (int64_t) hk_is_object(val) ? hk_as_object(val) : NULL;
   hk_string_t *result = hk_string_new_with_capacity(32);
   char *chars = result->chars;
   snprintf(chars, 31,  "%p", ptr);
@@ -606,7 +607,7 @@ static int32_t assert_call(hk_state_t *state, hk_value_t *args)
   if (hk_is_falsey(args[1]))
   {
     hk_string_t *str = hk_as_string(args[2]);
-    fprintf(stderr, "assertion failed: %.*s\n", str->length, str->chars);
+    fprintf(stderr, "assertion failed: %.*s\n", str->length, hk_string_chars(str));
     return HK_STATUS_NO_TRACE;
   }
   return hk_state_push_nil(state);
@@ -618,7 +619,7 @@ static int32_t panic_call(hk_state_t *state, hk_value_t *args)
   if (hk_check_argument_string(args, 1) == HK_STATUS_ERROR)
     return HK_STATUS_ERROR;
   hk_string_t *str = hk_as_string(args[1]);
-  fprintf(stderr, "panic: %.*s\n", str->length, str->chars);
+  fprintf(stderr, "panic: %.*s\n", str->length, hk_string_chars(str));
   return HK_STATUS_NO_TRACE;
 }
 
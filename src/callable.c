@@ -7,6 +7,11 @@
 #include <stdlib.h>
 #include <hook/memory.h>
 #include <hook/utils.h>
+#include "gc.h"
+
+#ifdef HK_JIT
+  #include "jit.h"
+#endif
 
 #define MIN_CAPACITY (1 << 3)
 
@@ -25,6 +30,9 @@ static inline hk_function_t *function_allocate(int32_t arity, hk_string_t *name,
   fn->name = name;
   hk_incr_ref(file);
   fn->file = file;
+  fn->num_removed = 0;
+  fn->num_calls = 0;
+  fn->jit_code = NULL;
   return fn;
 }
 
@@ -39,14 +47,14 @@ static inline void free_functions(hk_function_t *fn)
 {
   for (int32_t i = 0; i < fn->functions_length; ++i)
     hk_function_release(fn->functions[i]);
-  free(fn->functions);
+  hk_free(fn->functions);
 }
 
 static inline void grow_functions(hk_function_t *fn)
 {
   if (fn->functions_length < fn->functions_capacity)
     return;
-  uint8_t capacity = fn->functions_capacity << 1;
+  int32_t capacity = fn->functions_capacity << 1;
   fn->functions_capacity = capacity;
   fn->functions = (hk_function_t **) hk_reallocate(fn->functions,
     sizeof(*fn->functions) * capacity);
@@ -58,6 +66,7 @@ hk_function_t *hk_function_new(int32_t arity, hk_string_t *name, hk_string_t *fi
   hk_chunk_init(&fn->chunk);
   init_functions(fn);
   fn->num_nonlocals = 0;
+  fn->max_stack = 0;
   return fn;
 }
 
@@ -69,7 +78,10 @@ void hk_function_free(hk_function_t *fn)
   hk_string_release(fn->file);
   hk_chunk_free(&fn->chunk);
   free_functions(fn);
-  free(fn);
+#ifdef HK_JIT
+  jit_free(fn);
+#endif
+  hk_free(fn);
 }
 
 void hk_function_release(hk_function_t *fn)
@@ -99,6 +111,7 @@ void hk_function_serialize(hk_function_t *fn, FILE *stream)
   for (int32_t i = 0; i < fn->functions_length; ++i)
     hk_function_serialize(functions[i], stream);
   fwrite(&fn->num_nonlocals, sizeof(fn->num_nonlocals), 1, stream);
+  fwrite(&fn->max_stack, sizeof(fn->max_stack), 1, stream);
 }
 
 hk_function_t *hk_function_deserialize(FILE *stream)
@@ -131,6 +144,8 @@ hk_function_t *hk_function_deserialize(FILE *stream)
   fn->functions = functions;
   if (fread(&fn->num_nonlocals, sizeof(fn->num_nonlocals), 1, stream) != 1)
     return NULL;
+  if (fread(&fn->max_stack, sizeof(fn->max_stack), 1, stream) != 1)
+    return NULL;
   return fn;
 }
 
@@ -138,7 +153,9 @@ hk_closure_t *hk_closure_new(hk_function_t *fn)
 {
   int32_t size = sizeof(hk_closure_t) + sizeof(hk_value_t) * (fn->num_nonlocals - 1);
   hk_closure_t *cl = (hk_closure_t *) hk_allocate(size);
+  hk_memory_tag(cl, HK_TYPE_CALLABLE | HK_MEMORY_OBJECT);
   cl->ref_count = 0;
+  cl->gc_flags = 0;
   hk_incr_ref(fn);
   cl->fn = fn;
   return cl;
@@ -151,14 +168,20 @@ void hk_closure_free(hk_closure_t *cl)
   hk_function_release(fn);
   for (int32_t i = 0; i < num_nonlocals; ++i)
     hk_value_release(cl->nonlocals[i]);
-  free(cl);
+  if (gc_is_buffered(cl))
+    return;
+  hk_free(cl);
 }
 
 void hk_closure_release(hk_closure_t *cl)
 {
   hk_decr_ref(cl);
   if (hk_is_unreachable(cl))
+  {
     hk_closure_free(cl);
+    return;
+  }
+  gc_possible_root(hk_closure_value(cl));
 }
 
 hk_native_t *hk_native_new(hk_string_t *name, int32_t arity, int32_t (*call)(struct hk_state *, hk_value_t *))
@@ -175,7 +198,7 @@ hk_native_t *hk_native_new(hk_string_t *name, int32_t arity, int32_t (*call)(str
 void hk_native_free(hk_native_t *native)
 {
   hk_string_release(native->name);
-  free(native);
+  hk_free(native);
 }
 
 void hk_native_release(hk_native_t *native)
@@ -23,7 +23,7 @@ static inline void type_error(int32_t index, int32_t num_types, hk_type_t types[
 
 int32_t hk_check_argument_type(hk_value_t *args, int32_t index, hk_type_t type)
 {
-  hk_type_t val_type = args[index].type;
+  hk_type_t val_type = hk_type(args[index]);
   if (val_type != type)
   {
     hk_runtime_error("type error: argument #%d must be of the type %s, %s given", index,
@@ -35,7 +35,7 @@ int32_t hk_check_argument_type(hk_value_t *args, int32_t index, hk_type_t type)
 
 int32_t hk_check_argument_types(hk_value_t *args, int32_t index, int32_t num_types, hk_type_t types[])
 {
-  hk_type_t val_type = args[index].type;
+  hk_type_t val_type = hk_type(args[index]);
   bool match = false;
   for (int32_t i = 0; i < num_types; ++i)
     if ((match = (val_type == types[i])))
@@ -64,7 +64,7 @@ int32_t hk_check_argument_int(hk_value_t *args, int32_t index)
   if (!hk_is_int(val))
   {
     hk_runtime_error("type error: argument #%d must be of the type int, %s given",
-      index, hk_type_name(val.type));
+      index, hk_type_name(hk_type(val)));
     return HK_STATUS_ERROR;
   }
   return HK_STATUS_OK;
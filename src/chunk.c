@@ -13,6 +13,10 @@
 static inline void ensure_code_capacity(hk_chunk_t *chunk, int32_t min_capacity);
 static inline void init_lines(hk_chunk_t *chunk);
 static inline void grow_lines(hk_chunk_t *chunk);
+static inline void init_inlines(hk_chunk_t *chunk);
+static inline void grow_inlines(hk_chunk_t *chunk);
+static inline void init_caches(hk_chunk_t *chunk, int32_t length);
+static inline void grow_caches(hk_chunk_t *chunk);
 
 static inline void ensure_code_capacity(hk_chunk_t *chunk, int32_t min_capacity)
 {
@@ -40,20 +44,69 @@ static inline void grow_lines(hk_chunk_t *chunk)
     sizeof(*chunk->lines) * capacity);
 }
 
+static inline void init_inlines(hk_chunk_t *chunk)
+{
+  chunk->inlines_capacity = 0;
+  chunk->inlines_length = 0;
+  chunk->inlines = NULL;
+}
+
+static inline void grow_inlines(hk_chunk_t *chunk)
+{
+  if (chunk->inlines_length < chunk->inlines_capacity)
+    return;
+  int32_t capacity = chunk->inlines_capacity ? chunk->inlines_capacity << 1 : MIN_CAPACITY;
+  chunk->inlines_capacity = capacity;
+  chunk->inlines = (hk_inline_t *) hk_reallocate(chunk->inlines,
+    sizeof(*chunk->inlines) * capacity);
+}
+
+static inline void init_caches(hk_chunk_t *chunk, int32_t length)
+{
+  int32_t capacity = length < MIN_CAPACITY ? MIN_CAPACITY : hk_power_of_two_ceil(length);
+  chunk->caches_capacity = capacity;
+  chunk->caches_length = length;
+  chunk->caches = (hk_field_cache_t *) hk_allocate(sizeof(*chunk->caches) * capacity);
+  for (int32_t i = 0; i < length; ++i)
+    chunk->caches[i].ztruct = NULL;
+}
+
+static inline void grow_caches(hk_chunk_t *chunk)
+{
+  if (chunk->caches_length < chunk->caches_capacity)
+    return;
+  int32_t capacity = chunk->caches_capacity << 1;
+  chunk->caches_capacity = capacity;
+  chunk->caches = (hk_field_cache_t *) hk_reallocate(chunk->caches,
+    sizeof(*chunk->caches) * capacity);
+}
+
 void hk_chunk_init(hk_chunk_t *chunk)
 {
   chunk->code_capacity = MIN_CAPACITY;
   chunk->code_length = 0;
   chunk->code = (uint8_t *) hk_allocate(chunk->code_capacity);
   init_lines(chunk);
+  init_inlines(chunk);
   chunk->consts = hk_array_new();
+  init_caches(chunk, 0);
 }
 
 void hk_chunk_free(hk_chunk_t *chunk)
 {
-  free(chunk->code);
-  free(chunk->lines);
+  hk_free(chunk->code);
+  hk_free(chunk->lines);
+  for (int32_t i = 0; i < chunk->inlines_length; ++i)
+    hk_string_release(chunk->inlines[i].name);
+  hk_free(chunk->inlines);
   hk_array_free(chunk->consts);
+  for (int32_t i = 0; i < chunk->caches_length; ++i)
+  {
+    hk_struct_t *ztruct = chunk->caches[i].ztruct;
+    if (ztruct)
+      hk_struct_release(ztruct);
+  }
+  hk_free(chunk->caches);
 }
 
 void hk_chunk_emit_byte(hk_chunk_t *chunk, uint8_t byte)
@@ -98,6 +151,28 @@ int32_t hk_chunk_get_line(hk_chunk_t *chunk, int32_t offset)
   return result;
 }
 
+void hk_chunk_add_inline(hk_chunk_t *chunk, int32_t start, int32_t end, int32_t line,
+  hk_string_t *name)
+{
+  grow_inlines(chunk);
+  hk_inline_t *inl = &chunk->inlines[chunk->inlines_length];
+  inl->start = start;
+  inl->end = end;
+  inl->line = line;
+  hk_incr_ref(name);
+  inl->name = name;
+  ++chunk->inlines_length;
+}
+
+int32_t hk_chunk_add_cache(hk_chunk_t *chunk)
+{
+  grow_caches(chunk);
+  int32_t index = chunk->caches_length;
+  chunk->caches[index].ztruct = NULL;
+  ++chunk->caches_length;
+  return index;
+}
+
 void hk_chunk_serialize(hk_chunk_t *chunk, FILE *stream)
 {
   fwrite(&chunk->code_capacity, sizeof(chunk->code_capacity), 1, stream);
@@ -110,7 +185,17 @@ void hk_chunk_serialize(hk_chunk_t *chunk, FILE *stream)
     hk_line_t *line = &chunk->lines[i];
     fwrite(line, sizeof(*line), 1, stream);
   }
+  fwrite(&chunk->inlines_length, sizeof(chunk->inlines_length), 1, stream);
+  for (int32_t i = 0; i < chunk->inlines_length; ++i)
+  {
+    hk_inline_t *inl = &chunk->inlines[i];
+    fwrite(&inl->start, sizeof(inl->start), 1, stream);
+    fwrite(&inl->end, sizeof(inl->end), 1, stream);
+    fwrite(&inl->line, sizeof(inl->line), 1, stream);
+    hk_string_serialize(inl->name, stream);
+  }
   hk_array_serialize(chunk->consts, stream);
+  fwrite(&chunk->caches_length, sizeof(chunk->caches_length), 1, stream);
 }
 
 bool hk_chunk_deserialize(hk_chunk_t *chunk, FILE *stream)
@@ -133,9 +218,31 @@ bool hk_chunk_deserialize(hk_chunk_t *chunk, FILE *stream)
     if (fread(line, sizeof(*line), 1, stream) != 1)
       return false;
   }
+  int32_t inlines_length;
+  if (fread(&inlines_length, sizeof(inlines_length), 1, stream) != 1)
+    return false;
+  init_inlines(chunk);
+  for (int32_t i = 0; i < inlines_length; ++i)
+  {
+    int32_t start;
+    int32_t end;
+    int32_t line;
+    if (fread(&start, sizeof(start), 1, stream) != 1
+      || fread(&end, sizeof(end), 1, stream) != 1
+      || fread(&line, sizeof(line), 1, stream) != 1)
+      return false;
+    hk_string_t *name = hk_string_deserialize(stream);
+    if (!name)
+      return false;
+    hk_chunk_add_inline(chunk, start, end, line, name);
+  }
   chunk->consts = hk_array_deserialize(stream);
   if (!chunk->consts)
     return false;
   hk_incr_ref(chunk->consts);
+  int32_t caches_length;
+  if (fread(&caches_length, sizeof(caches_length), 1, stream) != 1)
+    return false;
+  init_caches(chunk, caches_length);
   return true;
 }
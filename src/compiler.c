@@ -9,14 +9,22 @@
 #include <errno.h>
 #include <limits.h>
 #include <stdarg.h>
+#include <math.h>
 #include <hook/struct.h>
+#include <hook/memory.h>
 #include <hook/utils.h>
 #include "scanner.h"
 #include "builtin.h"
 
-#define MAX_CONSTANTS UINT8_MAX
-#define MAX_VARIABLES UINT8_MAX
-#define MAX_BREAKS    UINT8_MAX
+#define MAX_CONSTANTS UINT16_MAX
+#define MAX_VARIABLES UINT16_MAX
+#define MAX_NONLOCALS UINT8_MAX
+#define MAX_FUNCTIONS UINT16_MAX
+#define MAX_BREAKS    UINT16_MAX
+
+#define MAX_INLINE_SIZE 48
+
+#define MIN_CAPACITY (1 << 3)
 
 typedef enum
 {
@@ -26,6 +34,13 @@ typedef enum
   PRODUCTION_SUBSCRIPT
 } production_t;
 
+typedef enum
+{
+  TYPE_ANY,
+  TYPE_NUMBER,
+  TYPE_NUMBER_CALLEE
+} type_t;
+
 #define match(s, t) ((s)->token.type == (t))
 
 #define consume(c, t) do \
@@ -45,10 +60,13 @@ typedef struct
 {
   bool is_local;
   int32_t depth;
-  uint8_t index;
+  uint16_t index;
   int32_t length;
   char *start;
   bool is_mutable;
+  bool is_constant;
+  hk_value_t value;
+  hk_function_t *fn;
 } variable_t;
 
 typedef struct loop
@@ -56,20 +74,37 @@ typedef struct loop
   struct loop *parent;
   int32_t scope_depth;
   uint16_t jump;
+  int32_t offsets_capacity;
   int32_t num_offsets;
-  int32_t offsets[MAX_BREAKS];
+  int32_t *offsets;
 } loop_t;
 
 typedef struct compiler
 {
   struct compiler *parent;
   scanner_t *scan;
+  int32_t flags;
   int32_t scope_depth;
+  int32_t variables_capacity;
   int32_t num_variables;
-  uint8_t next_index;
-  variable_t variables[MAX_VARIABLES];
+  uint16_t next_index;
+  variable_t *variables;
   loop_t *loop;
   hk_function_t *fn;
+  int32_t last_label;
+  int32_t last_load;
+  int32_t last_nonlocal;
+  int32_t last_less;
+  int32_t last_call;
+  int32_t last_range;
+  int32_t statement_start;
+  uint16_t statement_depth;
+  int32_t pending_fetches;
+  hk_function_t *callee;
+  int32_t callee_offset;
+  int32_t assign_index;
+  int32_t assign_offset;
+  int32_t assign_loads;
 } compiler_t;
 
 static inline void syntax_error(hk_string_t *name, const char *file, int32_t line,
@@ -77,17 +112,19 @@ static inline void syntax_error(hk_string_t *name, const char *file, int32_t lin
 static inline void syntax_error_unexpected(compiler_t *comp);
 static inline double parse_double(compiler_t *comp);
 static inline bool string_match(token_t *tk, hk_string_t *str);
-static inline uint8_t add_number_constant(compiler_t *comp, double data);
-static inline uint8_t add_string_constant(compiler_t *comp, token_t *tk);
-static inline uint8_t add_constant(compiler_t *comp, hk_value_t val);
+static inline uint16_t add_number_constant(compiler_t *comp, double data);
+static inline uint16_t add_string_constant(compiler_t *comp, token_t *tk);
+static inline uint16_t add_constant(compiler_t *comp, hk_value_t val);
 static inline void push_scope(compiler_t *comp);
 static inline void pop_scope(compiler_t *comp);
 static inline int32_t discard_variables(compiler_t *comp, int32_t depth);
 static inline bool variable_match(token_t *tk, variable_t *var);
 static inline void add_local(compiler_t *comp, token_t *tk, bool is_mutable);
+static inline void add_hidden_local(compiler_t *comp);
 static inline uint8_t add_nonlocal(compiler_t *comp, token_t *tk);
-static inline void add_variable(compiler_t *comp, bool is_local, uint8_t index, token_t *tk,
+static inline void add_variable(compiler_t *comp, bool is_local, uint16_t index, token_t *tk,
   bool is_mutable);
+static inline uint16_t add_function(compiler_t *comp, compiler_t *child);
 static inline void define_local(compiler_t *comp, token_t *tk, bool is_mutable);
 static inline variable_t resolve_variable(compiler_t *comp, token_t *tk);
 static inline variable_t *lookup_variable(compiler_t *comp, token_t *tk);
@@ -95,10 +132,38 @@ static inline bool nonlocal_exists(compiler_t *comp, token_t *tk);
 static inline int32_t emit_jump(hk_chunk_t *chunk, hk_opcode_t op);
 static inline void patch_jump(compiler_t *comp, int32_t offset);
 static inline void patch_opcode(hk_chunk_t *chunk, int32_t offset, hk_opcode_t op);
+static inline void add_label(compiler_t *comp);
+static inline int32_t emit_index(hk_chunk_t *chunk, hk_opcode_t op, uint16_t index);
+static inline void emit_load(compiler_t *comp, uint16_t index);
+static inline void emit_nonlocal(compiler_t *comp, uint8_t index);
+static inline bool read_constant(compiler_t *comp, int32_t start, int32_t end, hk_value_t *val);
+static inline bool fold_unary(hk_opcode_t op, hk_value_t val, hk_value_t *result);
+static inline bool fold_binary(hk_opcode_t op, hk_value_t val1, hk_value_t val2,
+  hk_value_t *result);
+static inline bool fits_int(double data);
+static inline void emit_constant(compiler_t *comp, hk_value_t val);
+static inline void emit_unary(compiler_t *comp, int32_t start, hk_opcode_t op);
+static inline void emit_binary(compiler_t *comp, int32_t start, int32_t offset, hk_opcode_t op);
+static inline bool take_condition(compiler_t *comp, int32_t start, bool not, bool *taken);
+static inline void compile_dead_statement(compiler_t *comp);
+static inline void start_assign(compiler_t *comp, variable_t *var);
+static inline void end_assign(compiler_t *comp);
+static inline int32_t emit_jump_if_false(compiler_t *comp);
+static inline void emit_call(compiler_t *comp, uint8_t num_args);
+static inline uint16_t copy_constant(compiler_t *comp, hk_value_t val);
+static inline int32_t stack_depth(compiler_t *comp, int32_t end);
+static inline bool is_inline_slot(int32_t base, uint8_t index);
+static inline bool can_inline(hk_function_t *callee, int32_t base, int32_t *length);
+static inline bool inline_call(compiler_t *comp, hk_function_t *callee, int32_t start,
+  int32_t offset, uint8_t num_args);
+static inline void emit_cache(compiler_t *comp);
+static inline void emit_get_element(compiler_t *comp);
+static inline void emit_get_field(compiler_t *comp, uint16_t index);
 static inline void start_loop(compiler_t *comp, loop_t *loop);
 static inline void end_loop(compiler_t *comp);
 static inline void compiler_init(compiler_t *comp, compiler_t *parent, scanner_t *scan,
   hk_string_t *name);
+static inline void compiler_free(compiler_t *comp);
 static void compile_statement(compiler_t *comp);
 static void compile_import_statement(compiler_t *comp);
 static void compile_constant_declaration(compiler_t *comp);
@@ -119,6 +184,7 @@ static void compile_while_statement(compiler_t *comp, bool not);
 static void compile_do_statement(compiler_t *comp);
 static void compile_for_statement(compiler_t *comp);
 static void compile_foreach_statement(compiler_t *comp);
+static void compile_range_loop(compiler_t *comp);
 static void compile_continue_statement(compiler_t *comp);
 static void compile_break_statement(compiler_t *comp);
 static void compile_return_statement(compiler_t *comp);
@@ -145,6 +211,24 @@ static void compile_match_expression_member(compiler_t *comp);
 static void compile_subscript(compiler_t *comp);
 static variable_t compile_variable(compiler_t *comp, token_t *tk, bool emit);
 static variable_t *compile_nonlocal(compiler_t *comp, token_t *tk);
+static inline void mark_depth(int32_t *depths, int32_t *offsets, int32_t *length,
+  int32_t offset, int32_t depth);
+static inline int32_t instruction_size(uint8_t *pc);
+static inline bool is_jump(hk_opcode_t op);
+static inline bool is_pure_push(uint8_t *pc);
+static inline bool is_number_result(hk_opcode_t op, bool allow_negative_zero);
+static inline int32_t thread_jump(uint8_t *code, int32_t target);
+static void optimize_function(hk_function_t *fn);
+static inline int32_t stack_effect(hk_function_t *fn, uint8_t *pc, int32_t *jump_effect);
+static int32_t compute_depth(hk_function_t *fn, int32_t start, int32_t depth, int32_t end);
+static void compute_max_stack(hk_function_t *fn);
+static inline bool is_number_callee(uint8_t index);
+static inline void mark_types(int32_t *depths, uint8_t *states, int32_t size, bool *queued,
+  int32_t *entries, int32_t *length, int32_t entry, uint8_t *types, int32_t depth);
+static inline void rewrite_opcode(uint8_t *pc, uint8_t *types, int32_t depth);
+static inline void update_types(hk_function_t *fn, uint8_t *pc, uint8_t *types, int32_t depth,
+  int32_t next_depth);
+static void infer_types(hk_function_t *fn);
 
 static inline void syntax_error(hk_string_t *name, const char *file, int32_t line,
   int32_t col, const char *fmt, ...)
@@ -188,7 +272,7 @@ static inline bool string_match(token_t *tk, hk_string_t *str)
     && !memcmp(tk->start, str->chars, tk->length);
 }
 
-static inline uint8_t add_number_constant(compiler_t *comp, double data)
+static inline uint16_t add_number_constant(compiler_t *comp, double data)
 {
   hk_array_t *consts = comp->fn->chunk.consts;
   hk_value_t *elements = consts->elements;
@@ -198,12 +282,12 @@ static inline uint8_t add_number_constant(compiler_t *comp, double data)
     if (!hk_is_number(elem))
       continue;
     if (data == hk_as_number(elem))
-      return (uint8_t) i;
+      return (uint16_t) i;
   }
   return add_constant(comp, hk_number_value(data));
 }
 
-static inline uint8_t add_string_constant(compiler_t *comp, token_t *tk)
+static inline uint16_t add_string_constant(compiler_t *comp, token_t *tk)
 {
   hk_array_t *consts = comp->fn->chunk.consts;
   hk_value_t *elements = consts->elements;
@@ -213,13 +297,16 @@ static inline uint8_t add_string_constant(compiler_t *comp, token_t *tk)
     if (!hk_is_string(elem))
       continue;
     if (string_match(tk, hk_as_string(elem)))
-      return (uint8_t) i;
+      return (uint16_t) i;
   }
   hk_string_t *str = hk_string_from_chars(tk->length, tk->start);
-  return add_constant(comp, hk_string_value(str));
+  hk_string_t *interned = hk_string_intern(str);
+  if (interned != str)
+    hk_string_free(str);
+  return add_constant(comp, hk_string_value(interned));
 }
 
-static inline uint8_t add_constant(compiler_t *comp, hk_value_t val)
+static inline uint16_t add_constant(compiler_t *comp, hk_value_t val)
 {
   hk_function_t *fn = comp->fn;
   hk_array_t *consts = fn->chunk.consts;
@@ -228,7 +315,7 @@ static inline uint8_t add_constant(compiler_t *comp, hk_value_t val)
   if (consts->length == MAX_CONSTANTS)
     syntax_error(fn->name, scan->file->chars, tk->line, tk->col,
       "a function may only contain %d unique constants", MAX_CONSTANTS);
-  uint8_t index = (uint8_t) consts->length;
+  uint16_t index = (uint16_t) consts->length;
   hk_array_inplace_add_element(consts, val);
   return index;
 }
@@ -243,7 +330,7 @@ static inline void pop_scope(compiler_t *comp)
   comp->num_variables -= discard_variables(comp, comp->scope_depth);
   --comp->scope_depth;
   int32_t index = comp->num_variables - 1;
-  comp->next_index = comp->variables[index].index + 1;
+  comp->next_index = index > -1 ? comp->variables[index].index + 1 : 1;
 }
 
 static inline int32_t discard_variables(compiler_t *comp, int32_t depth)
@@ -265,23 +352,41 @@ static inline bool variable_match(token_t *tk, variable_t *var)
 
 static inline void add_local(compiler_t *comp, token_t *tk, bool is_mutable)
 {
-  uint8_t index = comp->next_index++;
+  uint16_t index = comp->next_index++;
   add_variable(comp, true, index, tk, is_mutable);
 }
 
+static inline void add_hidden_local(compiler_t *comp)
+{
+  token_t tk = comp->scan->token;
+  tk.length = 0;
+  add_local(comp, &tk, false);
+}
+
 static inline uint8_t add_nonlocal(compiler_t *comp, token_t *tk)
 {
-  uint8_t index = comp->fn->num_nonlocals++;
+  hk_function_t *fn = comp->fn;
+  if (fn->num_nonlocals == MAX_NONLOCALS)
+    syntax_error(fn->name, comp->scan->file->chars, tk->line, tk->col,
+      "a function may only contain %d non-local variables", MAX_NONLOCALS);
+  uint8_t index = fn->num_nonlocals++;
   add_variable(comp, false, index, tk, false);
   return index;
 }
 
-static inline void add_variable(compiler_t *comp, bool is_local, uint8_t index, token_t *tk,
+static inline void add_variable(compiler_t *comp, bool is_local, uint16_t index, token_t *tk,
   bool is_mutable)
 {
   if (comp->num_variables == MAX_VARIABLES)
     syntax_error(comp->fn->name, comp->scan->file->chars, tk->line, tk->col,
       "a function may only contain %d unique variables", MAX_VARIABLES);
+  if (comp->num_variables == comp->variables_capacity)
+  {
+    int32_t capacity = comp->variables_capacity << 1;
+    comp->variables_capacity = capacity;
+    comp->variables = (variable_t *) hk_reallocate(comp->variables,
+      sizeof(*comp->variables) * capacity);
+  }
   variable_t *var = &comp->variables[comp->num_variables];
   var->is_local = is_local;
   var->depth = comp->scope_depth;
@@ -289,6 +394,8 @@ static inline void add_variable(compiler_t *comp, bool is_local, uint8_t index,
   var->length = tk->length;
   var->start = tk->start;
   var->is_mutable = is_mutable;
+  var->is_constant = false;
+  var->fn = NULL;
   ++comp->num_variables;
 }
 
@@ -306,6 +413,20 @@ static inline void define_local(compiler_t *comp, token_t *tk, bool is_mutable)
   add_local(comp, tk, is_mutable);
 }
 
+static inline uint16_t add_function(compiler_t *comp, compiler_t *child)
+{
+  hk_function_t *fn = comp->fn;
+  scanner_t *scan = comp->scan;
+  token_t *tk = &scan->token;
+  if (fn->functions_length == MAX_FUNCTIONS)
+    syntax_error(fn->name, scan->file->chars, tk->line, tk->col,
+      "a function may only contain %d nested functions", MAX_FUNCTIONS);
+  uint16_t index = (uint16_t) fn->functions_length;
+  hk_function_add_child(fn, child->fn);
+  compiler_free(child);
+  return index;
+}
+
 static inline variable_t resolve_variable(compiler_t *comp, token_t *tk)
 {
   variable_t *var = lookup_variable(comp, tk);
@@ -353,6 +474,7 @@ static inline void patch_jump(compiler_t *comp, int32_t offset)
     syntax_error(comp->fn->name, scan->file->chars, tk->line, tk->col,
       "code too large");
   *((uint16_t *) &chunk->code[offset]) = (uint16_t) jump;
+  add_label(comp);
 }
 
 static inline void patch_opcode(hk_chunk_t *chunk, int32_t offset, hk_opcode_t op)
@@ -360,12 +482,615 @@ static inline void patch_opcode(hk_chunk_t *chunk, int32_t offset, hk_opcode_t o
   chunk->code[offset] = (uint8_t) op;
 }
 
+static inline void add_label(compiler_t *comp)
+{
+  comp->last_label = comp->fn->chunk.code_length;
+}
+
+static inline int32_t emit_index(hk_chunk_t *chunk, hk_opcode_t op, uint16_t index)
+{
+  if (index > UINT8_MAX)
+    hk_chunk_emit_opcode(chunk, HK_OP_WIDE);
+  int32_t offset = chunk->code_length;
+  hk_chunk_emit_opcode(chunk, op);
+  if (index > UINT8_MAX)
+    hk_chunk_emit_word(chunk, index);
+  else
+    hk_chunk_emit_byte(chunk, (uint8_t) index);
+  return offset;
+}
+
+static inline void emit_load(compiler_t *comp, uint16_t index)
+{
+  hk_chunk_t *chunk = &comp->fn->chunk;
+  int32_t offset = chunk->code_length;
+  if (index == comp->assign_index)
+    ++comp->assign_loads;
+  if (index > UINT8_MAX)
+  {
+    emit_index(chunk, HK_OP_LOAD, index);
+    comp->last_load = -1;
+    return;
+  }
+  if (comp->last_load == offset - 2 && comp->last_label != offset
+    && chunk->code[comp->last_load] == HK_OP_LOAD)
+  {
+    patch_opcode(chunk, comp->last_load, HK_OP_LOAD_LOAD);
+    hk_chunk_emit_byte(chunk, (uint8_t) index);
+    return;
+  }
+  hk_chunk_emit_opcode(chunk, HK_OP_LOAD);
+  hk_chunk_emit_byte(chunk, (uint8_t) index);
+  comp->last_load = index == comp->assign_index && offset == comp->assign_offset ? -1 : offset;
+}
+
+static inline void emit_nonlocal(compiler_t *comp, uint8_t index)
+{
+  hk_chunk_t *chunk = &comp->fn->chunk;
+  comp->last_nonlocal = chunk->code_length;
+  hk_chunk_emit_opcode(chunk, HK_OP_NONLOCAL);
+  hk_chunk_emit_byte(chunk, index);
+}
+
+static inline void start_assign(compiler_t *comp, variable_t *var)
+{
+  if (!var->is_local || !var->is_mutable)
+    return;
+  comp->assign_index = var->index;
+  comp->assign_offset = comp->fn->chunk.code_length;
+  comp->assign_loads = 0;
+  comp->last_load = -1;
+}
+
+static inline void end_assign(compiler_t *comp)
+{
+  hk_chunk_t *chunk = &comp->fn->chunk;
+  int32_t offset = comp->assign_offset;
+  if (offset == -1)
+    return;
+  if (comp->assign_loads == 1 && chunk->code[offset] == HK_OP_LOAD
+    && chunk->code[offset + 1] == comp->assign_index)
+    patch_opcode(chunk, offset, HK_OP_MOVE);
+  comp->assign_index = -1;
+  comp->assign_offset = -1;
+}
+
+static inline int32_t emit_jump_if_false(compiler_t *comp)
+{
+  hk_chunk_t *chunk = &comp->fn->chunk;
+  int32_t offset = chunk->code_length;
+  if (comp->last_less == offset - 1 && comp->last_label != offset)
+  {
+    --chunk->code_length;
+    return emit_jump(chunk, HK_OP_JUMP_IF_NOT_LESS);
+  }
+  return emit_jump(chunk, HK_OP_JUMP_IF_FALSE);
+}
+
+static inline void emit_call(compiler_t *comp, uint8_t num_args)
+{
+  hk_chunk_t *chunk = &comp->fn->chunk;
+  comp->last_call = chunk->code_length;
+  hk_chunk_emit_opcode(chunk, HK_OP_CALL);
+  hk_chunk_emit_byte(chunk, num_args);
+}
+
+static inline uint16_t copy_constant(compiler_t *comp, hk_value_t val)
+{
+  if (hk_is_number(val))
+    return add_number_constant(comp, hk_as_number(val));
+  hk_array_t *consts = comp->fn->chunk.consts;
+  hk_value_t *elements = consts->elements;
+  if (hk_is_string(val))
+    for (int32_t i = 0; i < consts->length; ++i)
+    {
+      hk_value_t elem = elements[i];
+      if (hk_is_string(elem) && hk_string_equal(hk_as_string(elem), hk_as_string(val)))
+        return (uint16_t) i;
+    }
+  return add_constant(comp, val);
+}
+
+static inline int32_t stack_depth(compiler_t *comp, int32_t end)
+{
+  if (comp->pending_fetches)
+    return -1;
+  if (comp->statement_start == -1)
+    return compute_depth(comp->fn, 0, comp->next_index, end);
+  return compute_depth(comp->fn, comp->statement_start, comp->statement_depth, end);
+}
+
+static inline bool is_inline_slot(int32_t base, uint8_t index)
+{
+  return index && base + index <= UINT8_MAX;
+}
+
+static inline bool can_inline(hk_function_t *callee, int32_t base, int32_t *length)
+{
+  uint8_t *code = callee->chunk.code;
+  int32_t end = 0;
+  while (code[end] != HK_OP_RETURN && code[end] != HK_OP_RETURN_NIL)
+  {
+    end += instruction_size(&code[end]);
+    if (end >= MAX_INLINE_SIZE)
+      return false;
+  }
+  for (int32_t i = 0; i < end; i += instruction_size(&code[i]))
+  {
+    uint8_t *pc = &code[i];
+    hk_opcode_t op = (hk_opcode_t) pc[0];
+    switch (op)
+    {
+    case HK_OP_WIDE:
+    case HK_OP_CLOSURE:
+    case HK_OP_NONLOCAL:
+    case HK_OP_NONLOCAL_ELEMENT:
+    case HK_OP_NONLOCAL_FIELD:
+      return false;
+    case HK_OP_LOAD_LOAD:
+    case HK_OP_LOAD_ELEMENT:
+      if (!is_inline_slot(base, pc[1]) || !is_inline_slot(base, pc[2]))
+        return false;
+      break;
+    case HK_OP_LOAD:
+    case HK_OP_MOVE:
+    case HK_OP_STORE:
+    case HK_OP_INCREMENT_LOCAL:
+    case HK_OP_DECREMENT_LOCAL:
+    case HK_OP_INCREMENT_NUM:
+    case HK_OP_DECREMENT_NUM:
+    case HK_OP_LOAD_FIELD:
+      if (!is_inline_slot(base, pc[1]))
+        return false;
+      break;
+    default:
+      if (is_jump(op) && *((uint16_t *) &pc[1]) > end)
+        return false;
+      break;
+    }
+  }
+  *length = end;
+  return true;
+}
+
+static inline bool inline_call(compiler_t *comp, hk_function_t *callee, int32_t start,
+  int32_t offset, uint8_t num_args)
+{
+  hk_function_t *fn = comp->fn;
+  hk_chunk_t *chunk = &fn->chunk;
+  hk_chunk_t *callee_chunk = &callee->chunk;
+  if (!(comp->flags & HK_COMPILER_FLAG_INLINE) || callee->arity != num_args
+    || callee->num_nonlocals || callee->functions_length)
+    return false;
+  if (chunk->consts->length + callee_chunk->consts->length > UINT8_MAX + 1
+    || chunk->caches_length + callee_chunk->caches_length > UINT16_MAX + 1
+    || chunk->code_length + MAX_INLINE_SIZE > UINT16_MAX)
+    return false;
+  int32_t base = stack_depth(comp, start);
+  if (base == -1)
+    base = stack_depth(comp, offset) - 1;
+  int32_t length;
+  if (base < 1 || base > UINT8_MAX || !can_inline(callee, base, &length))
+    return false;
+  int32_t depth = compute_depth(callee, 0, callee->arity + 1, length);
+  if (depth == -1)
+    return false;
+  uint8_t *code = callee_chunk->code;
+  hk_value_t *consts = callee_chunk->consts->elements;
+  int32_t dest = chunk->code_length;
+  for (int32_t i = 0; i < length;)
+  {
+    uint8_t *pc = &code[i];
+    int32_t size = instruction_size(pc);
+    hk_opcode_t op = (hk_opcode_t) pc[0];
+    int32_t at = chunk->code_length;
+    for (int32_t j = 0; j < size; ++j)
+      hk_chunk_emit_byte(chunk, pc[j]);
+    uint8_t *operands = &chunk->code[at + 1];
+    switch (op)
+    {
+    case HK_OP_LOAD_LOAD:
+    case HK_OP_LOAD_ELEMENT:
+      operands[1] = (uint8_t) (base + pc[2]);
+      operands[0] = (uint8_t) (base + pc[1]);
+      break;
+    case HK_OP_LOAD:
+    case HK_OP_MOVE:
+    case HK_OP_STORE:
+    case HK_OP_INCREMENT_LOCAL:
+    case HK_OP_DECREMENT_LOCAL:
+    case HK_OP_INCREMENT_NUM:
+    case HK_OP_DECREMENT_NUM:
+      operands[0] = (uint8_t) (base + pc[1]);
+      break;
+    case HK_OP_LOAD_FIELD:
+      operands[0] = (uint8_t) (base + pc[1]);
+      operands[1] = (uint8_t) copy_constant(comp, consts[pc[2]]);
+      *((uint16_t *) &operands[2]) = (uint16_t) hk_chunk_add_cache(chunk);
+      break;
+    case HK_OP_CONSTANT:
+      operands[0] = (uint8_t) copy_constant(comp, consts[pc[1]]);
+      break;
+    case HK_OP_GET_FIELD:
+    case HK_OP_FETCH_FIELD:
+    case HK_OP_PUT_FIELD:
+    case HK_OP_INPLACE_PUT_FIELD:
+      operands[0] = (uint8_t) copy_constant(comp, consts[pc[1]]);
+      *((uint16_t *) &operands[1]) = (uint16_t) hk_chunk_add_cache(chunk);
+      break;
+    case HK_OP_TAIL_CALL:
+      patch_opcode(chunk, at, HK_OP_CALL);
+      break;
+    default:
+      if (is_jump(op))
+        *((uint16_t *) operands) += (uint16_t) dest;
+      break;
+    }
+    i += size;
+  }
+  if (code[length] == HK_OP_RETURN_NIL)
+  {
+    hk_chunk_emit_opcode(chunk, HK_OP_NIL);
+    ++depth;
+  }
+  emit_index(chunk, HK_OP_STORE, (uint16_t) base);
+  for (; depth > 2; --depth)
+    hk_chunk_emit_opcode(chunk, HK_OP_POP);
+  for (int32_t i = 0; i < callee_chunk->inlines_length; ++i)
+  {
+    hk_inline_t *inl = &callee_chunk->inlines[i];
+    if (inl->start < length)
+      hk_chunk_add_inline(chunk, dest + inl->start, dest + (inl->end < length ? inl->end : length),
+        inl->line, inl->name);
+  }
+  int32_t first = 0;
+  int32_t line = hk_chunk_get_line(callee_chunk, 1);
+  for (int32_t i = 0; i < length; i += instruction_size(&code[i]))
+  {
+    int32_t next = hk_chunk_get_line(callee_chunk, i + 1);
+    if (next == line)
+      continue;
+    hk_chunk_add_inline(chunk, dest + first, dest + i, line, callee->name);
+    first = i;
+    line = next;
+  }
+  hk_chunk_add_inline(chunk, dest + first, dest + length, line, callee->name);
+  comp->last_load = -1;
+  comp->last_nonlocal = -1;
+  comp->last_less = -1;
+  comp->last_call = -1;
+  comp->last_range = -1;
+  add_label(comp);
+  return true;
+}
+
+static inline void emit_cache(compiler_t *comp)
+{
+  hk_chunk_t *chunk = &comp->fn->chunk;
+  scanner_t *scan = comp->scan;
+  token_t *tk = &scan->token;
+  if (chunk->caches_length > UINT16_MAX)
+    syntax_error(comp->fn->name, scan->file->chars, tk->line, tk->col,
+      "code too large");
+  hk_chunk_emit_word(chunk, (uint16_t) hk_chunk_add_cache(chunk));
+}
+
+static inline void emit_get_element(compiler_t *comp)
+{
+  hk_chunk_t *chunk = &comp->fn->chunk;
+  uint8_t *code = chunk->code;
+  int32_t offset = chunk->code_length;
+  if (comp->last_load == offset - 3 && comp->last_label != offset
+    && code[comp->last_load] == HK_OP_LOAD_LOAD)
+  {
+    patch_opcode(chunk, comp->last_load, HK_OP_LOAD_ELEMENT);
+    comp->last_load = -1;
+    return;
+  }
+  if (comp->last_nonlocal == offset - 4 && comp->last_load == offset - 2
+    && comp->last_label <= comp->last_nonlocal && code[comp->last_load] == HK_OP_LOAD)
+  {
+    patch_opcode(chunk, comp->last_nonlocal, HK_OP_NONLOCAL_ELEMENT);
+    code[offset - 2] = code[offset - 1];
+    --chunk->code_length;
+    comp->last_load = -1;
+    comp->last_nonlocal = -1;
+    return;
+  }
+  hk_chunk_emit_opcode(chunk, HK_OP_GET_ELEMENT);
+}
+
+static inline void emit_get_field(compiler_t *comp, uint16_t index)
+{
+  hk_chunk_t *chunk = &comp->fn->chunk;
+  int32_t offset = chunk->code_length;
+  if (comp->last_load == offset - 2 && comp->last_label != offset
+    && chunk->code[comp->last_load] == HK_OP_LOAD && index <= UINT8_MAX)
+  {
+    patch_opcode(chunk, comp->last_load, HK_OP_LOAD_FIELD);
+    comp->last_load = -1;
+    hk_chunk_emit_byte(chunk, (uint8_t) index);
+  }
+  else if (comp->last_nonlocal == offset - 2 && comp->last_label != offset && index <= UINT8_MAX)
+  {
+    patch_opcode(chunk, comp->last_nonlocal, HK_OP_NONLOCAL_FIELD);
+    comp->last_nonlocal = -1;
+    hk_chunk_emit_byte(chunk, (uint8_t) index);
+  }
+  else
+    emit_index(chunk, HK_OP_GET_FIELD, index);
+  emit_cache(comp);
+}
+
+static inline bool read_constant(compiler_t *comp, int32_t start, int32_t end, hk_value_t *val)
+{
+  hk_chunk_t *chunk = &comp->fn->chunk;
+  uint8_t *code = chunk->code;
+  int32_t length = end - start;
+  if (!(comp->flags & HK_COMPILER_FLAG_OPTIMIZE) || comp->last_label > start || length < 1)
+    return false;
+  switch (code[start])
+  {
+  case HK_OP_NIL:
+    *val = HK_NIL_VALUE;
+    return length == 1;
+  case HK_OP_FALSE:
+    *val = HK_FALSE_VALUE;
+    return length == 1;
+  case HK_OP_TRUE:
+    *val = HK_TRUE_VALUE;
+    return length == 1;
+  case HK_OP_INT:
+    *val = hk_number_value(*((uint16_t *) &code[start + 1]));
+    return length == 3;
+  case HK_OP_CONSTANT:
+    if (length != 2)
+      return false;
+    *val = chunk->consts->elements[code[start + 1]];
+    return hk_is_number(*val);
+  case HK_OP_WIDE:
+    if (length != 4 || code[start + 1] != HK_OP_CONSTANT)
+      return false;
+    *val = chunk->consts->elements[*((uint16_t *) &code[start + 2])];
+    return hk_is_number(*val);
+  default:
+    break;
+  }
+  return false;
+}
+
+static inline bool fold_unary(hk_opcode_t op, hk_value_t val, hk_value_t *result)
+{
+  if (op == HK_OP_NOT)
+  {
+    *result = hk_is_falsey(val) ? HK_TRUE_VALUE : HK_FALSE_VALUE;
+    return true;
+  }
+  if (!hk_is_number(val))
+    return false;
+  double num = hk_as_number(val);
+  double data;
+  switch (op)
+  {
+  case HK_OP_NEGATE:
+    data = -num;
+    break;
+  case HK_OP_BITWISE_NOT:
+    if (!fits_int(num))
+      return false;
+    data = (double) ~((int64_t) num);
+    break;
+  default:
+    return false;
+  }
+  if (data == 0 && signbit(data))
+    return false;
+  *result = hk_number_value(data);
+  return true;
+}
+
+static inline bool fold_binary(hk_opcode_t op, hk_value_t val1, hk_value_t val2,
+  hk_value_t *result)
+{
+  if (op == HK_OP_EQUAL || op == HK_OP_NOT_EQUAL)
+  {
+    bool equal = hk_value_equal(val1, val2);
+    *result = (op == HK_OP_EQUAL) == equal ? HK_TRUE_VALUE : HK_FALSE_VALUE;
+    return true;
+  }
+  if (op == HK_OP_GREATER || op == HK_OP_LESS || op == HK_OP_NOT_GREATER
+    || op == HK_OP_NOT_LESS)
+  {
+    int32_t cmp;
+    if (!hk_is_comparable(val1) || hk_type(val1) != hk_type(val2)
+      || !hk_value_compare(val1, val2, &cmp))
+      return false;
+    bool data = op == HK_OP_GREATER ? cmp > 0 : op == HK_OP_LESS ? cmp < 0 :
+      op == HK_OP_NOT_GREATER ? cmp <= 0 : cmp >= 0;
+    *result = data ? HK_TRUE_VALUE : HK_FALSE_VALUE;
+    return true;
+  }
+  if (!hk_is_number(val1) || !hk_is_number(val2))
+    return false;
+  double num1 = hk_as_number(val1);
+  double num2 = hk_as_number(val2);
+  bool ints = fits_int(num1) && fits_int(num2);
+  double data;
+  switch (op)
+  {
+  case HK_OP_ADD:
+    data = num1 + num2;
+    break;
+  case HK_OP_SUBTRACT:
+    data = num1 - num2;
+    break;
+  case HK_OP_MULTIPLY:
+    data = num1 * num2;
+    break;
+  case HK_OP_DIVIDE:
+    data = num1 / num2;
+    break;
+  case HK_OP_QUOTIENT:
+    data = floor(num1 / num2);
+    break;
+  case HK_OP_REMAINDER:
+    data = fmod(num1, num2);
+    break;
+  case HK_OP_BITWISE_OR:
+    if (!ints)
+      return false;
+    data = (double) (((int64_t) num1) | ((int64_t) num2));
+    break;
+  case HK_OP_BITWISE_XOR:
+    if (!ints)
+      return false;
+    data = (double) (((int64_t) num1) ^ ((int64_t) num2));
+    break;
+  case HK_OP_BITWISE_AND:
+    if (!ints)
+      return false;
+    data = (double) (((int64_t) num1) & ((int64_t) num2));
+    break;
+  case HK_OP_LEFT_SHIFT:
+    if (!ints || num1 < 0 || num2 < 0 || num2 >= 63
+      || (int64_t) num1 > (INT64_MAX >> (int64_t) num2))
+      return false;
+    data = (double) (((int64_t) num1) << ((int64_t) num2));
+    break;
+  case HK_OP_RIGHT_SHIFT:
+    if (!ints || num1 < 0 || num2 < 0 || num2 >= 63)
+      return false;
+    data = (double) (((int64_t) num1) >> ((int64_t) num2));
+    break;
+  default:
+    return false;
+  }
+  if (data == 0 && signbit(data))
+    return false;
+  *result = hk_number_value(data);
+  return true;
+}
+
+static inline bool fits_int(double data)
+{
+  return data >= -9007199254740992.0 && data <= 9007199254740992.0;
+}
+
+static inline void emit_constant(compiler_t *comp, hk_value_t val)
+{
+  hk_chunk_t *chunk = &comp->fn->chunk;
+  if (hk_is_nil(val))
+  {
+    hk_chunk_emit_opcode(chunk, HK_OP_NIL);
+    return;
+  }
+  if (hk_is_bool(val))
+  {
+    hk_chunk_emit_opcode(chunk, hk_as_bool(val) ? HK_OP_TRUE : HK_OP_FALSE);
+    return;
+  }
+  double data = hk_as_number(val);
+  if (data >= 0 && data <= UINT16_MAX && data == (uint16_t) data)
+  {
+    hk_chunk_emit_opcode(chunk, HK_OP_INT);
+    hk_chunk_emit_word(chunk, (uint16_t) data);
+    return;
+  }
+  emit_index(chunk, HK_OP_CONSTANT, add_number_constant(comp, data));
+}
+
+static inline void emit_unary(compiler_t *comp, int32_t start, hk_opcode_t op)
+{
+  hk_chunk_t *chunk = &comp->fn->chunk;
+  hk_value_t val;
+  hk_value_t result;
+  if (read_constant(comp, start, chunk->code_length, &val) && fold_unary(op, val, &result))
+  {
+    chunk->code_length = start;
+    emit_constant(comp, result);
+    return;
+  }
+  hk_chunk_emit_opcode(chunk, op);
+}
+
+static inline void emit_binary(compiler_t *comp, int32_t start, int32_t offset, hk_opcode_t op)
+{
+  hk_chunk_t *chunk = &comp->fn->chunk;
+  hk_value_t val1;
+  hk_value_t val2;
+  hk_value_t result;
+  if (read_constant(comp, start, offset, &val1)
+    && read_constant(comp, offset, chunk->code_length, &val2)
+    && fold_binary(op, val1, val2, &result))
+  {
+    chunk->code_length = start;
+    emit_constant(comp, result);
+    return;
+  }
+  hk_chunk_emit_opcode(chunk, op);
+}
+
+static inline bool take_condition(compiler_t *comp, int32_t start, bool not, bool *taken)
+{
+  hk_chunk_t *chunk = &comp->fn->chunk;
+  hk_value_t val;
+  if (!read_constant(comp, start, chunk->code_length, &val))
+    return false;
+  chunk->code_length = start;
+  *taken = hk_is_falsey(val) ? not : !not;
+  return true;
+}
+
+static inline void compile_dead_statement(compiler_t *comp)
+{
+  hk_function_t *fn = comp->fn;
+  hk_chunk_t *chunk = &fn->chunk;
+  hk_array_t *consts = chunk->consts;
+  loop_t *loop = comp->loop;
+  int32_t code_length = chunk->code_length;
+  int32_t lines_length = chunk->lines_length;
+  int32_t inlines_length = chunk->inlines_length;
+  int32_t consts_length = consts->length;
+  int32_t caches_length = chunk->caches_length;
+  int32_t functions_length = fn->functions_length;
+  int32_t num_variables = comp->num_variables;
+  uint16_t next_index = comp->next_index;
+  int32_t num_offsets = loop ? loop->num_offsets : 0;
+  int32_t statement_start = comp->statement_start;
+  uint16_t statement_depth = comp->statement_depth;
+  compile_statement(comp);
+  chunk->code_length = code_length;
+  chunk->lines_length = lines_length;
+  while (chunk->inlines_length > inlines_length)
+    hk_string_release(chunk->inlines[--chunk->inlines_length].name);
+  chunk->caches_length = caches_length;
+  while (consts->length > consts_length)
+    hk_value_release(consts->elements[--consts->length]);
+  while (fn->functions_length > functions_length)
+    hk_function_release(fn->functions[--fn->functions_length]);
+  comp->num_variables = num_variables;
+  comp->next_index = next_index;
+  comp->statement_start = statement_start;
+  comp->statement_depth = statement_depth;
+  if (loop)
+    loop->num_offsets = num_offsets;
+  comp->last_load = -1;
+  comp->last_nonlocal = -1;
+  comp->last_less = -1;
+  comp->last_call = -1;
+  comp->last_range = -1;
+  add_label(comp);
+}
+
 static inline void start_loop(compiler_t *comp, loop_t *loop)
 {
   loop->parent = comp->loop;
   loop->scope_depth = comp->scope_depth;
   loop->jump = (uint16_t) comp->fn->chunk.code_length;
+  add_label(comp);
+  loop->offsets_capacity = 0;
   loop->num_offsets = 0;
+  loop->offsets = NULL;
   comp->loop = loop;
 }
 
@@ -374,6 +1099,7 @@ static inline void end_loop(compiler_t *comp)
   loop_t *loop = comp->loop;
   for (int32_t i = 0; i < loop->num_offsets; ++i)
     patch_jump(comp, loop->offsets[i]);
+  hk_free(loop->offsets);
   comp->loop = comp->loop->parent;
 }
 
@@ -382,17 +1108,42 @@ static inline void compiler_init(compiler_t *comp, compiler_t *parent, scanner_t
 {
   comp->parent = parent;
   comp->scan = scan;
+  comp->flags = parent ? parent->flags : HK_COMPILER_FLAG_NONE;
   comp->scope_depth = 0;
+  comp->variables_capacity = MIN_CAPACITY;
   comp->num_variables = 0;
   comp->next_index = 1;
+  comp->variables = (variable_t *) hk_allocate(sizeof(*comp->variables) * comp->variables_capacity);
   comp->loop = NULL;
   comp->fn = hk_function_new(0, name, scan->file);
+  comp->last_label = 0;
+  comp->last_load = -1;
+  comp->last_nonlocal = -1;
+  comp->last_less = -1;
+  comp->last_call = -1;
+  comp->last_range = -1;
+  comp->statement_start = -1;
+  comp->statement_depth = 0;
+  comp->pending_fetches = 0;
+  comp->callee = NULL;
+  comp->callee_offset = -1;
+  comp->assign_index = -1;
+  comp->assign_offset = -1;
+  comp->assign_loads = 0;
+}
+
+static inline void compiler_free(compiler_t *comp)
+{
+  hk_free(comp->variables);
 }
 
 static void compile_statement(compiler_t *comp)
 {
   scanner_t *scan = comp->scan;
   hk_chunk_add_line(&comp->fn->chunk, scan->token.line);
+  add_label(comp);
+  comp->statement_start = comp->fn->chunk.code_length;
+  comp->statement_depth = comp->next_index;
   if (match(scan, TOKEN_IMPORT))
   {
     compile_import_statement(comp);
@@ -510,9 +1261,8 @@ static void compile_import_statement(compiler_t *comp)
   {
     token_t tk = scan->token;
     scanner_next_token(scan);
-    uint8_t index = add_string_constant(comp, &tk);
-    hk_chunk_emit_opcode(chunk, HK_OP_CONSTANT);
-    hk_chunk_emit_byte(chunk, index);
+    uint16_t index = add_string_constant(comp, &tk);
+    emit_index(chunk, HK_OP_CONSTANT, index);
     if (match(scan, TOKEN_AS))
     {
       scanner_next_token(scan);
@@ -534,9 +1284,8 @@ static void compile_import_statement(compiler_t *comp)
     token_t tk = scan->token;
     scanner_next_token(scan);
     define_local(comp, &tk, false);
-    uint8_t index = add_string_constant(comp, &tk);
-    hk_chunk_emit_opcode(chunk, HK_OP_CONSTANT);
-    hk_chunk_emit_byte(chunk, index);
+    uint16_t index = add_string_constant(comp, &tk);
+    emit_index(chunk, HK_OP_CONSTANT, index);
     uint8_t n = 1;
     while (match(scan, TOKEN_COMMA))
     {
@@ -546,9 +1295,8 @@ static void compile_import_statement(compiler_t *comp)
       token_t tk = scan->token;
       scanner_next_token(scan);
       define_local(comp, &tk, false);
-      uint8_t index = add_string_constant(comp, &tk);
-      hk_chunk_emit_opcode(chunk, HK_OP_CONSTANT);
-      hk_chunk_emit_byte(chunk, index);
+      uint16_t index = add_string_constant(comp, &tk);
+      emit_index(chunk, HK_OP_CONSTANT, index);
       ++n;
     }
     consume(comp, TOKEN_RBRACE);
@@ -559,8 +1307,7 @@ static void compile_import_statement(compiler_t *comp)
     scanner_next_token(scan);
     consume(comp, TOKEN_SEMICOLON);
     index = add_string_constant(comp, &tk);
-    hk_chunk_emit_opcode(chunk, HK_OP_CONSTANT);
-    hk_chunk_emit_byte(chunk, index);
+    emit_index(chunk, HK_OP_CONSTANT, index);
     hk_chunk_emit_opcode(chunk, HK_OP_LOAD_MODULE);
     hk_chunk_emit_opcode(chunk, HK_OP_UNPACK_STRUCT);
     hk_chunk_emit_byte(chunk, n);
@@ -579,8 +1326,11 @@ static void compile_constant_declaration(compiler_t *comp)
     token_t tk = scan->token;
     scanner_next_token(scan);
     consume(comp, TOKEN_EQ);
+    int32_t start = chunk->code_length;
     compile_expression(comp);
     define_local(comp, &tk, false);
+    variable_t *var = &comp->variables[comp->num_variables - 1];
+    var->is_constant = read_constant(comp, start, chunk->code_length, &var->value);
     return;
   }
   if (match(scan, TOKEN_LBRACKET))
@@ -627,9 +1377,8 @@ static void compile_constant_declaration(compiler_t *comp)
     scanner_next_token(scan);
     // FIX: This is a bug, we should not define the local here
     define_local(comp, &tk, false);
-    uint8_t index = add_string_constant(comp, &tk);
-    hk_chunk_emit_opcode(chunk, HK_OP_CONSTANT);
-    hk_chunk_emit_byte(chunk, index);
+    uint16_t index = add_string_constant(comp, &tk);
+    emit_index(chunk, HK_OP_CONSTANT, index);
     uint8_t n = 1;
     while (match(scan, TOKEN_COMMA))
     {
@@ -640,9 +1389,8 @@ static void compile_constant_declaration(compiler_t *comp)
       scanner_next_token(scan);
       // FIX: This is a bug, we should not define the local here
       define_local(comp, &tk, false);
-      uint8_t index = add_string_constant(comp, &tk);
-      hk_chunk_emit_opcode(chunk, HK_OP_CONSTANT);
-      hk_chunk_emit_byte(chunk, index);
+      uint16_t index = add_string_constant(comp, &tk);
+      emit_index(chunk, HK_OP_CONSTANT, index);
       ++n;
     }
     consume(comp, TOKEN_RBRACE);
@@ -720,9 +1468,8 @@ static void compile_variable_declaration(compiler_t *comp)
     scanner_next_token(scan);
     // FIX: This is a bug, we should not define the local here
     define_local(comp, &tk, true);
-    uint8_t index = add_string_constant(comp, &tk);
-    hk_chunk_emit_opcode(chunk, HK_OP_CONSTANT);
-    hk_chunk_emit_byte(chunk, index);
+    uint16_t index = add_string_constant(comp, &tk);
+    emit_index(chunk, HK_OP_CONSTANT, index);
     uint8_t n = 1;
     while (match(scan, TOKEN_COMMA))
     {
@@ -733,9 +1480,8 @@ static void compile_variable_declaration(compiler_t *comp)
       scanner_next_token(scan);
       // FIX: This is a bug, we should not define the local here
       define_local(comp, &tk, true);
-      uint8_t index = add_string_constant(comp, &tk);
-      hk_chunk_emit_opcode(chunk, HK_OP_CONSTANT);
-      hk_chunk_emit_byte(chunk, index);
+      uint16_t index = add_string_constant(comp, &tk);
+      emit_index(chunk, HK_OP_CONSTANT, index);
       ++n;
     }
     consume(comp, TOKEN_RBRACE);
@@ -758,21 +1504,43 @@ static void compile_assign_statement(compiler_t *comp, token_t *tk)
   {
     var = compile_variable(comp, tk, false);
     scanner_next_token(scan);
+    start_assign(comp, &var);
     compile_expression(comp);
+    end_assign(comp);
     goto end;
   }
+  int32_t offset = chunk->code_length;
+  bool direct = !match(scan, TOKEN_LBRACKET) && !match(scan, TOKEN_DOT)
+    && !match(scan, TOKEN_LPAREN);
+  variable_t *local = lookup_variable(comp, tk);
+  if (direct && local)
+    start_assign(comp, local);
   var = compile_variable(comp, tk, true);
+  comp->callee = var.fn;
+  comp->callee_offset = offset;
   if (compile_assign(comp, PRODUCTION_NONE, true) == PRODUCTION_CALL)
   {
     hk_chunk_emit_opcode(chunk, HK_OP_POP);
     return;
   }
+  if (var.is_mutable && var.is_local && chunk->code_length - offset == 3
+    && chunk->code[offset] == HK_OP_LOAD)
+  {
+    hk_opcode_t op = (hk_opcode_t) chunk->code[offset + 2];
+    if (op == HK_OP_INCREMENT || op == HK_OP_DECREMENT)
+    {
+      chunk->code_length = offset;
+      hk_chunk_emit_opcode(chunk, op == HK_OP_INCREMENT ? HK_OP_INCREMENT_LOCAL : HK_OP_DECREMENT_LOCAL);
+      hk_chunk_emit_byte(chunk, (uint8_t) var.index);
+      return;
+    }
+  }
+  end_assign(comp);
 end:
   if (!var.is_mutable)
     syntax_error(fn->name, scan->file->chars, tk->line, tk->col,
       "cannot assign to immutable variable `%.*s`", tk->length, tk->start);
-  hk_chunk_emit_opcode(chunk, HK_OP_STORE);
-  hk_chunk_emit_byte(chunk, var.index);
+  emit_index(chunk, HK_OP_STORE, var.index);
 }
 
 static int32_t compile_assign(compiler_t *comp, production_t prod, bool inplace)
@@ -890,7 +1658,9 @@ static int32_t compile_assign(compiler_t *comp, production_t prod, bool inplace)
     }
     int32_t offset = chunk->code_length;
     hk_chunk_emit_opcode(chunk, HK_OP_GET_ELEMENT);
+    ++comp->pending_fetches;
     production_t _prod = compile_assign(comp, PRODUCTION_SUBSCRIPT, false);
+    --comp->pending_fetches;
     if (_prod == PRODUCTION_ASSIGN)
     {
       patch_opcode(chunk, offset, HK_OP_FETCH_ELEMENT);
@@ -905,19 +1675,20 @@ static int32_t compile_assign(compiler_t *comp, production_t prod, bool inplace)
       syntax_error_unexpected(comp);
     token_t tk = scan->token;
     scanner_next_token(scan);
-    uint8_t index = add_string_constant(comp, &tk);
+    uint16_t index = add_string_constant(comp, &tk);
     if (match(scan, TOKEN_EQ))
     {
       scanner_next_token(scan);
       compile_expression(comp);
-      hk_chunk_emit_opcode(chunk, inplace ? HK_OP_INPLACE_PUT_FIELD : HK_OP_PUT_FIELD);
-      hk_chunk_emit_byte(chunk, index);
+      emit_index(chunk, inplace ? HK_OP_INPLACE_PUT_FIELD : HK_OP_PUT_FIELD, index);
+      emit_cache(comp);
       return PRODUCTION_ASSIGN;
     }
-    int32_t offset = chunk->code_length;
-    hk_chunk_emit_opcode(chunk, HK_OP_GET_FIELD);
-    hk_chunk_emit_byte(chunk, index);
+    int32_t offset = emit_index(chunk, HK_OP_GET_FIELD, index);
+    emit_cache(comp);
+    ++comp->pending_fetches;
     production_t _prod = compile_assign(comp, PRODUCTION_SUBSCRIPT, false);
+    --comp->pending_fetches;
     if (_prod == PRODUCTION_ASSIGN)
     {
       patch_opcode(chunk, offset, HK_OP_FETCH_FIELD);
@@ -928,11 +1699,14 @@ static int32_t compile_assign(compiler_t *comp, production_t prod, bool inplace)
   if (match(scan, TOKEN_LPAREN))
   {
     scanner_next_token(scan);
+    hk_function_t *callee = prod == PRODUCTION_NONE ? comp->callee : NULL;
+    int32_t start = comp->callee_offset;
+    int32_t offset = chunk->code_length;
     if (match(scan, TOKEN_RPAREN))
     {
       scanner_next_token(scan);
-      hk_chunk_emit_opcode(chunk, HK_OP_CALL);
-      hk_chunk_emit_byte(chunk, 0);
+      if (!callee || !inline_call(comp, callee, start, offset, 0))
+        emit_call(comp, 0);
       return compile_assign(comp, PRODUCTION_CALL, false);
     }
     compile_expression(comp);
@@ -944,8 +1718,8 @@ static int32_t compile_assign(compiler_t *comp, production_t prod, bool inplace)
       ++num_args;
     }
     consume(comp, TOKEN_RPAREN);
-    hk_chunk_emit_opcode(chunk, HK_OP_CALL);
-    hk_chunk_emit_byte(chunk, num_args);
+    if (!callee || !inline_call(comp, callee, start, offset, num_args))
+      emit_call(comp, num_args);
     return compile_assign(comp, PRODUCTION_CALL, false);
   }
   if (prod == PRODUCTION_NONE || prod == PRODUCTION_SUBSCRIPT)
@@ -959,7 +1733,7 @@ static void compile_struct_declaration(compiler_t *comp, bool is_anonymous)
   hk_chunk_t *chunk = &comp->fn->chunk;
   scanner_next_token(scan);
   token_t tk;
-  uint8_t index;
+  uint16_t index;
   if (is_anonymous)
     hk_chunk_emit_opcode(chunk, HK_OP_NIL);
   else
@@ -970,8 +1744,7 @@ static void compile_struct_declaration(compiler_t *comp, bool is_anonymous)
     scanner_next_token(scan);
     define_local(comp, &tk, false);
     index = add_string_constant(comp, &tk);
-    hk_chunk_emit_opcode(chunk, HK_OP_CONSTANT);
-    hk_chunk_emit_byte(chunk, index);
+    emit_index(chunk, HK_OP_CONSTANT, index);
   }
   consume(comp, TOKEN_LBRACE);
   if (match(scan, TOKEN_RBRACE))
@@ -986,8 +1759,7 @@ static void compile_struct_declaration(compiler_t *comp, bool is_anonymous)
   tk = scan->token;
   scanner_next_token(scan);
   index = add_string_constant(comp, &tk);
-  hk_chunk_emit_opcode(chunk, HK_OP_CONSTANT);
-  hk_chunk_emit_byte(chunk, index);
+  emit_index(chunk, HK_OP_CONSTANT, index);
   uint8_t length = 1;
   while (match(scan, TOKEN_COMMA))
   {
@@ -997,8 +1769,7 @@ static void compile_struct_declaration(compiler_t *comp, bool is_anonymous)
     tk = scan->token;
     scanner_next_token(scan);
     index = add_string_constant(comp, &tk);
-    hk_chunk_emit_opcode(chunk, HK_OP_CONSTANT);
-    hk_chunk_emit_byte(chunk, index);
+    emit_index(chunk, HK_OP_CONSTANT, index);
     ++length;
   }
   consume(comp, TOKEN_RBRACE);
@@ -1018,6 +1789,7 @@ static void compile_function_declaration(compiler_t *comp)
   token_t tk = scan->token;
   scanner_next_token(scan);
   define_local(comp, &tk, false);
+  int32_t index = comp->num_variables - 1;
   hk_string_t *name = hk_string_from_chars(tk.length, tk.start);
   compiler_init(&child_comp, comp, scan, name);
   add_variable(&child_comp, true, 0, &tk, false);
@@ -1078,12 +1850,9 @@ static void compile_function_declaration(compiler_t *comp)
     syntax_error_unexpected(comp);
   compile_block(&child_comp);
   hk_chunk_emit_opcode(child_chunk, HK_OP_RETURN_NIL);
-  uint8_t index;
 end:
-  index = fn->functions_length;
-  hk_function_add_child(fn, child_comp.fn);
-  hk_chunk_emit_opcode(chunk, HK_OP_CLOSURE);
-  hk_chunk_emit_byte(chunk, index);
+  comp->variables[index].fn = child_comp.fn;
+  emit_index(chunk, HK_OP_CLOSURE, add_function(comp, &child_comp));
 }
 
 static void compile_anonymous_function(compiler_t *comp)
@@ -1150,12 +1919,8 @@ static void compile_anonymous_function(compiler_t *comp)
     syntax_error_unexpected(comp);
   compile_block(&child_comp);
   hk_chunk_emit_opcode(child_chunk, HK_OP_RETURN_NIL);
-  uint8_t index;
 end:
-  index = fn->functions_length;
-  hk_function_add_child(fn, child_comp.fn);
-  hk_chunk_emit_opcode(chunk, HK_OP_CLOSURE);
-  hk_chunk_emit_byte(chunk, index);
+  emit_index(chunk, HK_OP_CLOSURE, add_function(comp, &child_comp));
 }
 
 static void compile_anonymous_function_without_params(compiler_t *comp)
@@ -1178,12 +1943,8 @@ static void compile_anonymous_function_without_params(compiler_t *comp)
     syntax_error_unexpected(comp);
   compile_block(&child_comp);
   hk_chunk_emit_opcode(child_chunk, HK_OP_RETURN_NIL);
-  uint8_t index;
 end:
-  index = fn->functions_length;
-  hk_function_add_child(fn, child_comp.fn);
-  hk_chunk_emit_opcode(chunk, HK_OP_CLOSURE);
-  hk_chunk_emit_byte(chunk, index);
+  emit_index(chunk, HK_OP_CLOSURE, add_function(comp, &child_comp));
 }
 
 static void compile_del_statement(compiler_t *comp)
@@ -1200,11 +1961,9 @@ static void compile_del_statement(compiler_t *comp)
   if (!var.is_mutable)
     syntax_error(fn->name, scan->file->chars, tk.line, tk.col,
       "cannot delete element from immutable variable `%.*s`", tk.length, tk.start);
-  hk_chunk_emit_opcode(chunk, HK_OP_LOAD);
-  hk_chunk_emit_byte(chunk, var.index);
+  emit_index(chunk, HK_OP_LOAD, var.index);
   compile_delete(comp, true);
-  hk_chunk_emit_opcode(chunk, HK_OP_STORE);
-  hk_chunk_emit_byte(chunk, var.index);
+  emit_index(chunk, HK_OP_STORE, var.index);
 }
 
 static void compile_delete(compiler_t *comp, bool inplace)
@@ -1234,9 +1993,9 @@ static void compile_delete(compiler_t *comp, bool inplace)
       syntax_error_unexpected(comp);
     token_t tk = scan->token;
     scanner_next_token(scan);
-    uint8_t index = add_string_constant(comp, &tk);
-    hk_chunk_emit_opcode(chunk, HK_OP_FETCH_FIELD);
-    hk_chunk_emit_byte(chunk, index);
+    uint16_t index = add_string_constant(comp, &tk);
+    emit_index(chunk, HK_OP_FETCH_FIELD, index);
+    emit_cache(comp);
     compile_delete(comp, false);
     hk_chunk_emit_opcode(chunk, HK_OP_SET_FIELD);
     return;
@@ -1250,10 +2009,26 @@ static void compile_if_statement(compiler_t *comp, bool not)
   hk_chunk_t *chunk = &comp->fn->chunk;
   scanner_next_token(scan);
   consume(comp, TOKEN_LPAREN);
+  int32_t start = chunk->code_length;
   compile_expression(comp);
   consume(comp, TOKEN_RPAREN);
-  hk_opcode_t op = not ? HK_OP_JUMP_IF_TRUE : HK_OP_JUMP_IF_FALSE;
-  int32_t offset1 = emit_jump(chunk, op);
+  bool taken;
+  if (take_condition(comp, start, not, &taken))
+  {
+    if (taken)
+      compile_statement(comp);
+    else
+      compile_dead_statement(comp);
+    if (!match(scan, TOKEN_ELSE))
+      return;
+    scanner_next_token(scan);
+    if (taken)
+      compile_dead_statement(comp);
+    else
+      compile_statement(comp);
+    return;
+  }
+  int32_t offset1 = not ? emit_jump(chunk, HK_OP_JUMP_IF_TRUE) : emit_jump_if_false(comp);
   compile_statement(comp);
   int32_t offset2 = emit_jump(chunk, HK_OP_JUMP);
   patch_jump(comp, offset1);
@@ -1338,8 +2113,22 @@ static void compile_while_statement(compiler_t *comp, bool not)
   start_loop(comp, &loop);
   compile_expression(comp);
   consume(comp, TOKEN_RPAREN);
-  hk_opcode_t op = not ? HK_OP_JUMP_IF_TRUE : HK_OP_JUMP_IF_FALSE;
-  int32_t offset = emit_jump(chunk, op);
+  bool taken;
+  if (take_condition(comp, loop.jump, not, &taken))
+  {
+    if (!taken)
+    {
+      compile_dead_statement(comp);
+      end_loop(comp);
+      return;
+    }
+    compile_statement(comp);
+    hk_chunk_emit_opcode(chunk, HK_OP_JUMP);
+    hk_chunk_emit_word(chunk, loop.jump);
+    end_loop(comp);
+    return;
+  }
+  int32_t offset = not ? emit_jump(chunk, HK_OP_JUMP_IF_TRUE) : emit_jump_if_false(comp);
   compile_statement(comp);
   hk_chunk_emit_opcode(chunk, HK_OP_JUMP);
   hk_chunk_emit_word(chunk, loop.jump);
@@ -1406,6 +2195,7 @@ static void compile_for_statement(compiler_t *comp)
       syntax_error_unexpected(comp);
   }
   uint16_t jump1 = (uint16_t) chunk->code_length;
+  add_label(comp);
   bool missing = match(scan, TOKEN_SEMICOLON);
   int32_t offset1;
   if (missing)
@@ -1414,10 +2204,11 @@ static void compile_for_statement(compiler_t *comp)
   {
     compile_expression(comp);
     consume(comp, TOKEN_SEMICOLON);
-    offset1 = emit_jump(chunk, HK_OP_JUMP_IF_FALSE);
+    offset1 = emit_jump_if_false(comp);
   }
   int32_t offset2 = emit_jump(chunk, HK_OP_JUMP);
   uint16_t jump2 = (uint16_t) chunk->code_length;
+  add_label(comp);
   loop_t loop;
   start_loop(comp, &loop);
   if (match(scan, TOKEN_RPAREN))
@@ -1459,6 +2250,13 @@ static void compile_foreach_statement(compiler_t *comp)
   consume(comp, TOKEN_IN);
   compile_expression(comp);
   consume(comp, TOKEN_RPAREN);
+  int32_t offset = chunk->code_length;
+  if (comp->last_range == offset - 1 && comp->last_label != offset)
+  {
+    compile_range_loop(comp);
+    return;
+  }
+  add_hidden_local(comp);
   hk_chunk_emit_opcode(chunk, HK_OP_ITERATOR);
   int32_t offset1 = emit_jump(chunk, HK_OP_JUMP);
   loop_t loop;
@@ -1471,7 +2269,25 @@ static void compile_foreach_statement(compiler_t *comp)
   hk_chunk_emit_opcode(chunk, HK_OP_JUMP);
   hk_chunk_emit_word(chunk, loop.jump);
   patch_jump(comp, offset2);
-  hk_chunk_emit_opcode(chunk, HK_OP_POP);
+  end_loop(comp);
+  pop_scope(comp);
+}
+
+static void compile_range_loop(compiler_t *comp)
+{
+  hk_chunk_t *chunk = &comp->fn->chunk;
+  patch_opcode(chunk, comp->last_range, HK_OP_RANGE_LOOP);
+  add_hidden_local(comp);
+  add_hidden_local(comp);
+  int32_t offset1 = emit_jump(chunk, HK_OP_JUMP);
+  loop_t loop;
+  start_loop(comp, &loop);
+  int32_t offset2 = emit_jump(chunk, HK_OP_RANGE_STEP);
+  patch_jump(comp, offset1);
+  compile_statement(comp);
+  hk_chunk_emit_opcode(chunk, HK_OP_JUMP);
+  hk_chunk_emit_word(chunk, loop.jump);
+  patch_jump(comp, offset2);
   end_loop(comp);
   pop_scope(comp);
 }
@@ -1508,6 +2324,12 @@ static void compile_break_statement(compiler_t *comp)
   if (loop->num_offsets == MAX_BREAKS)
     syntax_error(name, file, tk.line, tk.col,
       "cannot use more than %d breaks", MAX_BREAKS);
+  if (loop->num_offsets == loop->offsets_capacity)
+  {
+    int32_t capacity = loop->offsets_capacity ? loop->offsets_capacity << 1 : MIN_CAPACITY;
+    loop->offsets_capacity = capacity;
+    loop->offsets = (int32_t *) hk_reallocate(loop->offsets, sizeof(*loop->offsets) * capacity);
+  }
   int32_t offset = emit_jump(&comp->fn->chunk, HK_OP_JUMP);
   loop->offsets[loop->num_offsets++] = offset;
 }
@@ -1525,6 +2347,8 @@ static void compile_return_statement(compiler_t *comp)
   }
   compile_expression(comp);
   consume(comp, TOKEN_SEMICOLON);
+  if (comp->last_call == chunk->code_length - 2)
+    patch_opcode(chunk, comp->last_call, HK_OP_TAIL_CALL);
   hk_chunk_emit_opcode(chunk, HK_OP_RETURN);
 }
 
@@ -1569,21 +2393,23 @@ static void compile_equal_expression(compiler_t *comp)
 {
   scanner_t *scan = comp->scan;
   hk_chunk_t *chunk = &comp->fn->chunk;
+  int32_t start = chunk->code_length;
   compile_comp_expression(comp);
   for (;;)
   {
+    int32_t offset = chunk->code_length;
     if (match(scan, TOKEN_EQEQ))
     {
       scanner_next_token(scan);
       compile_comp_expression(comp);
-      hk_chunk_emit_opcode(chunk, HK_OP_EQUAL);
+      emit_binary(comp, start, offset, HK_OP_EQUAL);
       continue;
     }
     if (match(scan, TOKEN_BANGEQ))
     {
       scanner_next_token(scan);
       compile_comp_expression(comp);
-      hk_chunk_emit_opcode(chunk, HK_OP_NOT_EQUAL);
+      emit_binary(comp, start, offset, HK_OP_NOT_EQUAL);
       continue;
     }
     break;
@@ -1594,35 +2420,38 @@ static void compile_comp_expression(compiler_t *comp)
 {
   scanner_t *scan = comp->scan;
   hk_chunk_t *chunk = &comp->fn->chunk;
+  int32_t start = chunk->code_length;
   compile_bitwise_or_expression(comp);
   for (;;)
   {
+    int32_t offset = chunk->code_length;
     if (match(scan, TOKEN_GT))
     {
       scanner_next_token(scan);
       compile_bitwise_or_expression(comp);
-      hk_chunk_emit_opcode(chunk, HK_OP_GREATER);
+      emit_binary(comp, start, offset, HK_OP_GREATER);
       continue;
     }
     if (match(scan, TOKEN_GTEQ))
     {
       scanner_next_token(scan);
       compile_bitwise_or_expression(comp);
-      hk_chunk_emit_opcode(chunk, HK_OP_NOT_LESS);
+      emit_binary(comp, start, offset, HK_OP_NOT_LESS);
       continue;
     }
     if (match(scan, TOKEN_LT))
     {
       scanner_next_token(scan);
       compile_bitwise_or_expression(comp);
-      hk_chunk_emit_opcode(chunk, HK_OP_LESS);
+      comp->last_less = chunk->code_length;
+      emit_binary(comp, start, offset, HK_OP_LESS);
       continue;
     }
     if (match(scan, TOKEN_LTEQ))
     {
       scanner_next_token(scan);
       compile_bitwise_or_expression(comp);
-      hk_chunk_emit_opcode(chunk, HK_OP_NOT_GREATER);
+      emit_binary(comp, start, offset, HK_OP_NOT_GREATER);
       continue;
     }
     break;
@@ -1633,12 +2462,14 @@ static void compile_bitwise_or_expression(compiler_t *comp)
 {
   scanner_t *scan = comp->scan;
   hk_chunk_t *chunk = &comp->fn->chunk;
+  int32_t start = chunk->code_length;
   compile_bitwise_xor_expression(comp);
   while (match(scan, TOKEN_PIPE))
   {
     scanner_next_token(scan);
+    int32_t offset = chunk->code_length;
     compile_bitwise_xor_expression(comp);
-    hk_chunk_emit_opcode(chunk, HK_OP_BITWISE_OR);
+    emit_binary(comp, start, offset, HK_OP_BITWISE_OR);
   }
 }
 
@@ -1646,12 +2477,14 @@ static void compile_bitwise_xor_expression(compiler_t *comp)
 {
   scanner_t *scan = comp->scan;
   hk_chunk_t *chunk = &comp->fn->chunk;
+  int32_t start = chunk->code_length;
   compile_bitwise_and_expression(comp);
   while (match(scan, TOKEN_CARET))
   {
     scanner_next_token(scan);
+    int32_t offset = chunk->code_length;
     compile_bitwise_and_expression(comp);
-    hk_chunk_emit_opcode(chunk, HK_OP_BITWISE_XOR);
+    emit_binary(comp, start, offset, HK_OP_BITWISE_XOR);
   }
 }
 
@@ -1659,12 +2492,14 @@ static void compile_bitwise_and_expression(compiler_t *comp)
 {
   scanner_t *scan = comp->scan;
   hk_chunk_t *chunk = &comp->fn->chunk;
+  int32_t start = chunk->code_length;
   compile_left_shift_expression(comp);
   while (match(scan, TOKEN_AMP))
   {
     scanner_next_token(scan);
+    int32_t offset = chunk->code_length;
     compile_left_shift_expression(comp);
-    hk_chunk_emit_opcode(chunk, HK_OP_BITWISE_AND);
+    emit_binary(comp, start, offset, HK_OP_BITWISE_AND);
   }
 }
 
@@ -1672,12 +2507,14 @@ static void compile_left_shift_expression(compiler_t *comp)
 {
   scanner_t *scan = comp->scan;
   hk_chunk_t *chunk = &comp->fn->chunk;
+  int32_t start = chunk->code_length;
   compile_right_shift_expression(comp);
   while (match(scan, TOKEN_LTLT))
   {
     scanner_next_token(scan);
+    int32_t offset = chunk->code_length;
     compile_right_shift_expression(comp);
-    hk_chunk_emit_opcode(chunk, HK_OP_LEFT_SHIFT);
+    emit_binary(comp, start, offset, HK_OP_LEFT_SHIFT);
   }
 }
 
@@ -1685,12 +2522,14 @@ static void compile_right_shift_expression(compiler_t *comp)
 {
   scanner_t *scan = comp->scan;
   hk_chunk_t *chunk = &comp->fn->chunk;
+  int32_t start = chunk->code_length;
   compile_range_expression(comp);
   while (match(scan, TOKEN_GTGT))
   {
     scanner_next_token(scan);
+    int32_t offset = chunk->code_length;
     compile_range_expression(comp);
-    hk_chunk_emit_opcode(chunk, HK_OP_RIGHT_SHIFT);
+    emit_binary(comp, start, offset, HK_OP_RIGHT_SHIFT);
   }
 }
 
@@ -1703,6 +2542,7 @@ static void compile_range_expression(compiler_t *comp)
   {
     scanner_next_token(scan);
     compile_add_expression(comp);
+    comp->last_range = chunk->code_length;
     hk_chunk_emit_opcode(chunk, HK_OP_RANGE);
   }
 }
@@ -1711,21 +2551,23 @@ static void compile_add_expression(compiler_t *comp)
 {
   scanner_t *scan = comp->scan;
   hk_chunk_t *chunk = &comp->fn->chunk;
+  int32_t start = chunk->code_length;
   compile_mul_expression(comp);
   for (;;)
   {
+    int32_t offset = chunk->code_length;
     if (match(scan, TOKEN_PLUS))
     {
       scanner_next_token(scan);
       compile_mul_expression(comp);
-      hk_chunk_emit_opcode(chunk, HK_OP_ADD);
+      emit_binary(comp, start, offset, HK_OP_ADD);
       continue;
     }
     if (match(scan, TOKEN_DASH))
     {
       scanner_next_token(scan);
       compile_mul_expression(comp);
-      hk_chunk_emit_opcode(chunk, HK_OP_SUBTRACT);
+      emit_binary(comp, start, offset, HK_OP_SUBTRACT);
       continue;
     }
     break;
@@ -1734,37 +2576,39 @@ static void compile_add_expression(compiler_t *comp)
 
 static void compile_mul_expression(compiler_t *comp)
 {
-  compile_unary_expression(comp);
   scanner_t *scan = comp->scan;
   hk_chunk_t *chunk = &comp->fn->chunk;
+  int32_t start = chunk->code_length;
+  compile_unary_expression(comp);
   for (;;)
   {
+    int32_t offset = chunk->code_length;
     if (match(scan, TOKEN_STAR))
     {
       scanner_next_token(scan);
       compile_unary_expression(comp);
-      hk_chunk_emit_opcode(chunk, HK_OP_MULTIPLY);
+      emit_binary(comp, start, offset, HK_OP_MULTIPLY);
       continue;
     }
     if (match(scan, TOKEN_SLASH))
     {
       scanner_next_token(scan);
       compile_unary_expression(comp);
-      hk_chunk_emit_opcode(chunk, HK_OP_DIVIDE);
+      emit_binary(comp, start, offset, HK_OP_DIVIDE);
       continue;
     }
     if (match(scan, TOKEN_TILDESLASH))
     {
       scanner_next_token(scan);
       compile_unary_expression(comp);
-      hk_chunk_emit_opcode(chunk, HK_OP_QUOTIENT);
+      emit_binary(comp, start, offset, HK_OP_QUOTIENT);
       continue;
     }
     if (match(scan, TOKEN_PERCENT))
     {
       scanner_next_token(scan);
       compile_unary_expression(comp);
-      hk_chunk_emit_opcode(chunk, HK_OP_REMAINDER);
+      emit_binary(comp, start, offset, HK_OP_REMAINDER);
       continue;
     }
     break;
@@ -1775,25 +2619,26 @@ static void compile_unary_expression(compiler_t *comp)
 {
   scanner_t *scan = comp->scan;
   hk_chunk_t *chunk = &comp->fn->chunk;
+  int32_t start = chunk->code_length;
   if (match(scan, TOKEN_DASH))
   {
     scanner_next_token(scan);
     compile_unary_expression(comp);
-    hk_chunk_emit_opcode(chunk, HK_OP_NEGATE);
+    emit_unary(comp, start, HK_OP_NEGATE);
     return;
   }
   if (match(scan, TOKEN_BANG))
   {
     scanner_next_token(scan);
     compile_unary_expression(comp);
-    hk_chunk_emit_opcode(chunk, HK_OP_NOT);
+    emit_unary(comp, start, HK_OP_NOT);
     return;
   }
   if (match(scan, TOKEN_TILDE))
   {
     scanner_next_token(scan);
     compile_unary_expression(comp);
-    hk_chunk_emit_opcode(chunk, HK_OP_BITWISE_NOT);
+    emit_unary(comp, start, HK_OP_BITWISE_NOT);
     return;
   }
   compile_prim_expression(comp);
@@ -1831,27 +2676,24 @@ static void compile_prim_expression(compiler_t *comp)
       hk_chunk_emit_word(chunk, (uint16_t) data);
       return;
     }
-    uint8_t index = add_number_constant(comp, data);
-    hk_chunk_emit_opcode(chunk, HK_OP_CONSTANT);
-    hk_chunk_emit_byte(chunk, index);
+    uint16_t index = add_number_constant(comp, data);
+    emit_index(chunk, HK_OP_CONSTANT, index);
     return;
   }
   if (match(scan, TOKEN_FLOAT))
   {
     double data = parse_double(comp);
     scanner_next_token(scan);
-    uint8_t index = add_number_constant(comp, data);
-    hk_chunk_emit_opcode(chunk, HK_OP_CONSTANT);
-    hk_chunk_emit_byte(chunk, index);
+    uint16_t index = add_number_constant(comp, data);
+    emit_index(chunk, HK_OP_CONSTANT, index);
     return;
   }
   if (match(scan, TOKEN_STRING))
   {
     token_t tk = scan->token;
     scanner_next_token(scan);
-    uint8_t index = add_string_constant(comp, &tk);
-    hk_chunk_emit_opcode(chunk, HK_OP_CONSTANT);
-    hk_chunk_emit_byte(chunk, index);
+    uint16_t index = add_string_constant(comp, &tk);
+    emit_index(chunk, HK_OP_CONSTANT, index);
     return;
   }
   if (match(scan, TOKEN_LBRACKET))
@@ -1952,9 +2794,8 @@ static void compile_struct_constructor(compiler_t *comp)
     syntax_error_unexpected(comp);
   token_t tk = scan->token;
   scanner_next_token(scan);
-  uint8_t index = add_string_constant(comp, &tk);
-  hk_chunk_emit_opcode(chunk, HK_OP_CONSTANT);
-  hk_chunk_emit_byte(chunk, index);
+  uint16_t index = add_string_constant(comp, &tk);
+  emit_index(chunk, HK_OP_CONSTANT, index);
   consume(comp, TOKEN_COLON);
   compile_expression(comp);
   uint8_t length = 1;
@@ -1966,8 +2807,7 @@ static void compile_struct_constructor(compiler_t *comp)
     tk = scan->token;
     scanner_next_token(scan);
     index = add_string_constant(comp, &tk);
-    hk_chunk_emit_opcode(chunk, HK_OP_CONSTANT);
-    hk_chunk_emit_byte(chunk, index);
+    emit_index(chunk, HK_OP_CONSTANT, index);
     consume(comp, TOKEN_COLON);
     compile_expression(comp);
     ++length;
@@ -1985,8 +2825,7 @@ static void compile_if_expression(compiler_t *comp, bool not)
   consume(comp, TOKEN_LPAREN);
   compile_expression(comp);
   consume(comp, TOKEN_RPAREN);
-  hk_opcode_t op = not ? HK_OP_JUMP_IF_TRUE : HK_OP_JUMP_IF_FALSE;
-  int32_t offset1 = emit_jump(chunk, op);
+  int32_t offset1 = not ? emit_jump(chunk, HK_OP_JUMP_IF_TRUE) : emit_jump_if_false(comp);
   compile_expression(comp);
   int32_t offset2 = emit_jump(chunk, HK_OP_JUMP);
   patch_jump(comp, offset1);
@@ -2064,16 +2903,17 @@ static void compile_subscript(compiler_t *comp)
 {
   scanner_t *scan = comp->scan;
   hk_chunk_t *chunk = &comp->fn->chunk;
-  compile_variable(comp, &scan->token, true);
+  int32_t start = chunk->code_length;
+  hk_function_t *callee = compile_variable(comp, &scan->token, true).fn;
   scanner_next_token(scan);
-  for (;;)
+  for (;; callee = NULL)
   {
     if (match(scan, TOKEN_LBRACKET))
     {
       scanner_next_token(scan);
       compile_expression(comp);
       consume(comp, TOKEN_RBRACKET);
-      hk_chunk_emit_opcode(chunk, HK_OP_GET_ELEMENT);
+      emit_get_element(comp);
       continue;
     }
     if (match(scan, TOKEN_DOT))
@@ -2083,19 +2923,19 @@ static void compile_subscript(compiler_t *comp)
         syntax_error_unexpected(comp);
       token_t tk = scan->token;
       scanner_next_token(scan);
-      uint8_t index = add_string_constant(comp, &tk);
-      hk_chunk_emit_opcode(chunk, HK_OP_GET_FIELD);
-      hk_chunk_emit_byte(chunk, index);
+      uint16_t index = add_string_constant(comp, &tk);
+      emit_get_field(comp, index);
       continue;
     }
     if (match(scan, TOKEN_LPAREN))
     {
       scanner_next_token(scan);
+      int32_t offset = chunk->code_length;
       if (match(scan, TOKEN_RPAREN))
       {
         scanner_next_token(scan);
-        hk_chunk_emit_opcode(chunk, HK_OP_CALL);
-        hk_chunk_emit_byte(chunk, 0);
+        if (!callee || !inline_call(comp, callee, start, offset, 0))
+          emit_call(comp, 0);
         return;
       }
       compile_expression(comp);
@@ -2107,8 +2947,8 @@ static void compile_subscript(compiler_t *comp)
         ++num_args;
       }
       consume(comp, TOKEN_RPAREN);
-      hk_chunk_emit_opcode(chunk, HK_OP_CALL);
-      hk_chunk_emit_byte(chunk, num_args);
+      if (!callee || !inline_call(comp, callee, start, offset, num_args))
+        emit_call(comp, num_args);
       continue;
     }
     break;
@@ -2146,16 +2986,25 @@ static variable_t compile_variable(compiler_t *comp, token_t *tk, bool emit)
   {
     if (!emit)
       return *var;
-    hk_chunk_emit_opcode(chunk, var->is_local ? HK_OP_LOAD : HK_OP_NONLOCAL);
-    hk_chunk_emit_byte(chunk, var->index);
+    if (var->is_constant)
+    {
+      emit_constant(comp, var->value);
+      return *var;
+    }
+    if (var->is_local)
+    {
+      emit_load(comp, var->index);
+      return *var;
+    }
+    emit_nonlocal(comp, (uint8_t) var->index);
     return *var;
   }
   var = compile_nonlocal(comp->parent, tk);
   if (var)
   {
     uint8_t index = add_nonlocal(comp, tk);
-    hk_chunk_emit_opcode(chunk, HK_OP_NONLOCAL);
-    hk_chunk_emit_byte(chunk, index);
+    comp->variables[comp->num_variables - 1].fn = var->fn;
+    emit_nonlocal(comp, index);
     return *var;
   }
   int32_t index = lookup_global(tk->length, tk->start);
@@ -2185,14 +3034,14 @@ static variable_t *compile_nonlocal(compiler_t *comp, token_t *tk)
           "cannot capture mutable variable `%.*s`", tk->length, tk->start);
       op = HK_OP_LOAD;
     }
-    hk_chunk_emit_opcode(chunk, op);
-    hk_chunk_emit_byte(chunk, var->index);
+    emit_index(chunk, op, var->index);
     return var;
   }
   var = compile_nonlocal(comp->parent, tk);
   if (var)
   {
     uint8_t index = add_nonlocal(comp, tk);
+    comp->variables[comp->num_variables - 1].fn = var->fn;
     hk_chunk_emit_opcode(chunk, HK_OP_NONLOCAL);
     hk_chunk_emit_byte(chunk, index);
     return var;
@@ -2200,12 +3049,801 @@ static variable_t *compile_nonlocal(compiler_t *comp, token_t *tk)
   return NULL;
 }
 
-hk_closure_t *hk_compile(hk_string_t *file, hk_string_t *source)
+static inline void mark_depth(int32_t *depths, int32_t *offsets, int32_t *length,
+  int32_t offset, int32_t depth)
+{
+  if (depths[offset] != -1)
+    return;
+  depths[offset] = depth;
+  offsets[*length] = offset;
+  ++(*length);
+}
+
+static inline int32_t instruction_size(uint8_t *pc)
+{
+  switch ((hk_opcode_t) pc[0])
+  {
+  case HK_OP_CONSTANT:
+  case HK_OP_ARRAY:
+  case HK_OP_STRUCT:
+  case HK_OP_INSTANCE:
+  case HK_OP_CONSTRUCT:
+  case HK_OP_CLOSURE:
+  case HK_OP_UNPACK_ARRAY:
+  case HK_OP_UNPACK_STRUCT:
+  case HK_OP_GLOBAL:
+  case HK_OP_NONLOCAL:
+  case HK_OP_LOAD:
+  case HK_OP_MOVE:
+  case HK_OP_STORE:
+  case HK_OP_CALL:
+  case HK_OP_TAIL_CALL:
+  case HK_OP_INCREMENT_LOCAL:
+  case HK_OP_DECREMENT_LOCAL:
+  case HK_OP_INCREMENT_NUM:
+  case HK_OP_DECREMENT_NUM:
+    return 2;
+  case HK_OP_INT:
+  case HK_OP_LOAD_LOAD:
+  case HK_OP_LOAD_ELEMENT:
+  case HK_OP_NONLOCAL_ELEMENT:
+  case HK_OP_JUMP:
+  case HK_OP_JUMP_IF_FALSE:
+  case HK_OP_JUMP_IF_TRUE:
+  case HK_OP_JUMP_IF_TRUE_OR_POP:
+  case HK_OP_JUMP_IF_FALSE_OR_POP:
+  case HK_OP_JUMP_IF_NOT_EQUAL:
+  case HK_OP_JUMP_IF_NOT_VALID:
+  case HK_OP_JUMP_IF_NOT_LESS:
+  case HK_OP_RANGE_STEP:
+    return 3;
+  case HK_OP_GET_FIELD:
+  case HK_OP_FETCH_FIELD:
+  case HK_OP_PUT_FIELD:
+  case HK_OP_INPLACE_PUT_FIELD:
+    return 4;
+  case HK_OP_LOAD_FIELD:
+  case HK_OP_NONLOCAL_FIELD:
+    return 5;
+  case HK_OP_WIDE:
+    return instruction_size(&pc[1]) + 2;
+  default:
+    break;
+  }
+  return 1;
+}
+
+static inline bool is_jump(hk_opcode_t op)
+{
+  return op == HK_OP_JUMP || op == HK_OP_JUMP_IF_FALSE || op == HK_OP_JUMP_IF_TRUE
+    || op == HK_OP_JUMP_IF_TRUE_OR_POP || op == HK_OP_JUMP_IF_FALSE_OR_POP
+    || op == HK_OP_JUMP_IF_NOT_EQUAL || op == HK_OP_JUMP_IF_NOT_VALID
+    || op == HK_OP_JUMP_IF_NOT_LESS || op == HK_OP_RANGE_STEP;
+}
+
+static inline bool is_pure_push(uint8_t *pc)
+{
+  switch ((hk_opcode_t) pc[0])
+  {
+  case HK_OP_NIL:
+  case HK_OP_FALSE:
+  case HK_OP_TRUE:
+  case HK_OP_INT:
+  case HK_OP_CONSTANT:
+  case HK_OP_GLOBAL:
+  case HK_OP_NONLOCAL:
+  case HK_OP_LOAD:
+    return true;
+  case HK_OP_WIDE:
+    return pc[1] == HK_OP_CONSTANT || pc[1] == HK_OP_LOAD;
+  default:
+    break;
+  }
+  return false;
+}
+
+static inline bool is_number_result(hk_opcode_t op, bool allow_negative_zero)
+{
+  switch (op)
+  {
+  case HK_OP_BITWISE_OR:
+  case HK_OP_BITWISE_XOR:
+  case HK_OP_BITWISE_AND:
+  case HK_OP_BITWISE_NOT:
+  case HK_OP_LEFT_SHIFT:
+  case HK_OP_RIGHT_SHIFT:
+  case HK_OP_INCREMENT:
+  case HK_OP_DECREMENT:
+    return true;
+  case HK_OP_ADD_UNCHECKED:
+  case HK_OP_SUBTRACT_UNCHECKED:
+  case HK_OP_MULTIPLY:
+  case HK_OP_MULTIPLY_NUM:
+  case HK_OP_MULTIPLY_UNCHECKED:
+  case HK_OP_DIVIDE:
+  case HK_OP_DIVIDE_NUM:
+  case HK_OP_DIVIDE_UNCHECKED:
+  case HK_OP_QUOTIENT:
+  case HK_OP_REMAINDER:
+  case HK_OP_NEGATE:
+    return allow_negative_zero;
+  default:
+    break;
+  }
+  return false;
+}
+
+static inline int32_t thread_jump(uint8_t *code, int32_t target)
+{
+  for (int32_t i = 0; i < UINT8_MAX && code[target] == HK_OP_JUMP; ++i)
+  {
+    int32_t next = *((uint16_t *) &code[target + 1]);
+    if (next == target)
+      break;
+    target = next;
+  }
+  return target;
+}
+
+static void optimize_function(hk_function_t *fn)
+{
+  for (int32_t i = 0; i < fn->functions_length; ++i)
+    optimize_function(fn->functions[i]);
+  hk_chunk_t *chunk = &fn->chunk;
+  uint8_t *code = chunk->code;
+  int32_t code_length = chunk->code_length;
+  bool *targets = (bool *) hk_allocate(sizeof(*targets) * (code_length + 1));
+  bool *removed = (bool *) hk_allocate(sizeof(*removed) * code_length);
+  int32_t *offsets = (int32_t *) hk_allocate(sizeof(*offsets) * (code_length + 1));
+  memset(targets, 0, sizeof(*targets) * (code_length + 1));
+  memset(removed, 0, sizeof(*removed) * code_length);
+  for (int32_t i = 0; i < code_length; i += instruction_size(&code[i]))
+  {
+    if (!is_jump((hk_opcode_t) code[i]))
+      continue;
+    uint16_t *operand = (uint16_t *) &code[i + 1];
+    *operand = (uint16_t) thread_jump(code, *operand);
+    targets[*operand] = true;
+  }
+  int32_t num_removed = 0;
+  int32_t prev = -1;
+  int32_t i = 0;
+  while (i < code_length)
+  {
+    hk_opcode_t op = (hk_opcode_t) code[i];
+    int32_t size = instruction_size(&code[i]);
+    int32_t j = i + size;
+    hk_opcode_t next_op = j < code_length && !targets[j] ? (hk_opcode_t) code[j] : HK_OP_NIL;
+    if (op == HK_OP_JUMP && *((uint16_t *) &code[i + 1]) == j)
+    {
+      removed[i] = true;
+      ++num_removed;
+      prev = -1;
+      i = j;
+      continue;
+    }
+    if (op == HK_OP_NOT && (next_op == HK_OP_JUMP_IF_FALSE || next_op == HK_OP_JUMP_IF_TRUE))
+    {
+      removed[i] = true;
+      code[j] = next_op == HK_OP_JUMP_IF_FALSE ? HK_OP_JUMP_IF_TRUE : HK_OP_JUMP_IF_FALSE;
+      ++num_removed;
+      prev = -1;
+      i = j;
+      continue;
+    }
+    bool is_pair = (is_pure_push(&code[i]) && next_op == HK_OP_POP)
+      || ((op == HK_OP_LOAD || op == HK_OP_MOVE) && next_op == HK_OP_STORE
+      && code[i + 1] == code[j + 1]);
+    if (!is_pair && op == HK_OP_INT && !targets[i] && prev != -1 && !*((uint16_t *) &code[i + 1]))
+      is_pair = (next_op == HK_OP_ADD && is_number_result((hk_opcode_t) code[prev], false))
+        || (next_op == HK_OP_SUBTRACT && is_number_result((hk_opcode_t) code[prev], true));
+    if (is_pair)
+    {
+      removed[i] = true;
+      removed[j] = true;
+      num_removed += 2;
+      prev = -1;
+      i = j + instruction_size(&code[j]);
+      continue;
+    }
+    prev = i;
+    i = j;
+  }
+  if (num_removed)
+  {
+    int32_t length = 0;
+    for (int32_t i = 0; i < code_length; i += instruction_size(&code[i]))
+    {
+      int32_t size = instruction_size(&code[i]);
+      for (int32_t k = 0; k < size; ++k)
+        offsets[i + k] = length;
+      if (!removed[i])
+        length += size;
+    }
+    offsets[code_length] = length;
+    for (int32_t i = 0; i < code_length;)
+    {
+      int32_t size = instruction_size(&code[i]);
+      if (!removed[i])
+      {
+        uint8_t *pc = &code[offsets[i]];
+        memmove(pc, &code[i], size);
+        if (is_jump((hk_opcode_t) pc[0]))
+        {
+          uint16_t *operand = (uint16_t *) &pc[1];
+          *operand = (uint16_t) offsets[*operand];
+        }
+      }
+      i += size;
+    }
+    chunk->code_length = length;
+    hk_line_t *lines = chunk->lines;
+    int32_t lines_length = 0;
+    for (int32_t i = 0; i < chunk->lines_length; ++i)
+    {
+      hk_line_t line = lines[i];
+      line.offset = offsets[line.offset];
+      if (lines_length && lines[lines_length - 1].offset == line.offset)
+        --lines_length;
+      lines[lines_length++] = line;
+    }
+    chunk->lines_length = lines_length;
+    for (int32_t i = 0; i < chunk->inlines_length; ++i)
+    {
+      hk_inline_t *inl = &chunk->inlines[i];
+      inl->start = offsets[inl->start];
+      inl->end = offsets[inl->end];
+    }
+    fn->num_removed += num_removed;
+  }
+  hk_free(offsets);
+  hk_free(removed);
+  hk_free(targets);
+}
+
+static inline int32_t stack_effect(hk_function_t *fn, uint8_t *pc, int32_t *jump_effect)
+{
+  int32_t effect = 0;
+  switch ((hk_opcode_t) pc[0])
+  {
+  case HK_OP_NIL:
+  case HK_OP_FALSE:
+  case HK_OP_TRUE:
+  case HK_OP_INT:
+  case HK_OP_CONSTANT:
+  case HK_OP_GLOBAL:
+  case HK_OP_NONLOCAL:
+  case HK_OP_LOAD:
+  case HK_OP_MOVE:
+  case HK_OP_LOAD_ELEMENT:
+  case HK_OP_LOAD_FIELD:
+  case HK_OP_NONLOCAL_ELEMENT:
+  case HK_OP_NONLOCAL_FIELD:
+  case HK_OP_FETCH_ELEMENT:
+    effect = 1;
+    break;
+  case HK_OP_LOAD_LOAD:
+  case HK_OP_FETCH_FIELD:
+    effect = 2;
+    break;
+  case HK_OP_ARRAY:
+    effect = 1 - pc[1];
+    break;
+  case HK_OP_STRUCT:
+  case HK_OP_INSTANCE:
+    effect = -pc[1];
+    break;
+  case HK_OP_CONSTRUCT:
+    effect = -(pc[1] << 1);
+    break;
+  case HK_OP_CLOSURE:
+    effect = 1 - fn->functions[pc[1]]->num_nonlocals;
+    break;
+  case HK_OP_UNPACK_ARRAY:
+    effect = pc[1] - 1;
+    break;
+  case HK_OP_CALL:
+  case HK_OP_TAIL_CALL:
+    effect = -pc[1];
+    break;
+  case HK_OP_UNPACK_STRUCT:
+  case HK_OP_STORE:
+  case HK_OP_PUT_FIELD:
+  case HK_OP_INPLACE_PUT_FIELD:
+  case HK_OP_JUMP_IF_TRUE_OR_POP:
+  case HK_OP_JUMP_IF_FALSE_OR_POP:
+    effect = -1;
+    break;
+  case HK_OP_SET_ELEMENT:
+  case HK_OP_PUT_ELEMENT:
+  case HK_OP_INPLACE_PUT_ELEMENT:
+  case HK_OP_SET_FIELD:
+    effect = -2;
+    break;
+  case HK_OP_JUMP_IF_FALSE:
+  case HK_OP_JUMP_IF_TRUE:
+    effect = -1;
+    *jump_effect = -1;
+    break;
+  case HK_OP_JUMP_IF_NOT_EQUAL:
+    effect = -2;
+    *jump_effect = -1;
+    break;
+  case HK_OP_JUMP_IF_NOT_LESS:
+    effect = -2;
+    *jump_effect = -2;
+    break;
+  case HK_OP_WIDE:
+    switch (pc[1])
+    {
+    case HK_OP_CONSTANT:
+    case HK_OP_LOAD:
+      effect = 1;
+      break;
+    case HK_OP_STORE:
+      effect = -1;
+      break;
+    case HK_OP_CLOSURE:
+      effect = 1 - fn->functions[*((uint16_t *) &pc[2])]->num_nonlocals;
+      break;
+    case HK_OP_GET_FIELD:
+      break;
+    case HK_OP_FETCH_FIELD:
+      effect = 2;
+      break;
+    case HK_OP_PUT_FIELD:
+    case HK_OP_INPLACE_PUT_FIELD:
+      effect = -1;
+      break;
+    }
+    break;
+  case HK_OP_INCREMENT_LOCAL:
+  case HK_OP_DECREMENT_LOCAL:
+  case HK_OP_INCREMENT_NUM:
+  case HK_OP_DECREMENT_NUM:
+  case HK_OP_GET_FIELD:
+  case HK_OP_JUMP:
+  case HK_OP_JUMP_IF_NOT_VALID:
+  case HK_OP_RANGE_STEP:
+  case HK_OP_RANGE_LOOP:
+  case HK_OP_ITERATOR:
+  case HK_OP_CURRENT:
+  case HK_OP_NEXT:
+  case HK_OP_NEGATE:
+  case HK_OP_NOT:
+  case HK_OP_BITWISE_NOT:
+  case HK_OP_INCREMENT:
+  case HK_OP_DECREMENT:
+  case HK_OP_LOAD_MODULE:
+  case HK_OP_RETURN:
+    break;
+  case HK_OP_RETURN_NIL:
+    effect = 1;
+    break;
+  case HK_OP_RANGE:
+  case HK_OP_POP:
+  case HK_OP_ADD_ELEMENT:
+  case HK_OP_GET_ELEMENT:
+  case HK_OP_DELETE_ELEMENT:
+  case HK_OP_INPLACE_ADD_ELEMENT:
+  case HK_OP_INPLACE_DELETE_ELEMENT:
+  case HK_OP_EQUAL:
+  case HK_OP_GREATER:
+  case HK_OP_LESS:
+  case HK_OP_NOT_EQUAL:
+  case HK_OP_NOT_GREATER:
+  case HK_OP_NOT_LESS:
+  case HK_OP_BITWISE_OR:
+  case HK_OP_BITWISE_XOR:
+  case HK_OP_BITWISE_AND:
+  case HK_OP_LEFT_SHIFT:
+  case HK_OP_RIGHT_SHIFT:
+  case HK_OP_ADD:
+  case HK_OP_SUBTRACT:
+  case HK_OP_MULTIPLY:
+  case HK_OP_DIVIDE:
+  case HK_OP_QUOTIENT:
+  case HK_OP_REMAINDER:
+  case HK_OP_GREATER_NUM:
+  case HK_OP_LESS_NUM:
+  case HK_OP_NOT_GREATER_NUM:
+  case HK_OP_NOT_LESS_NUM:
+  case HK_OP_ADD_NUM:
+  case HK_OP_SUBTRACT_NUM:
+  case HK_OP_MULTIPLY_NUM:
+  case HK_OP_DIVIDE_NUM:
+  case HK_OP_GREATER_UNCHECKED:
+  case HK_OP_LESS_UNCHECKED:
+  case HK_OP_NOT_GREATER_UNCHECKED:
+  case HK_OP_NOT_LESS_UNCHECKED:
+  case HK_OP_ADD_UNCHECKED:
+  case HK_OP_SUBTRACT_UNCHECKED:
+  case HK_OP_MULTIPLY_UNCHECKED:
+  case HK_OP_DIVIDE_UNCHECKED:
+    effect = -1;
+    break;
+  }
+  return effect;
+}
+
+static int32_t compute_depth(hk_function_t *fn, int32_t start, int32_t depth, int32_t end)
+{
+  if (end < start)
+    return -1;
+  uint8_t *code = fn->chunk.code;
+  int32_t length = end - start + 1;
+  int32_t *depths = (int32_t *) hk_allocate(sizeof(*depths) * length);
+  int32_t *offsets = (int32_t *) hk_allocate(sizeof(*offsets) * length);
+  for (int32_t i = 0; i < length; ++i)
+    depths[i] = -1;
+  int32_t num_offsets = 0;
+  mark_depth(depths, offsets, &num_offsets, 0, depth);
+  while (num_offsets)
+  {
+    int32_t offset = offsets[--num_offsets];
+    int32_t depth = depths[offset];
+    while (offset < length - 1)
+    {
+      uint8_t *pc = &code[start + offset];
+      hk_opcode_t op = (hk_opcode_t) pc[0];
+      int32_t jump_effect = 0;
+      int32_t effect = stack_effect(fn, pc, &jump_effect);
+      if (is_jump(op))
+      {
+        int32_t jump = *((uint16_t *) &pc[1]) - start;
+        if (jump >= 0 && jump < length)
+          mark_depth(depths, offsets, &num_offsets, jump, depth + jump_effect);
+      }
+      if (op == HK_OP_JUMP || op == HK_OP_RETURN || op == HK_OP_RETURN_NIL)
+        break;
+      depth += effect;
+      offset += instruction_size(pc);
+      if (offset >= length || depths[offset] != -1)
+        break;
+      depths[offset] = depth;
+    }
+  }
+  int32_t result = depths[length - 1];
+  hk_free(depths);
+  hk_free(offsets);
+  return result;
+}
+
+static void compute_max_stack(hk_function_t *fn)
+{
+  for (int32_t i = 0; i < fn->functions_length; ++i)
+    compute_max_stack(fn->functions[i]);
+  uint8_t *code = fn->chunk.code;
+  int32_t code_length = fn->chunk.code_length;
+  int32_t *depths = (int32_t *) hk_allocate(sizeof(*depths) * code_length);
+  int32_t *offsets = (int32_t *) hk_allocate(sizeof(*offsets) * code_length);
+  for (int32_t i = 0; i < code_length; ++i)
+    depths[i] = -1;
+  int32_t length = 0;
+  int32_t max_stack = fn->arity + 1;
+  mark_depth(depths, offsets, &length, 0, max_stack);
+  while (length)
+  {
+    int32_t offset = offsets[--length];
+    int32_t depth = depths[offset];
+    for (;;)
+    {
+      uint8_t *pc = &code[offset];
+      hk_opcode_t op = (hk_opcode_t) pc[0];
+      int32_t jump_effect = 0;
+      int32_t effect = stack_effect(fn, pc, &jump_effect);
+      if ((op == HK_OP_LOAD_ELEMENT || op == HK_OP_NONLOCAL_ELEMENT) && depth + 2 > max_stack)
+        max_stack = depth + 2;
+      if (is_jump(op))
+        mark_depth(depths, offsets, &length, *((uint16_t *) &pc[1]), depth + jump_effect);
+      depth += effect;
+      if (depth > max_stack)
+        max_stack = depth;
+      if (op == HK_OP_JUMP || op == HK_OP_RETURN || op == HK_OP_RETURN_NIL)
+        break;
+      offset += instruction_size(pc);
+      if (depths[offset] != -1)
+        break;
+      depths[offset] = depth;
+    }
+  }
+  hk_free(depths);
+  hk_free(offsets);
+  fn->max_stack = max_stack;
+}
+
+static inline bool is_number_callee(uint8_t index)
+{
+  return index == lookup_global(6, "to_int") || index == lookup_global(9, "to_number")
+    || index == lookup_global(3, "len");
+}
+
+static inline void mark_types(int32_t *depths, uint8_t *states, int32_t size, bool *queued,
+  int32_t *entries, int32_t *length, int32_t entry, uint8_t *types, int32_t depth)
+{
+  uint8_t *state = &states[entry * size];
+  bool changed = false;
+  if (depths[entry] == -1)
+  {
+    depths[entry] = depth;
+    memcpy(state, types, depth);
+    changed = true;
+  }
+  for (int32_t i = 0; i < depths[entry]; ++i)
+  {
+    if (state[i] == TYPE_ANY || (i < depth && state[i] == types[i]))
+      continue;
+    state[i] = TYPE_ANY;
+    changed = true;
+  }
+  if (!changed || queued[entry])
+    return;
+  queued[entry] = true;
+  entries[*length] = entry;
+  ++(*length);
+}
+
+static inline void rewrite_opcode(uint8_t *pc, uint8_t *types, int32_t depth)
+{
+  hk_opcode_t op;
+  switch ((hk_opcode_t) pc[0])
+  {
+  case HK_OP_GREATER:
+  case HK_OP_GREATER_NUM:
+    op = HK_OP_GREATER_UNCHECKED;
+    break;
+  case HK_OP_LESS:
+  case HK_OP_LESS_NUM:
+    op = HK_OP_LESS_UNCHECKED;
+    break;
+  case HK_OP_NOT_GREATER:
+  case HK_OP_NOT_GREATER_NUM:
+    op = HK_OP_NOT_GREATER_UNCHECKED;
+    break;
+  case HK_OP_NOT_LESS:
+  case HK_OP_NOT_LESS_NUM:
+    op = HK_OP_NOT_LESS_UNCHECKED;
+    break;
+  case HK_OP_ADD:
+  case HK_OP_ADD_NUM:
+    op = HK_OP_ADD_UNCHECKED;
+    break;
+  case HK_OP_SUBTRACT:
+  case HK_OP_SUBTRACT_NUM:
+    op = HK_OP_SUBTRACT_UNCHECKED;
+    break;
+  case HK_OP_MULTIPLY:
+  case HK_OP_MULTIPLY_NUM:
+    op = HK_OP_MULTIPLY_UNCHECKED;
+    break;
+  case HK_OP_DIVIDE:
+  case HK_OP_DIVIDE_NUM:
+    op = HK_OP_DIVIDE_UNCHECKED;
+    break;
+  case HK_OP_INCREMENT_LOCAL:
+    if (types[pc[1]] == TYPE_NUMBER)
+      pc[0] = HK_OP_INCREMENT_NUM;
+    return;
+  case HK_OP_DECREMENT_LOCAL:
+    if (types[pc[1]] == TYPE_NUMBER)
+      pc[0] = HK_OP_DECREMENT_NUM;
+    return;
+  default:
+    return;
+  }
+  if (types[depth - 2] == TYPE_NUMBER && types[depth - 1] == TYPE_NUMBER)
+    pc[0] = (uint8_t) op;
+}
+
+static inline void update_types(hk_function_t *fn, uint8_t *pc, uint8_t *types, int32_t depth,
+  int32_t next_depth)
+{
+  hk_value_t *consts = fn->chunk.consts->elements;
+  hk_opcode_t op = (hk_opcode_t) pc[0];
+  int32_t start = next_depth > depth ? depth : next_depth - 1;
+  uint8_t type = TYPE_ANY;
+  switch (op)
+  {
+  case HK_OP_POP:
+  case HK_OP_JUMP:
+  case HK_OP_JUMP_IF_FALSE:
+  case HK_OP_JUMP_IF_TRUE:
+  case HK_OP_JUMP_IF_TRUE_OR_POP:
+  case HK_OP_JUMP_IF_FALSE_OR_POP:
+  case HK_OP_JUMP_IF_NOT_EQUAL:
+  case HK_OP_JUMP_IF_NOT_VALID:
+  case HK_OP_JUMP_IF_NOT_LESS:
+  case HK_OP_RETURN:
+  case HK_OP_RETURN_NIL:
+    return;
+  case HK_OP_INT:
+    type = TYPE_NUMBER;
+    break;
+  case HK_OP_CONSTANT:
+    if (hk_is_number(consts[pc[1]]))
+      type = TYPE_NUMBER;
+    break;
+  case HK_OP_GLOBAL:
+    if (is_number_callee(pc[1]))
+      type = TYPE_NUMBER_CALLEE;
+    break;
+  case HK_OP_LOAD:
+    type = types[pc[1]];
+    break;
+  case HK_OP_LOAD_LOAD:
+    types[depth] = types[pc[1]];
+    type = types[pc[2]];
+    ++start;
+    break;
+  case HK_OP_MOVE:
+    type = types[pc[1]];
+    types[pc[1]] = TYPE_ANY;
+    break;
+  case HK_OP_STORE:
+    types[pc[1]] = types[depth - 1];
+    return;
+  case HK_OP_INCREMENT_LOCAL:
+  case HK_OP_DECREMENT_LOCAL:
+  case HK_OP_INCREMENT_NUM:
+  case HK_OP_DECREMENT_NUM:
+    types[pc[1]] = TYPE_NUMBER;
+    return;
+  case HK_OP_RANGE_LOOP:
+    start = depth - 3;
+    type = TYPE_NUMBER;
+    break;
+  case HK_OP_RANGE_STEP:
+    types[depth - 3] = TYPE_NUMBER;
+    return;
+  case HK_OP_CURRENT:
+    types[depth - 2] = TYPE_ANY;
+    return;
+  case HK_OP_FETCH_ELEMENT:
+    start = depth - 2;
+    break;
+  case HK_OP_FETCH_FIELD:
+  case HK_OP_UNPACK_ARRAY:
+    start = depth - 1;
+    break;
+  case HK_OP_UNPACK_STRUCT:
+    start = next_depth - pc[1];
+    break;
+  case HK_OP_CALL:
+    if (types[next_depth - 1] == TYPE_NUMBER_CALLEE)
+      type = TYPE_NUMBER;
+    break;
+  case HK_OP_ADD:
+  case HK_OP_ADD_NUM:
+  case HK_OP_SUBTRACT:
+  case HK_OP_SUBTRACT_NUM:
+    if (types[depth - 2] == TYPE_NUMBER)
+      type = TYPE_NUMBER;
+    break;
+  case HK_OP_WIDE:
+    {
+      int32_t index = *((uint16_t *) &pc[2]);
+      switch (pc[1])
+      {
+      case HK_OP_CONSTANT:
+        if (hk_is_number(consts[index]))
+          type = TYPE_NUMBER;
+        break;
+      case HK_OP_LOAD:
+        type = types[index];
+        break;
+      case HK_OP_STORE:
+        types[index] = types[depth - 1];
+        return;
+      case HK_OP_FETCH_FIELD:
+        start = depth - 1;
+        break;
+      }
+    }
+    break;
+  default:
+    if (is_number_result(op, true))
+      type = TYPE_NUMBER;
+    break;
+  }
+  for (int32_t i = start; i < next_depth; ++i)
+    types[i] = type;
+}
+
+static void infer_types(hk_function_t *fn)
+{
+  for (int32_t i = 0; i < fn->functions_length; ++i)
+    infer_types(fn->functions[i]);
+  uint8_t *code = fn->chunk.code;
+  int32_t code_length = fn->chunk.code_length;
+  int32_t size = fn->max_stack;
+  int32_t *entry_of = (int32_t *) hk_allocate(sizeof(*entry_of) * (code_length + 1));
+  int32_t *offsets = (int32_t *) hk_allocate(sizeof(*offsets) * (code_length + 1));
+  for (int32_t i = 0; i <= code_length; ++i)
+    entry_of[i] = -1;
+  int32_t num_entries = 0;
+  entry_of[0] = num_entries;
+  offsets[num_entries++] = 0;
+  for (int32_t i = 0; i < code_length; i += instruction_size(&code[i]))
+  {
+    if (!is_jump((hk_opcode_t) code[i]))
+      continue;
+    int32_t target = *((uint16_t *) &code[i + 1]);
+    if (entry_of[target] != -1)
+      continue;
+    entry_of[target] = num_entries;
+    offsets[num_entries++] = target;
+  }
+  int32_t *depths = (int32_t *) hk_allocate(sizeof(*depths) * num_entries);
+  uint8_t *states = (uint8_t *) hk_allocate(sizeof(*states) * num_entries * size);
+  bool *queued = (bool *) hk_allocate(sizeof(*queued) * num_entries);
+  int32_t *entries = (int32_t *) hk_allocate(sizeof(*entries) * num_entries);
+  uint8_t *types = (uint8_t *) hk_allocate(sizeof(*types) * size);
+  for (int32_t i = 0; i < num_entries; ++i)
+  {
+    depths[i] = -1;
+    queued[i] = false;
+  }
+  int32_t length = 0;
+  memset(types, TYPE_ANY, size);
+  mark_types(depths, states, size, queued, entries, &length, 0, types, fn->arity + 1);
+  bool rewrite = false;
+  for (;;)
+  {
+    if (!length)
+    {
+      if (rewrite)
+        break;
+      rewrite = true;
+      for (int32_t i = num_entries - 1; i >= 0; --i)
+        if (depths[i] != -1)
+          entries[length++] = i;
+      continue;
+    }
+    int32_t entry = entries[--length];
+    queued[entry] = false;
+    int32_t offset = offsets[entry];
+    int32_t depth = depths[entry];
+    memcpy(types, &states[entry * size], depth);
+    for (;;)
+    {
+      uint8_t *pc = &code[offset];
+      hk_opcode_t op = (hk_opcode_t) pc[0];
+      int32_t jump_effect = 0;
+      int32_t next_depth = depth + stack_effect(fn, pc, &jump_effect);
+      if (rewrite)
+        rewrite_opcode(pc, types, depth);
+      update_types(fn, pc, types, depth, next_depth);
+      if (!rewrite && is_jump(op))
+        mark_types(depths, states, size, queued, entries, &length,
+          entry_of[*((uint16_t *) &pc[1])], types, depth + jump_effect);
+      if (op == HK_OP_JUMP || op == HK_OP_RETURN || op == HK_OP_RETURN_NIL)
+        break;
+      depth = next_depth;
+      offset += instruction_size(pc);
+      if (entry_of[offset] == -1)
+        continue;
+      if (!rewrite)
+        mark_types(depths, states, size, queued, entries, &length, entry_of[offset], types,
+          depth);
+      break;
+    }
+  }
+  hk_free(types);
+  hk_free(entries);
+  hk_free(queued);
+  hk_free(states);
+  hk_free(depths);
+  hk_free(offsets);
+  hk_free(entry_of);
+}
+
+hk_closure_t *hk_compile(hk_string_t *file, hk_string_t *source, int32_t flags)
 {
   scanner_t scan;
   scanner_init(&scan, file, source);
   compiler_t comp;
   compiler_init(&comp, NULL, &scan, hk_string_from_chars(-1, "main"));
+  comp.flags = flags;
   char args_name[] = "args";
   token_t tk = {.length = sizeof(args_name) - 1, .start = args_name};
   add_local(&comp, &tk, false);
@@ -2214,7 +3852,13 @@ hk_closure_t *hk_compile(hk_string_t *file, hk_string_t *source)
   hk_function_t *fn = comp.fn;
   hk_chunk_t *chunk = &fn->chunk;
   hk_chunk_emit_opcode(chunk, HK_OP_RETURN_NIL);
+  if (comp.flags & HK_COMPILER_FLAG_OPTIMIZE)
+    optimize_function(fn);
+  compute_max_stack(fn);
+  if (comp.flags & HK_COMPILER_FLAG_OPTIMIZE)
+    infer_types(fn);
   hk_closure_t *cl = hk_closure_new(fn);
+  compiler_free(&comp);
   scanner_free(&scan);
   return cl;
 }
@@ -139,19 +139,39 @@ void hk_dump(hk_function_t *fn, FILE *stream)
       fprintf(stream, "InplaceDeleteElement\n");
       break;
     case HK_OP_GET_FIELD:
-      fprintf(stream, "GetField              %5d\n", code[i++]);
+      {
+        int32_t index = code[i++];
+        int32_t cache = *((uint16_t*) &code[i]);
+        i += 2;
+        fprintf(stream, "GetField              %5d %5d\n", index, cache);
+      }
       break;
     case HK_OP_FETCH_FIELD:
-      fprintf(stream, "FetchField            %5d\n", code[i++]);
+      {
+        int32_t index = code[i++];
+        int32_t cache = *((uint16_t*) &code[i]);
+        i += 2;
+        fprintf(stream, "FetchField            %5d %5d\n", index, cache);
+      }
       break;
     case HK_OP_SET_FIELD:
       fprintf(stream, "SetField\n");
       break;
     case HK_OP_PUT_FIELD:
-      fprintf(stream, "PutField              %5d\n", code[i++]);
+      {
+        int32_t index = code[i++];
+        int32_t cache = *((uint16_t*) &code[i]);
+        i += 2;
+        fprintf(stream, "PutField              %5d %5d\n", index, cache);
+      }
       break;
     case HK_OP_INPLACE_PUT_FIELD:
-      fprintf(stream, "InplacePutField       %5d\n", code[i++]);
+      {
+        int32_t index = code[i++];
+        int32_t cache = *((uint16_t*) &code[i]);
+        i += 2;
+        fprintf(stream, "InplacePutField       %5d %5d\n", index, cache);
+      }
       break;
     case HK_OP_CURRENT:
       fprintf(stream, "Current\n");
@@ -277,6 +297,9 @@ void hk_dump(hk_function_t *fn, FILE *stream)
     case HK_OP_CALL:
       fprintf(stream, "Call                  %5d\n", code[i++]);
       break;
+    case HK_OP_TAIL_CALL:
+      fprintf(stream, "TailCall              %5d\n", code[i++]);
+      break;
     case HK_OP_LOAD_MODULE:
       fprintf(stream, "LoadModule\n");
       break;
@@ -286,9 +309,168 @@ void hk_dump(hk_function_t *fn, FILE *stream)
     case HK_OP_RETURN_NIL:
       fprintf(stream, "ReturnNil\n");
       break;
+    case HK_OP_LOAD_LOAD:
+      {
+        int32_t index1 = code[i++];
+        int32_t index2 = code[i++];
+        fprintf(stream, "LoadLoad              %5d %5d\n", index1, index2);
+      }
+      break;
+    case HK_OP_INCREMENT_LOCAL:
+      fprintf(stream, "IncrementLocal        %5d\n", code[i++]);
+      break;
+    case HK_OP_DECREMENT_LOCAL:
+      fprintf(stream, "DecrementLocal        %5d\n", code[i++]);
+      break;
+    case HK_OP_JUMP_IF_NOT_LESS:
+      {
+        int32_t offset = *((uint16_t*) &code[i]);
+        i += 2;
+        fprintf(stream, "JumpIfNotLess         %5d\n", offset);
+      }
+      break;
+    case HK_OP_GREATER_NUM:
+      fprintf(stream, "GreaterNum\n");
+      break;
+    case HK_OP_LESS_NUM:
+      fprintf(stream, "LessNum\n");
+      break;
+    case HK_OP_NOT_GREATER_NUM:
+      fprintf(stream, "NotGreaterNum\n");
+      break;
+    case HK_OP_NOT_LESS_NUM:
+      fprintf(stream, "NotLessNum\n");
+      break;
+    case HK_OP_ADD_NUM:
+      fprintf(stream, "AddNum\n");
+      break;
+    case HK_OP_SUBTRACT_NUM:
+      fprintf(stream, "SubtractNum\n");
+      break;
+    case HK_OP_MULTIPLY_NUM:
+      fprintf(stream, "MultiplyNum\n");
+      break;
+    case HK_OP_DIVIDE_NUM:
+      fprintf(stream, "DivideNum\n");
+      break;
+    case HK_OP_RANGE_LOOP:
+      fprintf(stream, "RangeLoop\n");
+      break;
+    case HK_OP_RANGE_STEP:
+      {
+        int32_t offset = *((uint16_t*) &code[i]);
+        i += 2;
+        fprintf(stream, "RangeStep             %5d\n", offset);
+      }
+      break;
+    case HK_OP_MOVE:
+      fprintf(stream, "Move                  %5d\n", code[i++]);
+      break;
+    case HK_OP_LOAD_ELEMENT:
+      {
+        int32_t index1 = code[i++];
+        int32_t index2 = code[i++];
+        fprintf(stream, "LoadElement           %5d %5d\n", index1, index2);
+      }
+      break;
+    case HK_OP_LOAD_FIELD:
+      {
+        int32_t local = code[i++];
+        int32_t index = code[i++];
+        int32_t cache = *((uint16_t*) &code[i]);
+        i += 2;
+        fprintf(stream, "LoadField             %5d %5d %5d\n", local, index, cache);
+      }
+      break;
+    case HK_OP_NONLOCAL_ELEMENT:
+      {
+        int32_t index1 = code[i++];
+        int32_t index2 = code[i++];
+        fprintf(stream, "NonLocalElement       %5d %5d\n", index1, index2);
+      }
+      break;
+    case HK_OP_NONLOCAL_FIELD:
+      {
+        int32_t nonlocal = code[i++];
+        int32_t index = code[i++];
+        int32_t cache = *((uint16_t*) &code[i]);
+        i += 2;
+        fprintf(stream, "NonLocalField         %5d %5d %5d\n", nonlocal, index, cache);
+      }
+      break;
+    case HK_OP_GREATER_UNCHECKED:
+      fprintf(stream, "GreaterUnchecked\n");
+      break;
+    case HK_OP_LESS_UNCHECKED:
+      fprintf(stream, "LessUnchecked\n");
+      break;
+    case HK_OP_NOT_GREATER_UNCHECKED:
+      fprintf(stream, "NotGreaterUnchecked\n");
+      break;
+    case HK_OP_NOT_LESS_UNCHECKED:
+      fprintf(stream, "NotLessUnchecked\n");
+      break;
+    case HK_OP_ADD_UNCHECKED:
+      fprintf(stream, "AddUnchecked\n");
+      break;
+    case HK_OP_SUBTRACT_UNCHECKED:
+      fprintf(stream, "SubtractUnchecked\n");
+      break;
+    case HK_OP_MULTIPLY_UNCHECKED:
+      fprintf(stream, "MultiplyUnchecked\n");
+      break;
+    case HK_OP_DIVIDE_UNCHECKED:
+      fprintf(stream, "DivideUnchecked\n");
+      break;
+    case HK_OP_INCREMENT_NUM:
+      fprintf(stream, "IncrementNum          %5d\n", code[i++]);
+      break;
+    case HK_OP_DECREMENT_NUM:
+      fprintf(stream, "DecrementNum          %5d\n", code[i++]);
+      break;
+    case HK_OP_WIDE:
+      {
+        hk_opcode_t wide_op = (hk_opcode_t) code[i++];
+        int32_t index = *((uint16_t*) &code[i]);
+        i += 2;
+        switch (wide_op)
+        {
+        case HK_OP_CONSTANT:
+          fprintf(stream, "WideConstant          %5d\n", index);
+          break;
+        case HK_OP_CLOSURE:
+          fprintf(stream, "WideClosure           %5d\n", index);
+          break;
+        case HK_OP_LOAD:
+          fprintf(stream, "WideLoad              %5d\n", index);
+          break;
+        case HK_OP_STORE:
+          fprintf(stream, "WideStore             %5d\n", index);
+          break;
+        case HK_OP_GET_FIELD:
+        case HK_OP_FETCH_FIELD:
+        case HK_OP_PUT_FIELD:
+        case HK_OP_INPLACE_PUT_FIELD:
+          {
+            int32_t cache = *((uint16_t*) &code[i]);
+            i += 2;
+            const char *name = wide_op == HK_OP_GET_FIELD ? "WideGetField"
+              : wide_op == HK_OP_FETCH_FIELD ? "WideFetchField"
+              : wide_op == HK_OP_PUT_FIELD ? "WidePutField" : "WideInplacePutField";
+            fprintf(stream, "%-21s %5d %5d\n", name, index, cache);
+          }
+          break;
+        default:
+          break;
+        }
+      }
+      break;
     }
   }
-  fprintf(stream, "; %d instruction(s)\n\n", n);
+  if (fn->num_removed)
+    fprintf(stream, "; %d instruction(s), %d removed by the optimizer\n\n", n, fn->num_removed);
+  else
+    fprintf(stream, "; %d instruction(s)\n\n", n);
   for (int32_t i = 0; i < fn->functions_length; ++i)
     hk_dump(fn->functions[i], stream);
 }
@@ -0,0 +1,439 @@
+//
+// The Hook Programming Language
+// gc.c
+//
+
+#include "gc.h"
+#include <hook/array.h>
+#include <hook/memory.h>
+#include <hook/check.h>
+#include <hook/status.h>
+
+#define MIN_CAPACITY (1 << 8)
+
+typedef struct
+{
+  HK_CONTAINER_HEADER
+} container_t;
+
+typedef struct
+{
+  int32_t capacity;
+  int32_t length;
+  hk_value_t *values;
+} buffer_t;
+
+bool gc_enabled = false;
+static bool pending = false;
+static bool collecting = false;
+static int32_t threshold = GC_DEFAULT_THRESHOLD;
+static int32_t budget = GC_DEFAULT_BUDGET;
+static int64_t num_collections = 0;
+static int64_t num_collected = 0;
+static buffer_t roots = {0, 0, NULL};
+static buffer_t garbage = {0, 0, NULL};
+
+static inline void buffer_push(buffer_t *buf, hk_value_t val);
+static inline bool is_container(hk_value_t val);
+static inline container_t *as_container(hk_value_t val);
+static inline int32_t color(container_t *obj);
+static inline void set_color(container_t *obj, int32_t color);
+static inline void traverse(hk_value_t val, void (*visit)(hk_value_t));
+static inline void clear(hk_value_t val);
+static void mark_gray(hk_value_t val);
+static void mark_gray_child(hk_value_t val);
+static void scan(hk_value_t val);
+static void scan_black(hk_value_t val);
+static void scan_black_child(hk_value_t val);
+static void collect_white(hk_value_t val);
+static void restore_child(hk_value_t val);
+static int32_t enable_call(hk_state_t *state, hk_value_t *args);
+static int32_t disable_call(hk_state_t *state, hk_value_t *args);
+static int32_t is_enabled_call(hk_state_t *state, hk_value_t *args);
+static int32_t collect_call(hk_state_t *state, hk_value_t *args);
+static int32_t step_call(hk_state_t *state, hk_value_t *args);
+static int32_t set_threshold_call(hk_state_t *state, hk_value_t *args);
+static int32_t set_budget_call(hk_state_t *state, hk_value_t *args);
+static int32_t stats_call(hk_state_t *state, hk_value_t *args);
+
+static inline void buffer_push(buffer_t *buf, hk_value_t val)
+{
+  if (buf->length == buf->capacity)
+  {
+    int32_t capacity = buf->capacity ? buf->capacity << 1 : MIN_CAPACITY;
+    buf->values = (hk_value_t *) hk_reallocate(buf->values, sizeof(*buf->values) * capacity);
+    buf->capacity = capacity;
+  }
+  buf->values[buf->length] = val;
+  ++buf->length;
+}
+
+static inline bool is_container(hk_value_t val)
+{
+  switch (hk_type(val))
+  {
+  case HK_TYPE_ARRAY:
+  case HK_TYPE_INSTANCE:
+    return true;
+  case HK_TYPE_CALLABLE:
+    return !hk_is_native(val);
+  case HK_TYPE_USERDATA:
+    return hk_as_userdata(val)->traverse != NULL;
+  default:
+    break;
+  }
+  return false;
+}
+
+static inline container_t *as_container(hk_value_t val)
+{
+  return (container_t *) hk_as_object(val);
+}
+
+static inline int32_t color(container_t *obj)
+{
+  return obj->gc_flags & GC_COLOR_MASK;
+}
+
+static inline void set_color(container_t *obj, int32_t color)
+{
+  obj->gc_flags = (obj->gc_flags & ~GC_COLOR_MASK) | color;
+}
+
+static inline void traverse(hk_value_t val, void (*visit)(hk_value_t))
+{
+  switch (hk_type(val))
+  {
+  case HK_TYPE_ARRAY:
+    {
+      hk_array_t *arr = hk_as_array(val);
+      for (int32_t i = 0; i < arr->length; ++i)
+        visit(arr->elements[i]);
+    }
+    break;
+  case HK_TYPE_INSTANCE:
+    {
+      hk_instance_t *inst = hk_as_instance(val);
+      int32_t length = inst->ztruct->length;
+      for (int32_t i = 0; i < length; ++i)
+        visit(inst->values[i]);
+    }
+    break;
+  case HK_TYPE_CALLABLE:
+    {
+      hk_closure_t *cl = hk_as_closure(val);
+      int32_t num_nonlocals = cl->fn->num_nonlocals;
+      for (int32_t i = 0; i < num_nonlocals; ++i)
+        visit(cl->nonlocals[i]);
+    }
+    break;
+  case HK_TYPE_USERDATA:
+    {
+      hk_userdata_t *udata = hk_as_userdata(val);
+      udata->traverse(udata, visit);
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+static inline void clear(hk_value_t val)
+{
+  switch (hk_type(val))
+  {
+  case HK_TYPE_ARRAY:
+    {
+      hk_array_t *arr = hk_as_array(val);
+      for (int32_t i = 0; i < arr->length; ++i)
+        hk_value_release(arr->elements[i]);
+      arr->length = 0;
+    }
+    break;
+  case HK_TYPE_INSTANCE:
+    {
+      hk_instance_t *inst = hk_as_instance(val);
+      int32_t length = inst->ztruct->length;
+      for (int32_t i = 0; i < length; ++i)
+      {
+        hk_value_release(inst->values[i]);
+        inst->values[i] = HK_NIL_VALUE;
+      }
+    }
+    break;
+  case HK_TYPE_CALLABLE:
+    {
+      hk_closure_t *cl = hk_as_closure(val);
+      int32_t num_nonlocals = cl->fn->num_nonlocals;
+      for (int32_t i = 0; i < num_nonlocals; ++i)
+      {
+        hk_value_release(cl->nonlocals[i]);
+        cl->nonlocals[i] = HK_NIL_VALUE;
+      }
+    }
+    break;
+  case HK_TYPE_USERDATA:
+    {
+      hk_userdata_t *udata = hk_as_userdata(val);
+      if (udata->deinit)
+        udata->deinit(udata);
+      udata->deinit = NULL;
+      udata->traverse = NULL;
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+static void mark_gray(hk_value_t val)
+{
+  container_t *obj = as_container(val);
+  if (color(obj) == GC_GRAY)
+    return;
+  set_color(obj, GC_GRAY);
+  traverse(val, &mark_gray_child);
+}
+
+static void mark_gray_child(hk_value_t val)
+{
+  if (!is_container(val))
+    return;
+  hk_decr_ref(as_container(val));
+  mark_gray(val);
+}
+
+static void scan(hk_value_t val)
+{
+  if (!is_container(val))
+    return;
+  container_t *obj = as_container(val);
+  if (color(obj) != GC_GRAY)
+    return;
+  if (obj->ref_count > 0)
+  {
+    scan_black(val);
+    return;
+  }
+  set_color(obj, GC_WHITE);
+  traverse(val, &scan);
+}
+
+static void scan_black(hk_value_t val)
+{
+  set_color(as_container(val), GC_BLACK);
+  traverse(val, &scan_black_child);
+}
+
+static void scan_black_child(hk_value_t val)
+{
+  if (!is_container(val))
+    return;
+  container_t *obj = as_container(val);
+  hk_incr_ref(obj);
+  if (color(obj) != GC_BLACK)
+    scan_black(val);
+}
+
+static void collect_white(hk_value_t val)
+{
+  if (!is_container(val))
+    return;
+  container_t *obj = as_container(val);
+  if (color(obj) != GC_WHITE)
+    return;
+  set_color(obj, GC_BLACK);
+  buffer_push(&garbage, val);
+  traverse(val, &collect_white);
+}
+
+static void restore_child(hk_value_t val)
+{
+  if (!is_container(val))
+    return;
+  hk_incr_ref(as_container(val));
+}
+
+static int32_t enable_call(hk_state_t *state, hk_value_t *args)
+{
+  (void) args;
+  gc_enabled = true;
+  return hk_state_push_nil(state);
+}
+
+static int32_t disable_call(hk_state_t *state, hk_value_t *args)
+{
+  (void) args;
+  gc_enabled = false;
+  return hk_state_push_nil(state);
+}
+
+static int32_t is_enabled_call(hk_state_t *state, hk_value_t *args)
+{
+  (void) args;
+  return hk_state_push_bool(state, gc_enabled);
+}
+
+static int32_t collect_call(hk_state_t *state, hk_value_t *args)
+{
+  (void) args;
+  return hk_state_push_number(state, gc_collect(0));
+}
+
+static int32_t step_call(hk_state_t *state, hk_value_t *args)
+{
+  (void) args;
+  return hk_state_push_number(state, gc_collect(budget));
+}
+
+static int32_t set_threshold_call(hk_state_t *state, hk_value_t *args)
+{
+  if (hk_check_argument_int(args, 1) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  int32_t value = (int32_t) hk_as_number(args[1]);
+  threshold = value > 0 ? value : 1;
+  pending = roots.length >= threshold;
+  return hk_state_push_nil(state);
+}
+
+static int32_t set_budget_call(hk_state_t *state, hk_value_t *args)
+{
+  if (hk_check_argument_int(args, 1) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  int32_t value = (int32_t) hk_as_number(args[1]);
+  budget = value > 0 ? value : 0;
+  return hk_state_push_nil(state);
+}
+
+static int32_t stats_call(hk_state_t *state, hk_value_t *args)
+{
+  (void) args;
+  if (hk_state_push_nil(state) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_string_from_chars(state, -1, "enabled") == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_bool(state, gc_enabled) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_string_from_chars(state, -1, "threshold") == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_number(state, threshold) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_string_from_chars(state, -1, "budget") == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_number(state, budget) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_string_from_chars(state, -1, "roots") == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_number(state, roots.length) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_string_from_chars(state, -1, "collections") == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_number(state, (double) num_collections) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_string_from_chars(state, -1, "collected") == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_number(state, (double) num_collected) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  return hk_state_construct(state, 6);
+}
+
+void gc_add_root(hk_value_t val)
+{
+  if (collecting || !is_container(val))
+    return;
+  container_t *obj = as_container(val);
+  if (gc_is_buffered(obj))
+    return;
+  obj->gc_flags |= GC_BUFFERED;
+  buffer_push(&roots, val);
+  if (roots.length >= threshold)
+    pending = true;
+}
+
+void gc_poll(void)
+{
+  if (pending)
+    gc_collect(budget);
+}
+
+int32_t gc_collect(int32_t max_roots)
+{
+  int32_t end = roots.length;
+  int32_t start = max_roots > 0 && max_roots < end ? end - max_roots : 0;
+  int32_t length = start;
+  collecting = true;
+  for (int32_t i = start; i < end; ++i)
+  {
+    hk_value_t val = roots.values[i];
+    container_t *obj = as_container(val);
+    obj->gc_flags &= ~GC_BUFFERED;
+    if (!obj->ref_count)
+    {
+      hk_free(obj);
+      continue;
+    }
+    roots.values[length] = val;
+    ++length;
+  }
+  for (int32_t i = start; i < length; ++i)
+    mark_gray(roots.values[i]);
+  for (int32_t i = start; i < length; ++i)
+    scan(roots.values[i]);
+  garbage.length = 0;
+  for (int32_t i = start; i < length; ++i)
+    collect_white(roots.values[i]);
+  roots.length = start;
+  int32_t n = garbage.length;
+  for (int32_t i = 0; i < n; ++i)
+    traverse(garbage.values[i], &restore_child);
+  for (int32_t i = 0; i < n; ++i)
+    hk_incr_ref(as_container(garbage.values[i]));
+  for (int32_t i = 0; i < n; ++i)
+    clear(garbage.values[i]);
+  for (int32_t i = 0; i < n; ++i)
+    hk_value_release(garbage.values[i]);
+  collecting = false;
+  ++num_collections;
+  num_collected += n;
+  pending = roots.length >= threshold;
+  return n;
+}
+
+int32_t load_gc(hk_state_t *state)
+{
+  if (hk_state_push_string_from_chars(state, -1, "gc") == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_string_from_chars(state, -1, "enable") == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_new_native(state, "enable", 0, &enable_call) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_string_from_chars(state, -1, "disable") == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_new_native(state, "disable", 0, &disable_call) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_string_from_chars(state, -1, "is_enabled") == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_new_native(state, "is_enabled", 0, &is_enabled_call) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_string_from_chars(state, -1, "collect") == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_new_native(state, "collect", 0, &collect_call) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_string_from_chars(state, -1, "step") == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_new_native(state, "step", 0, &step_call) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_string_from_chars(state, -1, "set_threshold") == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_new_native(state, "set_threshold", 1, &set_threshold_call) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_string_from_chars(state, -1, "set_budget") == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_new_native(state, "set_budget", 1, &set_budget_call) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_string_from_chars(state, -1, "stats") == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  if (hk_state_push_new_native(state, "stats", 0, &stats_call) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  return hk_state_construct(state, 8);
+}
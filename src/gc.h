@@ -0,0 +1,35 @@
+//
+// The Hook Programming Language
+// gc.h
+//
+
+#ifndef GC_H
+#define GC_H
+
+#include <hook/state.h>
+
+#define GC_DEFAULT_THRESHOLD (1 << 12)
+#define GC_DEFAULT_BUDGET    (1 << 10)
+
+#define GC_COLOR_MASK 0x03
+#define GC_BLACK      0x00
+#define GC_GRAY       0x01
+#define GC_WHITE      0x02
+#define GC_BUFFERED   0x04
+
+#define gc_is_buffered(o) ((o)->gc_flags & GC_BUFFERED)
+
+#define gc_possible_root(v) if (gc_enabled) gc_add_root(v)
+
+#ifdef _WIN32
+  extern bool gc_enabled;
+#else
+  extern bool gc_enabled __attribute__((visibility("hidden")));
+#endif
+
+void gc_add_root(hk_value_t val);
+void gc_poll(void);
+int32_t gc_collect(int32_t budget);
+int32_t load_gc(hk_state_t *state);
+
+#endif // GC_H
@@ -4,11 +4,12 @@
 //
 
 #include <hook/iterator.h>
-#include <stdlib.h>
+#include <hook/memory.h>
 
 void hk_iterator_init(hk_iterator_t *it, void (*deinit)(struct hk_iterator *),
   bool (*is_valid)(struct hk_iterator *), hk_value_t (*get_current)(struct hk_iterator *),
-  struct hk_iterator *(*next)(struct hk_iterator *), void (*inplace_next)(struct hk_iterator *))
+  struct hk_iterator *(*next)(struct hk_iterator *), void (*inplace_next)(struct hk_iterator *),
+  void (*recycle)(struct hk_iterator *))
 {
   it->ref_count = 0;
   it->deinit = deinit;
@@ -16,13 +17,19 @@ void hk_iterator_init(hk_iterator_t *it, void (*deinit)(struct hk_iterator *),
   it->get_current = get_current;
   it->next = next;
   it->inplace_next = inplace_next;
+  it->recycle = recycle;
 }
 
 void hk_iterator_free(hk_iterator_t *it)
 {
   if (it->deinit)
     it->deinit(it);
-  free(it);
+  if (it->recycle)
+  {
+    it->recycle(it);
+    return;
+  }
+  hk_free(it);
 }
 
 void hk_iterator_release(hk_iterator_t *it)
@@ -0,0 +1,888 @@
+//
+// The Hook Programming Language
+// jit.c
+//
+
+#include "jit.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <hook/iterator.h>
+#include <hook/memory.h>
+#include <hook/status.h>
+
+#ifdef HK_NAN_BOXING
+  #error "the JIT does not support NaN-boxed values"
+#endif
+
+#define MIN_CAPACITY (1 << 10)
+
+#define RAX 0
+#define RCX 1
+#define RDX 2
+#define RBX 3
+#define RSI 6
+#define RDI 7
+#define R12 12
+#define R13 13
+#define R14 14
+#define R15 15
+
+#define STATE  RBX
+#define SLOTS  R12
+#define LOCALS R13
+#define BASE   R14
+#define TOP    R15
+
+#define CC_E  0x04
+#define CC_NE 0x05
+#define CC_BE 0x06
+#define CC_A  0x07
+
+#define VALUE_SIZE   ((int32_t) sizeof(hk_value_t))
+#define VALUE_TYPE   ((int32_t) offsetof(hk_value_t, type))
+#define VALUE_FLAGS  ((int32_t) offsetof(hk_value_t, flags))
+#define VALUE_AS     ((int32_t) offsetof(hk_value_t, as))
+#define STATE_TOP    ((int32_t) offsetof(hk_state_t, stack_top))
+#define STATE_STACK  ((int32_t) offsetof(hk_state_t, stack))
+#define STATE_FRAMES ((int32_t) offsetof(hk_state_t, frames))
+#define STATE_FTOP   ((int32_t) offsetof(hk_state_t, frames_top))
+#define FRAME_CL     ((int32_t) offsetof(hk_frame_t, cl))
+#define FRAME_PC     ((int32_t) offsetof(hk_frame_t, pc))
+#define FRAME_BASE   ((int32_t) offsetof(hk_frame_t, base))
+#define NONLOCALS    ((int32_t) offsetof(hk_closure_t, nonlocals))
+
+typedef struct
+{
+  int32_t offset;
+  int32_t target;
+} patch_t;
+
+typedef struct
+{
+  int32_t capacity;
+  int32_t length;
+  uint8_t *bytes;
+  int32_t *labels;
+  int32_t patches_capacity;
+  int32_t patches_length;
+  patch_t *patches;
+  int32_t leave;
+  int32_t finish;
+  int32_t fail;
+  int32_t resume;
+  int32_t entry;
+} jit_t;
+
+bool jit_enabled = false;
+
+static inline void jit_init(jit_t *jit, int32_t code_length);
+static inline void jit_free_buffers(jit_t *jit);
+static inline void emit_byte(jit_t *jit, int32_t byte);
+static inline void emit_dword(jit_t *jit, int32_t dword);
+static inline void emit_qword(jit_t *jit, uint64_t qword);
+static inline void emit_rex(jit_t *jit, int32_t w, int32_t reg, int32_t base);
+static inline void emit_mem(jit_t *jit, int32_t reg, int32_t base, int32_t disp);
+static inline void emit_op(jit_t *jit, int32_t w, int32_t op, int32_t reg, int32_t base, int32_t disp);
+static inline void emit_sse(jit_t *jit, int32_t prefix, int32_t op, int32_t xmm, int32_t base, int32_t disp);
+static inline void emit_reg(jit_t *jit, int32_t op, int32_t reg, int32_t rm);
+static inline void emit_shift(jit_t *jit, int32_t ext, int32_t reg, int32_t count);
+static inline void emit_move_imm(jit_t *jit, int32_t reg, uint64_t imm);
+static inline void emit_store_imm(jit_t *jit, int32_t w, int32_t base, int32_t disp, int32_t imm);
+static inline void emit_push(jit_t *jit, int32_t reg);
+static inline void emit_pop(jit_t *jit, int32_t reg);
+static inline void emit_call(jit_t *jit, void *fn);
+static inline int32_t emit_forward(jit_t *jit, int32_t cc);
+static inline void emit_backward(jit_t *jit, int32_t cc, int32_t offset);
+static inline void emit_jump(jit_t *jit, int32_t cc, int32_t target);
+static inline void resolve(jit_t *jit, int32_t offset);
+static inline void emit_sync(jit_t *jit);
+static inline void emit_reload(jit_t *jit);
+static inline void emit_frame(jit_t *jit);
+static inline void emit_exit(jit_t *jit, int32_t status);
+static inline void emit_step(jit_t *jit, uint8_t *pc, uint8_t *next);
+static inline void emit_release(jit_t *jit, int32_t base, int32_t disp);
+static inline void emit_push_value(jit_t *jit, hk_value_t val);
+static inline void emit_push_slot(jit_t *jit, int32_t base, int32_t disp);
+static inline void emit_move(jit_t *jit, int32_t disp);
+static inline void emit_store(jit_t *jit, int32_t disp);
+static inline void emit_check_numbers(jit_t *jit, int32_t *slow1, int32_t *slow2);
+static inline void emit_arithmetic(jit_t *jit, int32_t op, bool checked, uint8_t *pc,
+  uint8_t *next);
+static inline void emit_comparison(jit_t *jit, bool swap, int32_t cc, bool checked, uint8_t *pc,
+  uint8_t *next);
+static inline void emit_increment(jit_t *jit, int32_t op, int32_t base, int32_t disp,
+  bool checked, uint8_t *pc, uint8_t *next);
+static inline void emit_branch(jit_t *jit, bool if_falsey, int32_t target);
+static inline void emit_branch_or_pop(jit_t *jit, bool if_falsey, int32_t target);
+static inline void emit_prologue(jit_t *jit);
+static inline int32_t instruction_size(hk_opcode_t op);
+static inline bool compile_function(jit_t *jit, hk_function_t *fn);
+static void release_value(hk_value_t *slot);
+static bool is_valid(hk_value_t *slot);
+static bool not_equal(hk_state_t *state);
+
+static inline void jit_init(jit_t *jit, int32_t code_length)
+{
+  jit->capacity = MIN_CAPACITY;
+  jit->length = 0;
+  jit->bytes = (uint8_t *) hk_allocate(jit->capacity);
+  jit->labels = (int32_t *) hk_allocate(sizeof(*jit->labels) * (code_length + 1));
+  jit->patches_capacity = MIN_CAPACITY;
+  jit->patches_length = 0;
+  jit->patches = (patch_t *) hk_allocate(sizeof(*jit->patches) * jit->patches_capacity);
+}
+
+static inline void jit_free_buffers(jit_t *jit)
+{
+  hk_free(jit->bytes);
+  hk_free(jit->labels);
+  hk_free(jit->patches);
+}
+
+static inline void emit_byte(jit_t *jit, int32_t byte)
+{
+  if (jit->length == jit->capacity)
+  {
+    int32_t capacity = jit->capacity << 1;
+    jit->capacity = capacity;
+    jit->bytes = (uint8_t *) hk_reallocate(jit->bytes, capacity);
+  }
+  jit->bytes[jit->length++] = (uint8_t) byte;
+}
+
+static inline void emit_dword(jit_t *jit, int32_t dword)
+{
+  uint32_t bits = (uint32_t) dword;
+  for (int32_t i = 0; i < 4; ++i, bits >>= 8)
+    emit_byte(jit, bits & 0xff);
+}
+
+static inline void emit_qword(jit_t *jit, uint64_t qword)
+{
+  for (int32_t i = 0; i < 8; ++i, qword >>= 8)
+    emit_byte(jit, qword & 0xff);
+}
+
+static inline void emit_rex(jit_t *jit, int32_t w, int32_t reg, int32_t base)
+{
+  int32_t rex = (w << 3) | ((reg >> 3) << 2) | (base >> 3);
+  if (rex)
+    emit_byte(jit, 0x40 | rex);
+}
+
+static inline void emit_mem(jit_t *jit, int32_t reg, int32_t base, int32_t disp)
+{
+  emit_byte(jit, 0x80 | ((reg & 7) << 3) | (base & 7));
+  if ((base & 7) == 4)
+    emit_byte(jit, 0x24);
+  emit_dword(jit, disp);
+}
+
+static inline void emit_op(jit_t *jit, int32_t w, int32_t op, int32_t reg, int32_t base, int32_t disp)
+{
+  emit_rex(jit, w, reg, base);
+  emit_byte(jit, op);
+  emit_mem(jit, reg, base, disp);
+}
+
+static inline void emit_sse(jit_t *jit, int32_t prefix, int32_t op, int32_t xmm, int32_t base, int32_t disp)
+{
+  emit_byte(jit, prefix);
+  emit_rex(jit, 0, xmm, base);
+  emit_byte(jit, 0x0f);
+  emit_byte(jit, op);
+  emit_mem(jit, xmm, base, disp);
+}
+
+static inline void emit_reg(jit_t *jit, int32_t op, int32_t reg, int32_t rm)
+{
+  emit_rex(jit, 1, reg, rm);
+  emit_byte(jit, op);
+  emit_byte(jit, 0xc0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+static inline void emit_shift(jit_t *jit, int32_t ext, int32_t reg, int32_t count)
+{
+  emit_rex(jit, 1, 0, reg);
+  emit_byte(jit, 0xc1);
+  emit_byte(jit, 0xc0 | (ext << 3) | (reg & 7));
+  emit_byte(jit, count);
+}
+
+static inline void emit_move_imm(jit_t *jit, int32_t reg, uint64_t imm)
+{
+  emit_rex(jit, 1, 0, reg);
+  emit_byte(jit, 0xb8 | (reg & 7));
+  emit_qword(jit, imm);
+}
+
+static inline void emit_store_imm(jit_t *jit, int32_t w, int32_t base, int32_t disp, int32_t imm)
+{
+  emit_op(jit, w, 0xc7, 0, base, disp);
+  emit_dword(jit, imm);
+}
+
+static inline void emit_push(jit_t *jit, int32_t reg)
+{
+  emit_rex(jit, 0, 0, reg);
+  emit_byte(jit, 0x50 | (reg & 7));
+}
+
+static inline void emit_pop(jit_t *jit, int32_t reg)
+{
+  emit_rex(jit, 0, 0, reg);
+  emit_byte(jit, 0x58 | (reg & 7));
+}
+
+static inline void emit_call(jit_t *jit, void *fn)
+{
+  emit_move_imm(jit, RAX, (uint64_t) (uintptr_t) fn);
+  emit_byte(jit, 0xff);
+  emit_byte(jit, 0xd0);
+}
+
+static inline int32_t emit_forward(jit_t *jit, int32_t cc)
+{
+  if (cc == -1)
+    emit_byte(jit, 0xe9);
+  else
+  {
+    emit_byte(jit, 0x0f);
+    emit_byte(jit, 0x80 | cc);
+  }
+  int32_t offset = jit->length;
+  emit_dword(jit, 0);
+  return offset;
+}
+
+static inline void emit_backward(jit_t *jit, int32_t cc, int32_t offset)
+{
+  int32_t from = emit_forward(jit, cc);
+  int32_t rel = offset - (from + 4);
+  memcpy(&jit->bytes[from], &rel, sizeof(rel));
+}
+
+static inline void emit_jump(jit_t *jit, int32_t cc, int32_t target)
+{
+  if (jit->patches_length == jit->patches_capacity)
+  {
+    int32_t capacity = jit->patches_capacity << 1;
+    jit->patches_capacity = capacity;
+    jit->patches = (patch_t *) hk_reallocate(jit->patches, sizeof(*jit->patches) * capacity);
+  }
+  patch_t *patch = &jit->patches[jit->patches_length++];
+  patch->offset = emit_forward(jit, cc);
+  patch->target = target;
+}
+
+static inline void resolve(jit_t *jit, int32_t offset)
+{
+  int32_t rel = jit->length - (offset + 4);
+  memcpy(&jit->bytes[offset], &rel, sizeof(rel));
+}
+
+static inline void emit_sync(jit_t *jit)
+{
+  emit_reg(jit, 0x89, TOP, RAX);
+  emit_reg(jit, 0x29, SLOTS, RAX);
+  emit_shift(jit, 7, RAX, 4);
+  emit_op(jit, 0, 0x89, RAX, STATE, STATE_TOP);
+}
+
+static inline void emit_reload(jit_t *jit)
+{
+  emit_op(jit, 1, 0x8b, SLOTS, STATE, STATE_STACK);
+  emit_op(jit, 1, 0x63, TOP, STATE, STATE_TOP);
+  emit_shift(jit, 4, TOP, 4);
+  emit_reg(jit, 0x01, SLOTS, TOP);
+  emit_reg(jit, 0x89, SLOTS, LOCALS);
+  emit_reg(jit, 0x01, BASE, LOCALS);
+}
+
+static inline void emit_frame(jit_t *jit)
+{
+  emit_op(jit, 1, 0x8b, RCX, STATE, STATE_FRAMES);
+  emit_op(jit, 1, 0x63, RDX, STATE, STATE_FTOP);
+  emit_reg(jit, 0x69, RDX, RDX);
+  emit_dword(jit, (int32_t) sizeof(hk_frame_t));
+  emit_reg(jit, 0x01, RDX, RCX);
+}
+
+static inline void emit_exit(jit_t *jit, int32_t status)
+{
+  emit_frame(jit);
+  emit_op(jit, 1, 0x89, RAX, RCX, FRAME_PC);
+  emit_byte(jit, 0xb8);
+  emit_dword(jit, status);
+  emit_backward(jit, -1, jit->leave);
+}
+
+static inline void emit_step(jit_t *jit, uint8_t *pc, uint8_t *next)
+{
+  emit_sync(jit);
+  emit_reg(jit, 0x89, STATE, RDI);
+  emit_move_imm(jit, RSI, (uint64_t) (uintptr_t) pc);
+  emit_call(jit, (void *) (uintptr_t) &jit_step);
+  emit_byte(jit, 0x85);
+  emit_byte(jit, 0xc0);
+  int32_t ok = emit_forward(jit, CC_E);
+  emit_move_imm(jit, RAX, (uint64_t) (uintptr_t) next);
+  emit_backward(jit, -1, jit->fail);
+  resolve(jit, ok);
+  emit_reload(jit);
+}
+
+static inline void emit_release(jit_t *jit, int32_t base, int32_t disp)
+{
+  emit_op(jit, 0, 0xf6, 0, base, disp + VALUE_FLAGS);
+  emit_byte(jit, HK_FLAG_OBJECT);
+  int32_t skip = emit_forward(jit, CC_E);
+  emit_op(jit, 1, 0x8d, RDI, base, disp);
+  emit_call(jit, (void *) (uintptr_t) &release_value);
+  resolve(jit, skip);
+}
+
+static inline void emit_push_value(jit_t *jit, hk_value_t val)
+{
+  uint64_t bits;
+  memcpy(&bits, &val.as, sizeof(bits));
+  emit_op(jit, 1, 0x8d, TOP, TOP, VALUE_SIZE);
+  emit_store_imm(jit, 0, TOP, VALUE_TYPE, val.type);
+  emit_store_imm(jit, 0, TOP, VALUE_FLAGS, val.flags);
+  emit_move_imm(jit, RAX, bits);
+  emit_op(jit, 1, 0x89, RAX, TOP, VALUE_AS);
+  if (!hk_is_object(val))
+    return;
+  emit_move_imm(jit, RAX, (uint64_t) (uintptr_t) hk_as_object(val));
+  emit_op(jit, 0, 0xff, 0, RAX, 0);
+}
+
+static inline void emit_push_slot(jit_t *jit, int32_t base, int32_t disp)
+{
+  emit_sse(jit, 0xf3, 0x6f, 0, base, disp);
+  emit_op(jit, 1, 0x8d, TOP, TOP, VALUE_SIZE);
+  emit_sse(jit, 0xf3, 0x7f, 0, TOP, 0);
+  emit_op(jit, 0, 0xf6, 0, base, disp + VALUE_FLAGS);
+  emit_byte(jit, HK_FLAG_OBJECT);
+  int32_t skip = emit_forward(jit, CC_E);
+  emit_op(jit, 1, 0x8b, RAX, base, disp + VALUE_AS);
+  emit_op(jit, 0, 0xff, 0, RAX, 0);
+  resolve(jit, skip);
+}
+
+static inline void emit_move(jit_t *jit, int32_t disp)
+{
+  hk_value_t nil = HK_NIL_VALUE;
+  emit_sse(jit, 0xf3, 0x6f, 0, LOCALS, disp);
+  emit_op(jit, 1, 0x8d, TOP, TOP, VALUE_SIZE);
+  emit_sse(jit, 0xf3, 0x7f, 0, TOP, 0);
+  emit_store_imm(jit, 0, LOCALS, disp + VALUE_TYPE, nil.type);
+  emit_store_imm(jit, 0, LOCALS, disp + VALUE_FLAGS, nil.flags);
+}
+
+static inline void emit_store(jit_t *jit, int32_t disp)
+{
+  emit_release(jit, LOCALS, disp);
+  emit_sse(jit, 0xf3, 0x6f, 0, TOP, 0);
+  emit_sse(jit, 0xf3, 0x7f, 0, LOCALS, disp);
+  emit_op(jit, 1, 0x8d, TOP, TOP, -VALUE_SIZE);
+}
+
+static inline void emit_check_numbers(jit_t *jit, int32_t *slow1, int32_t *slow2)
+{
+  emit_op(jit, 0, 0x83, 7, TOP, VALUE_TYPE - VALUE_SIZE);
+  emit_byte(jit, HK_TYPE_NUMBER);
+  *slow1 = emit_forward(jit, CC_NE);
+  emit_op(jit, 0, 0x83, 7, TOP, VALUE_TYPE);
+  emit_byte(jit, HK_TYPE_NUMBER);
+  *slow2 = emit_forward(jit, CC_NE);
+}
+
+static inline void emit_arithmetic(jit_t *jit, int32_t op, bool checked, uint8_t *pc,
+  uint8_t *next)
+{
+  int32_t slow1;
+  int32_t slow2;
+  if (checked)
+    emit_check_numbers(jit, &slow1, &slow2);
+  emit_sse(jit, 0xf2, 0x10, 0, TOP, VALUE_AS - VALUE_SIZE);
+  emit_sse(jit, 0xf2, op, 0, TOP, VALUE_AS);
+  emit_op(jit, 1, 0x8d, TOP, TOP, -VALUE_SIZE);
+  emit_sse(jit, 0xf2, 0x11, 0, TOP, VALUE_AS);
+  if (!checked)
+    return;
+  int32_t done = emit_forward(jit, -1);
+  resolve(jit, slow1);
+  resolve(jit, slow2);
+  emit_step(jit, pc, next);
+  resolve(jit, done);
+}
+
+static inline void emit_comparison(jit_t *jit, bool swap, int32_t cc, bool checked, uint8_t *pc,
+  uint8_t *next)
+{
+  int32_t slow1;
+  int32_t slow2;
+  if (checked)
+    emit_check_numbers(jit, &slow1, &slow2);
+  int32_t disp1 = VALUE_AS - VALUE_SIZE;
+  int32_t disp2 = VALUE_AS;
+  emit_sse(jit, 0xf2, 0x10, 0, TOP, swap ? disp2 : disp1);
+  emit_sse(jit, 0x66, 0x2e, 0, TOP, swap ? disp1 : disp2);
+  emit_byte(jit, 0x0f);
+  emit_byte(jit, 0x90 | cc);
+  emit_byte(jit, 0xc0);
+  emit_byte(jit, 0x0f);
+  emit_byte(jit, 0xb6);
+  emit_byte(jit, 0xc0);
+  emit_op(jit, 1, 0x8d, TOP, TOP, -VALUE_SIZE);
+  emit_store_imm(jit, 0, TOP, VALUE_TYPE, HK_TYPE_BOOL);
+  emit_byte(jit, 0xb9);
+  emit_dword(jit, hk_flags(HK_FALSE_VALUE));
+  emit_byte(jit, 0xba);
+  emit_dword(jit, hk_flags(HK_TRUE_VALUE));
+  emit_byte(jit, 0x85);
+  emit_byte(jit, 0xc0);
+  emit_byte(jit, 0x0f);
+  emit_byte(jit, 0x45);
+  emit_byte(jit, 0xca);
+  emit_op(jit, 0, 0x89, RCX, TOP, VALUE_FLAGS);
+  emit_op(jit, 1, 0x89, RAX, TOP, VALUE_AS);
+  if (!checked)
+    return;
+  int32_t done = emit_forward(jit, -1);
+  resolve(jit, slow1);
+  resolve(jit, slow2);
+  emit_step(jit, pc, next);
+  resolve(jit, done);
+}
+
+static inline void emit_increment(jit_t *jit, int32_t op, int32_t base, int32_t disp,
+  bool checked, uint8_t *pc, uint8_t *next)
+{
+  double one = 1;
+  uint64_t bits;
+  memcpy(&bits, &one, sizeof(bits));
+  int32_t slow;
+  if (checked)
+  {
+    emit_op(jit, 0, 0x83, 7, base, disp + VALUE_TYPE);
+    emit_byte(jit, HK_TYPE_NUMBER);
+    slow = emit_forward(jit, CC_NE);
+  }
+  emit_move_imm(jit, RAX, bits);
+  emit_byte(jit, 0x66);
+  emit_byte(jit, 0x48);
+  emit_byte(jit, 0x0f);
+  emit_byte(jit, 0x6e);
+  emit_byte(jit, 0xc8);
+  emit_sse(jit, 0xf2, 0x10, 0, base, disp + VALUE_AS);
+  emit_byte(jit, 0xf2);
+  emit_byte(jit, 0x0f);
+  emit_byte(jit, op);
+  emit_byte(jit, 0xc1);
+  emit_sse(jit, 0xf2, 0x11, 0, base, disp + VALUE_AS);
+  if (!checked)
+    return;
+  int32_t done = emit_forward(jit, -1);
+  resolve(jit, slow);
+  emit_step(jit, pc, next);
+  resolve(jit, done);
+}
+
+static inline void emit_branch(jit_t *jit, bool if_falsey, int32_t target)
+{
+  emit_release(jit, TOP, 0);
+  emit_op(jit, 0, 0xf6, 0, TOP, VALUE_FLAGS);
+  emit_byte(jit, HK_FLAG_FALSEY);
+  emit_op(jit, 1, 0x8d, TOP, TOP, -VALUE_SIZE);
+  emit_jump(jit, if_falsey ? CC_NE : CC_E, target);
+}
+
+static inline void emit_branch_or_pop(jit_t *jit, bool if_falsey, int32_t target)
+{
+  emit_op(jit, 0, 0xf6, 0, TOP, VALUE_FLAGS);
+  emit_byte(jit, HK_FLAG_FALSEY);
+  emit_jump(jit, if_falsey ? CC_NE : CC_E, target);
+  emit_release(jit, TOP, 0);
+  emit_op(jit, 1, 0x8d, TOP, TOP, -VALUE_SIZE);
+}
+
+static inline void emit_prologue(jit_t *jit)
+{
+  jit->leave = jit->length;
+  emit_byte(jit, 0x48);
+  emit_byte(jit, 0x83);
+  emit_byte(jit, 0xc4);
+  emit_byte(jit, 0x10);
+  emit_pop(jit, R15);
+  emit_pop(jit, R14);
+  emit_pop(jit, R13);
+  emit_pop(jit, R12);
+  emit_pop(jit, RBX);
+  emit_byte(jit, 0xc3);
+  jit->finish = jit->length;
+  emit_sync(jit);
+  emit_byte(jit, 0x31);
+  emit_byte(jit, 0xc0);
+  emit_backward(jit, -1, jit->leave);
+  jit->fail = jit->length;
+  emit_exit(jit, HK_STATUS_ERROR);
+  jit->resume = jit->length;
+  emit_exit(jit, JIT_STATUS_RESUME);
+  jit->entry = jit->length;
+  emit_push(jit, RBX);
+  emit_push(jit, R12);
+  emit_push(jit, R13);
+  emit_push(jit, R14);
+  emit_push(jit, R15);
+  emit_byte(jit, 0x48);
+  emit_byte(jit, 0x83);
+  emit_byte(jit, 0xec);
+  emit_byte(jit, 0x10);
+  emit_reg(jit, 0x89, RDI, STATE);
+  emit_frame(jit);
+  emit_op(jit, 1, 0x63, BASE, RCX, FRAME_BASE);
+  emit_op(jit, 1, 0x8b, RCX, RCX, FRAME_CL);
+  emit_byte(jit, 0x48);
+  emit_byte(jit, 0x89);
+  emit_byte(jit, 0x0c);
+  emit_byte(jit, 0x24);
+  emit_shift(jit, 4, BASE, 4);
+  emit_reload(jit);
+}
+
+static inline int32_t instruction_size(hk_opcode_t op)
+{
+  switch (op)
+  {
+  case HK_OP_INT:
+  case HK_OP_LOAD_LOAD:
+  case HK_OP_JUMP:
+  case HK_OP_JUMP_IF_FALSE:
+  case HK_OP_JUMP_IF_TRUE:
+  case HK_OP_JUMP_IF_TRUE_OR_POP:
+  case HK_OP_JUMP_IF_FALSE_OR_POP:
+  case HK_OP_JUMP_IF_NOT_EQUAL:
+  case HK_OP_JUMP_IF_NOT_VALID:
+  case HK_OP_JUMP_IF_NOT_LESS:
+  case HK_OP_RANGE_STEP:
+  case HK_OP_LOAD_ELEMENT:
+  case HK_OP_NONLOCAL_ELEMENT:
+    return 3;
+  case HK_OP_CONSTANT:
+  case HK_OP_ARRAY:
+  case HK_OP_STRUCT:
+  case HK_OP_INSTANCE:
+  case HK_OP_CONSTRUCT:
+  case HK_OP_CLOSURE:
+  case HK_OP_UNPACK_ARRAY:
+  case HK_OP_UNPACK_STRUCT:
+  case HK_OP_GLOBAL:
+  case HK_OP_NONLOCAL:
+  case HK_OP_LOAD:
+  case HK_OP_MOVE:
+  case HK_OP_STORE:
+  case HK_OP_CALL:
+  case HK_OP_TAIL_CALL:
+  case HK_OP_INCREMENT_LOCAL:
+  case HK_OP_DECREMENT_LOCAL:
+  case HK_OP_INCREMENT_NUM:
+  case HK_OP_DECREMENT_NUM:
+    return 2;
+  case HK_OP_GET_FIELD:
+  case HK_OP_FETCH_FIELD:
+  case HK_OP_PUT_FIELD:
+  case HK_OP_INPLACE_PUT_FIELD:
+    return 4;
+  case HK_OP_LOAD_FIELD:
+  case HK_OP_NONLOCAL_FIELD:
+    return 5;
+  default:
+    break;
+  }
+  return 1;
+}
+
+static inline bool compile_function(jit_t *jit, hk_function_t *fn)
+{
+  uint8_t *code = fn->chunk.code;
+  int32_t code_length = fn->chunk.code_length;
+  hk_value_t *consts = fn->chunk.consts->elements;
+  emit_prologue(jit);
+  int32_t offset = 0;
+  while (offset < code_length)
+  {
+    jit->labels[offset] = jit->length;
+    uint8_t *pc = &code[offset];
+    hk_opcode_t op = (hk_opcode_t) pc[0];
+    int32_t size = op == HK_OP_WIDE ? instruction_size((hk_opcode_t) pc[1]) + 2
+      : instruction_size(op);
+    uint8_t *next = &pc[size];
+    int32_t byte = size > 1 ? pc[1] : 0;
+    int32_t word = size == 3 ? *((uint16_t *) &pc[1]) : 0;
+    switch (op)
+    {
+    case HK_OP_NIL:
+      emit_push_value(jit, HK_NIL_VALUE);
+      break;
+    case HK_OP_FALSE:
+      emit_push_value(jit, HK_FALSE_VALUE);
+      break;
+    case HK_OP_TRUE:
+      emit_push_value(jit, HK_TRUE_VALUE);
+      break;
+    case HK_OP_INT:
+      emit_push_value(jit, hk_number_value(word));
+      break;
+    case HK_OP_CONSTANT:
+      emit_push_value(jit, consts[byte]);
+      break;
+    case HK_OP_POP:
+      emit_release(jit, TOP, 0);
+      emit_op(jit, 1, 0x8d, TOP, TOP, -VALUE_SIZE);
+      break;
+    case HK_OP_GLOBAL:
+      emit_push_slot(jit, SLOTS, byte * VALUE_SIZE);
+      break;
+    case HK_OP_NONLOCAL:
+      emit_byte(jit, 0x48);
+      emit_byte(jit, 0x8b);
+      emit_byte(jit, 0x0c);
+      emit_byte(jit, 0x24);
+      emit_push_slot(jit, RCX, NONLOCALS + byte * VALUE_SIZE);
+      break;
+    case HK_OP_LOAD:
+      emit_push_slot(jit, LOCALS, byte * VALUE_SIZE);
+      break;
+    case HK_OP_MOVE:
+      emit_move(jit, byte * VALUE_SIZE);
+      break;
+    case HK_OP_LOAD_LOAD:
+      emit_push_slot(jit, LOCALS, byte * VALUE_SIZE);
+      emit_push_slot(jit, LOCALS, pc[2] * VALUE_SIZE);
+      break;
+    case HK_OP_STORE:
+      emit_store(jit, byte * VALUE_SIZE);
+      break;
+    case HK_OP_JUMP:
+      emit_jump(jit, -1, word);
+      break;
+    case HK_OP_JUMP_IF_FALSE:
+      emit_branch(jit, true, word);
+      break;
+    case HK_OP_JUMP_IF_TRUE:
+      emit_branch(jit, false, word);
+      break;
+    case HK_OP_JUMP_IF_TRUE_OR_POP:
+      emit_branch_or_pop(jit, false, word);
+      break;
+    case HK_OP_JUMP_IF_FALSE_OR_POP:
+      emit_branch_or_pop(jit, true, word);
+      break;
+    case HK_OP_JUMP_IF_NOT_EQUAL:
+      emit_sync(jit);
+      emit_reg(jit, 0x89, STATE, RDI);
+      emit_call(jit, (void *) (uintptr_t) &not_equal);
+      emit_reload(jit);
+      emit_byte(jit, 0x84);
+      emit_byte(jit, 0xc0);
+      emit_jump(jit, CC_NE, word);
+      break;
+    case HK_OP_JUMP_IF_NOT_VALID:
+      emit_reg(jit, 0x89, TOP, RDI);
+      emit_call(jit, (void *) (uintptr_t) &is_valid);
+      emit_byte(jit, 0x84);
+      emit_byte(jit, 0xc0);
+      emit_jump(jit, CC_E, word);
+      break;
+    case HK_OP_JUMP_IF_NOT_LESS:
+      {
+        int32_t slow1;
+        int32_t slow2;
+        emit_check_numbers(jit, &slow1, &slow2);
+        emit_sse(jit, 0xf2, 0x10, 0, TOP, VALUE_AS);
+        emit_sse(jit, 0x66, 0x2e, 0, TOP, VALUE_AS - VALUE_SIZE);
+        emit_op(jit, 1, 0x8d, TOP, TOP, -(VALUE_SIZE << 1));
+        emit_jump(jit, CC_BE, word);
+        int32_t done = emit_forward(jit, -1);
+        resolve(jit, slow1);
+        resolve(jit, slow2);
+        emit_step(jit, pc, next);
+        emit_branch(jit, true, word);
+        resolve(jit, done);
+      }
+      break;
+    case HK_OP_RANGE_STEP:
+      emit_sse(jit, 0xf2, 0x10, 0, TOP, VALUE_AS - (VALUE_SIZE << 1));
+      emit_sse(jit, 0xf2, 0x58, 0, TOP, VALUE_AS);
+      emit_sse(jit, 0xf2, 0x11, 0, TOP, VALUE_AS - (VALUE_SIZE << 1));
+      emit_sse(jit, 0xf2, 0x59, 0, TOP, VALUE_AS);
+      emit_sse(jit, 0xf2, 0x10, 1, TOP, VALUE_AS - VALUE_SIZE);
+      emit_sse(jit, 0xf2, 0x59, 1, TOP, VALUE_AS);
+      emit_byte(jit, 0x66);
+      emit_byte(jit, 0x0f);
+      emit_byte(jit, 0x2e);
+      emit_byte(jit, 0xc1);
+      emit_jump(jit, CC_A, word);
+      break;
+    case HK_OP_GREATER:
+    case HK_OP_GREATER_NUM:
+    case HK_OP_GREATER_UNCHECKED:
+      emit_comparison(jit, false, CC_A, op != HK_OP_GREATER_UNCHECKED, pc, next);
+      break;
+    case HK_OP_LESS:
+    case HK_OP_LESS_NUM:
+    case HK_OP_LESS_UNCHECKED:
+      emit_comparison(jit, true, CC_A, op != HK_OP_LESS_UNCHECKED, pc, next);
+      break;
+    case HK_OP_NOT_GREATER:
+    case HK_OP_NOT_GREATER_NUM:
+    case HK_OP_NOT_GREATER_UNCHECKED:
+      emit_comparison(jit, false, CC_BE, op != HK_OP_NOT_GREATER_UNCHECKED, pc, next);
+      break;
+    case HK_OP_NOT_LESS:
+    case HK_OP_NOT_LESS_NUM:
+    case HK_OP_NOT_LESS_UNCHECKED:
+      emit_comparison(jit, true, CC_BE, op != HK_OP_NOT_LESS_UNCHECKED, pc, next);
+      break;
+    case HK_OP_ADD:
+    case HK_OP_ADD_NUM:
+    case HK_OP_ADD_UNCHECKED:
+      emit_arithmetic(jit, 0x58, op != HK_OP_ADD_UNCHECKED, pc, next);
+      break;
+    case HK_OP_SUBTRACT:
+    case HK_OP_SUBTRACT_NUM:
+    case HK_OP_SUBTRACT_UNCHECKED:
+      emit_arithmetic(jit, 0x5c, op != HK_OP_SUBTRACT_UNCHECKED, pc, next);
+      break;
+    case HK_OP_MULTIPLY:
+    case HK_OP_MULTIPLY_NUM:
+    case HK_OP_MULTIPLY_UNCHECKED:
+      emit_arithmetic(jit, 0x59, op != HK_OP_MULTIPLY_UNCHECKED, pc, next);
+      break;
+    case HK_OP_DIVIDE:
+    case HK_OP_DIVIDE_NUM:
+    case HK_OP_DIVIDE_UNCHECKED:
+      emit_arithmetic(jit, 0x5e, op != HK_OP_DIVIDE_UNCHECKED, pc, next);
+      break;
+    case HK_OP_INCREMENT:
+      emit_increment(jit, 0x58, TOP, 0, true, pc, next);
+      break;
+    case HK_OP_DECREMENT:
+      emit_increment(jit, 0x5c, TOP, 0, true, pc, next);
+      break;
+    case HK_OP_INCREMENT_LOCAL:
+    case HK_OP_INCREMENT_NUM:
+      emit_increment(jit, 0x58, LOCALS, byte * VALUE_SIZE, op == HK_OP_INCREMENT_LOCAL, pc, next);
+      break;
+    case HK_OP_DECREMENT_LOCAL:
+    case HK_OP_DECREMENT_NUM:
+      emit_increment(jit, 0x5c, LOCALS, byte * VALUE_SIZE, op == HK_OP_DECREMENT_LOCAL, pc, next);
+      break;
+    case HK_OP_TAIL_CALL:
+      emit_sync(jit);
+      emit_move_imm(jit, RAX, (uint64_t) (uintptr_t) pc);
+      emit_backward(jit, -1, jit->resume);
+      break;
+    case HK_OP_RETURN:
+      emit_backward(jit, -1, jit->finish);
+      break;
+    case HK_OP_RETURN_NIL:
+      emit_push_value(jit, HK_NIL_VALUE);
+      emit_backward(jit, -1, jit->finish);
+      break;
+    default:
+      emit_step(jit, pc, next);
+      break;
+    }
+    offset += size;
+  }
+  if (offset != code_length)
+    return false;
+  for (int32_t i = 0; i < jit->patches_length; ++i)
+  {
+    patch_t *patch = &jit->patches[i];
+    if (patch->target >= code_length)
+      return false;
+    int32_t rel = jit->labels[patch->target] - (patch->offset + 4);
+    memcpy(&jit->bytes[patch->offset], &rel, sizeof(rel));
+  }
+  return true;
+}
+
+static void release_value(hk_value_t *slot)
+{
+  hk_value_release(*slot);
+}
+
+static bool is_valid(hk_value_t *slot)
+{
+  return hk_iterator_is_valid(hk_as_iterator(*slot));
+}
+
+static bool not_equal(hk_state_t *state)
+{
+  hk_value_t *slots = state->stack;
+  hk_value_t val1 = slots[state->stack_top - 1];
+  hk_value_t val2 = slots[state->stack_top];
+  if (hk_value_equal(val1, val2))
+  {
+    hk_value_release(val1);
+    hk_value_release(val2);
+    state->stack_top -= 2;
+    return false;
+  }
+  hk_value_release(val2);
+  --state->stack_top;
+  return true;
+}
+
+bool jit_compile(hk_function_t *fn)
+{
+  jit_t jit;
+  jit_init(&jit, fn->chunk.code_length);
+  if (!compile_function(&jit, fn))
+  {
+    jit_free_buffers(&jit);
+    return false;
+  }
+  size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+  size_t size = (sizeof(size_t) + jit.length + page_size - 1) & ~(page_size - 1);
+  uint8_t *block = (uint8_t *) mmap(NULL, size, PROT_READ | PROT_WRITE,
+    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (block == MAP_FAILED)
+  {
+    jit_free_buffers(&jit);
+    return false;
+  }
+  memcpy(block, &size, sizeof(size));
+  uint8_t *entry = &block[sizeof(size)];
+  memcpy(entry, jit.bytes, jit.length);
+  int32_t start = jit.entry;
+  jit_free_buffers(&jit);
+  if (mprotect(block, size, PROT_READ | PROT_EXEC))
+  {
+    munmap(block, size);
+    return false;
+  }
+  entry += start;
+  memcpy(&fn->jit_code, &entry, sizeof(entry));
+  return true;
+}
+
+void jit_free(hk_function_t *fn)
+{
+  if (!fn->jit_code)
+    return;
+  uint8_t *entry;
+  memcpy(&entry, &fn->jit_code, sizeof(entry));
+  size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+  uint8_t *block = (uint8_t *) ((uintptr_t) entry & ~(uintptr_t) (page_size - 1));
+  size_t size;
+  memcpy(&size, block, sizeof(size));
+  munmap(block, size);
+}
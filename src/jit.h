@@ -0,0 +1,22 @@
+//
+// The Hook Programming Language
+// jit.h
+//
+
+#ifndef JIT_H
+#define JIT_H
+
+#include <hook/state.h>
+
+#define JIT_CALL_THRESHOLD (1 << 6)
+#define JIT_MAX_DEPTH      (1 << 10)
+
+#define JIT_STATUS_RESUME 0x03
+
+extern bool jit_enabled __attribute__((visibility("hidden")));
+
+bool jit_compile(hk_function_t *fn);
+void jit_free(hk_function_t *fn);
+int32_t jit_step(hk_state_t *state, uint8_t *pc);
+
+#endif // JIT_H
@@ -13,6 +13,10 @@
 #include <hook/utils.h>
 #include "version.h"
 
+#ifdef HK_JIT
+  #include "jit.h"
+#endif
+
 typedef struct
 {
   const char *cmd;
@@ -22,6 +26,10 @@ typedef struct
   bool opt_dump;
   bool opt_compile;
   bool opt_run;
+  bool opt_jit;
+  bool opt_stats;
+  bool opt_optimize;
+  bool opt_inline;
   int32_t stack_size; 
   const char *input;
   const char *output;
@@ -41,6 +49,7 @@ static inline hk_closure_t *load_bytecode_from_file(const char *filename);
 static inline hk_closure_t *load_bytecode_from_stream(FILE *stream);
 static inline void save_bytecode_to_file(hk_closure_t *cl, const char *filename);
 static inline void dump_bytecode_to_file(hk_function_t *fn, const char *filename);
+static inline void print_stats(hk_state_t *state);
 static inline int32_t run_bytecode(hk_closure_t *cl, parsed_args_t *parsed_args);
 
 static inline void parse_args(parsed_args_t *parsed_args, int32_t argc, const char **argv)
@@ -52,6 +61,10 @@ static inline void parse_args(parsed_args_t *parsed_args, int32_t argc, const ch
   parsed_args->opt_dump = false;
   parsed_args->opt_compile = false;
   parsed_args->opt_run = false;
+  parsed_args->opt_jit = false;
+  parsed_args->opt_stats = false;
+  parsed_args->opt_optimize = false;
+  parsed_args->opt_inline = false;
   parsed_args->stack_size = 0;
   parsed_args->input = NULL;
   parsed_args->output = NULL;
@@ -106,7 +119,28 @@ static inline void parse_option(parsed_args_t *parsed_args, const char *arg)
     parsed_args->opt_run = true;
     return;
   }
-  const char *opt_val = option(arg, "-s");
+  if (option(arg, "--jit"))
+  {
+    parsed_args->opt_jit = true;
+    return;
+  }
+  if (option(arg, "--stats"))
+  {
+    parsed_args->opt_stats = true;
+    return;
+  }
+  if (option(arg, "--inline"))
+  {
+    parsed_args->opt_inline = true;
+    return;
+  }
+  const char *opt_val = option(arg, "-O");
+  if (opt_val)
+  {
+    parsed_args->opt_optimize = strcmp(opt_val, "0") != 0;
+    return;
+  }
+  opt_val = option(arg, "-s");
   if (opt_val)
   {
     parsed_args->stack_size = atoi(opt_val);
@@ -151,7 +185,11 @@ static inline void print_help(const char *cmd)
     "  -d, --dump     shows the bytecode\n"
     "  -c, --compile  compiles source code\n"
     "  -r, --run      runs directly from bytecode\n"
-    "  -s=<size>      sets the stack size\n"
+    "      --jit      compiles hot functions to machine code\n"
+    "      --stats    prints runtime counters on exit\n"
+    "      --inline   inlines calls to small functions\n"
+    "  -O, -O0        enables or disables compile-time optimizations\n"
+    "  -s=<size>      sets the maximum stack size\n"
     "\n",
   cmd);
 }
@@ -212,19 +250,30 @@ static inline void dump_bytecode_to_file(hk_function_t *fn, const char *filename
   fclose(stream);
 }
 
+static inline void print_stats(hk_state_t *state)
+{
+  fprintf(stderr, "iterator next (in place): %lld\n", (long long) state->num_inplace_next);
+  fprintf(stderr, "iterator next (copying):  %lld\n", (long long) state->num_copying_next);
+}
+
 static inline int32_t run_bytecode(hk_closure_t *cl, parsed_args_t *parsed_args)
 {
   hk_state_t state;
-  hk_state_init(&state, parsed_args->stack_size);
+  hk_state_init(&state, 0);
+  if (parsed_args->stack_size > 0)
+    hk_state_set_stack_limit(&state, parsed_args->stack_size);
   hk_state_push_closure(&state, cl);
   hk_state_push_array(&state, args_array(parsed_args));
-  if (hk_state_call(&state, 1) == HK_STATUS_ERROR)
+  int32_t status = hk_state_call(&state, 1);
+  if (parsed_args->opt_stats)
+    print_stats(&state);
+  if (status == HK_STATUS_ERROR)
   {
     hk_state_free(&state);
     return EXIT_FAILURE;
   }
   hk_value_t result = state.stack[state.stack_top];
-  int32_t status = hk_is_int(result) ? (int32_t) hk_as_number(result) : 0;
+  status = hk_is_int(result) ? (int32_t) hk_as_number(result) : 0;
   --state.stack_top;
   hk_state_free(&state);
   return status;
@@ -244,6 +293,17 @@ int32_t main(int32_t argc, const char **argv)
     print_version();
     return EXIT_SUCCESS;
   }
+  if (parsed_args.opt_jit)
+  {
+#ifdef HK_JIT
+    jit_enabled = true;
+#else
+    hk_fatal_error("JIT support is not available in this build");
+#endif
+  }
+  int32_t flags = parsed_args.opt_optimize ? HK_COMPILER_FLAG_OPTIMIZE : HK_COMPILER_FLAG_NONE;
+  if (parsed_args.opt_inline)
+    flags |= HK_COMPILER_FLAG_INLINE;
   const char *input = parsed_args.input;
   if (parsed_args.opt_eval)
   {
@@ -251,7 +311,7 @@ int32_t main(int32_t argc, const char **argv)
       hk_fatal_error("no input string");
     hk_string_t *file = hk_string_from_chars(-1, "<terminal>");
     hk_string_t *source = hk_string_from_chars(-1, input);
-    hk_closure_t *cl = hk_compile(file, source);
+    hk_closure_t *cl = hk_compile(file, source, flags);
     return run_bytecode(cl, &parsed_args);
   }
   if (parsed_args.opt_run)
@@ -268,7 +328,7 @@ int32_t main(int32_t argc, const char **argv)
   }
   hk_string_t *file = hk_string_from_chars(-1, input ? input : "<stdin>");
   hk_string_t *source = input ? load_source_from_file(input) : hk_string_from_stream(stdin, '\0');
-  hk_closure_t *cl = hk_compile(file, source);
+  hk_closure_t *cl = hk_compile(file, source, flags);
   const char *output = parsed_args.output;
   if (parsed_args.opt_dump)
   {
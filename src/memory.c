@@ -5,9 +5,53 @@
 
 #include <hook/memory.h>
 #include <stdlib.h>
+#include <string.h>
 #include <hook/error.h>
 
+#define HEADER_SIZE ((int32_t) sizeof(uint64_t))
+#define TAG_SHIFT   8
+#define SIZE_SHIFT  32
+
+#define header_class(h) ((int32_t) ((h) & 0xff))
+#define header_tag(h)   ((int32_t) (((h) >> TAG_SHIFT) & 0xff))
+#define header_size(h)  ((int32_t) ((h) >> SIZE_SHIFT))
+
+#ifndef HK_LIBC_ALLOCATOR
+
+#define CLASS_SIZE     16
+#define NUM_CLASSES    16
+#define MAX_BLOCK_SIZE (CLASS_SIZE * NUM_CLASSES)
+#define SLAB_SIZE      (1 << 16)
+
+typedef union block
+{
+  union block *next;
+  uint64_t header;
+} block_t;
+
+typedef struct slab
+{
+  struct slab *next;
+  uint64_t padding;
+} slab_t;
+
+static block_t *free_lists[NUM_CLASSES];
+static slab_t *slabs = NULL;
+
+#endif
+
+static hk_memory_t default_memory;
+static hk_memory_t *memory = &default_memory;
+
 static inline void check(void *ptr);
+static inline int32_t block_size(uint64_t header);
+static inline void account(int32_t tag, int64_t delta);
+static inline void *allocate_large(int32_t size);
+static inline void *reallocate_large(uint64_t *header, int32_t size);
+
+#ifndef HK_LIBC_ALLOCATOR
+static inline block_t *refill(int32_t index);
+#endif
 
 static inline void check(void *ptr)
 {
@@ -15,16 +59,161 @@ static inline void check(void *ptr)
     hk_fatal_error("out of memory");
 }
 
+static inline int32_t block_size(uint64_t header)
+{
+#ifndef HK_LIBC_ALLOCATOR
+  int32_t index = header_class(header);
+  if (index)
+    return index * CLASS_SIZE;
+#endif
+  return header_size(header);
+}
+
+static inline void account(int32_t tag, int64_t delta)
+{
+  memory->used += delta;
+  if (memory->used > memory->peak)
+    memory->peak = memory->used;
+  memory->bytes[tag & HK_MEMORY_TYPE_MASK] += delta;
+}
+
+static inline void *allocate_large(int32_t size)
+{
+  int32_t total = size + HEADER_SIZE;
+  uint64_t *header = (uint64_t *) malloc(total);
+  check(header);
+  header[0] = (uint64_t) total << SIZE_SHIFT;
+  account(0, total);
+  return &header[1];
+}
+
+static inline void *reallocate_large(uint64_t *header, int32_t size)
+{
+  uint64_t old = header[0];
+  int32_t tag = header_tag(old);
+  int32_t total = size + HEADER_SIZE;
+  header = (uint64_t *) realloc(header, total);
+  check(header);
+  header[0] = ((uint64_t) total << SIZE_SHIFT) | ((uint64_t) tag << TAG_SHIFT);
+  account(tag, (int64_t) total - header_size(old));
+  return &header[1];
+}
+
+#ifndef HK_LIBC_ALLOCATOR
+static inline block_t *refill(int32_t index)
+{
+  slab_t *slab = (slab_t *) malloc(SLAB_SIZE);
+  check(slab);
+  slab->next = slabs;
+  slabs = slab;
+  int32_t block_size = (index + 1) * CLASS_SIZE;
+  int32_t num_blocks = (SLAB_SIZE - (int32_t) sizeof(*slab)) / block_size;
+  uint8_t *bytes = (uint8_t *) &slab[1];
+  block_t *head = NULL;
+  for (int32_t i = num_blocks - 1; i >= 0; --i)
+  {
+    block_t *block = (block_t *) &bytes[i * block_size];
+    block->next = head;
+    head = block;
+  }
+  return head;
+}
+#endif
+
 void *hk_allocate(int32_t size)
 {
-  void *ptr = malloc(size);
-  check(ptr);
-  return ptr;
+#ifdef HK_LIBC_ALLOCATOR
+  return allocate_large(size);
+#else
+  int32_t total = size + HEADER_SIZE;
+  if (total > MAX_BLOCK_SIZE)
+    return allocate_large(size);
+  int32_t index = (total - 1) / CLASS_SIZE;
+  block_t *block = free_lists[index];
+  if (!block)
+    block = refill(index);
+  free_lists[index] = block->next;
+  block->header = index + 1;
+  account(0, (index + 1) * CLASS_SIZE);
+  return &((uint64_t *) block)[1];
+#endif
 }
 
 void *hk_reallocate(void *ptr, int32_t size)
 {
-  ptr = realloc(ptr, size);
-  check(ptr);
-  return ptr;
+  if (!ptr)
+    return hk_allocate(size);
+  uint64_t *header = &((uint64_t *) ptr)[-1];
+#ifdef HK_LIBC_ALLOCATOR
+  return reallocate_large(header, size);
+#else
+  if (!header_class(header[0]))
+    return reallocate_large(header, size);
+  int32_t capacity = block_size(header[0]) - HEADER_SIZE;
+  if (size <= capacity)
+    return ptr;
+  void *result = hk_allocate(size);
+  hk_memory_tag(result, header_tag(header[0]));
+  memcpy(result, ptr, capacity);
+  hk_free(ptr);
+  return result;
+#endif
+}
+
+void hk_free(void *ptr)
+{
+  if (!ptr)
+    return;
+  uint64_t *header = &((uint64_t *) ptr)[-1];
+  int32_t tag = header_tag(header[0]);
+  account(tag, -block_size(header[0]));
+  if (tag & HK_MEMORY_OBJECT)
+    --memory->objects[tag & HK_MEMORY_TYPE_MASK];
+#ifdef HK_LIBC_ALLOCATOR
+  free(header);
+#else
+  int32_t index = header_class(header[0]);
+  if (!index)
+  {
+    free(header);
+    return;
+  }
+  block_t *block = (block_t *) header;
+  block->next = free_lists[index - 1];
+  free_lists[index - 1] = block;
+#endif
+}
+
+void hk_memory_tag(void *ptr, int32_t tag)
+{
+  uint64_t *header = &((uint64_t *) ptr)[-1];
+  uint64_t old = header[0];
+  int32_t old_tag = header_tag(old);
+  int32_t size = block_size(old);
+  account(old_tag, -size);
+  account(tag, size);
+  if (old_tag & HK_MEMORY_OBJECT)
+    --memory->objects[old_tag & HK_MEMORY_TYPE_MASK];
+  if (tag & HK_MEMORY_OBJECT)
+    ++memory->objects[tag & HK_MEMORY_TYPE_MASK];
+  header[0] = (old & ~((uint64_t) 0xff << TAG_SHIFT)) | ((uint64_t) tag << TAG_SHIFT);
+}
+
+hk_memory_t *hk_memory(void)
+{
+  return memory;
+}
+
+#ifdef _WIN32
+void __declspec(dllexport) hk_memory_attach(hk_memory_t *shared)
+#else
+void hk_memory_attach(hk_memory_t *shared)
+#endif
+{
+  memory = shared;
+}
+
+bool hk_memory_exceeded(void)
+{
+  return memory->limit && memory->used > memory->limit;
 }
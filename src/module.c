@@ -5,10 +5,13 @@
 
 #include "module.h"
 #include <stdlib.h>
+#include <string.h>
 #include <hook/status.h>
 #include <hook/error.h>
+#include <hook/memory.h>
 #include <hook/utils.h>
 #include "string_map.h"
+#include "gc.h"
 
 #ifdef _WIN32
   #include <Windows.h>
@@ -43,6 +46,18 @@
   typedef int32_t (*load_module_t)(hk_state_t *);
 #endif
 
+typedef void (*attach_memory_t)(hk_memory_t *);
+
+typedef struct
+{
+  const char *name;
+  int32_t (*load)(hk_state_t *);
+} builtin_module_t;
+
+static builtin_module_t builtin_modules[] = {
+  {"gc", &load_gc}
+};
+
 static string_map_t module_cache;
 
 static inline bool get_module_result(hk_string_t *name, hk_value_t *result);
@@ -50,7 +65,9 @@ static inline void put_module_result(hk_string_t *name, hk_value_t result);
 static inline const char *get_home_dir(void);
 static inline const char *get_default_home_dir(void);
 
+static inline builtin_module_t *get_builtin_module(hk_string_t *name);
 static inline int32_t load_native_module(hk_state_t *state, hk_string_t *name);
+static inline void intern_field_names(hk_value_t val);
 
 static inline bool get_module_result(hk_string_t *name, hk_value_t *result)
 {
@@ -88,6 +105,18 @@ static inline const char *get_default_home_dir(void)
   return result;
 }
 
+static inline builtin_module_t *get_builtin_module(hk_string_t *name)
+{
+  int32_t n = (int32_t) (sizeof(builtin_modules) / sizeof(*builtin_modules));
+  for (int32_t i = 0; i < n; ++i)
+  {
+    builtin_module_t *module = &builtin_modules[i];
+    if (!strcmp(module->name, hk_string_chars(name)))
+      return module;
+  }
+  return NULL;
+}
+
 static inline int32_t load_native_module(hk_state_t *state, hk_string_t *name)
 {
   hk_string_t *file = hk_string_from_chars(-1, get_home_dir());
@@ -106,6 +135,14 @@ static inline int32_t load_native_module(hk_state_t *state, hk_string_t *name)
     return HK_STATUS_ERROR;
   }
   hk_string_free(file);
+  attach_memory_t attach;
+#ifdef _WIN32
+  attach = (attach_memory_t) GetProcAddress(handle, HK_MEMORY_ATTACH_FN);
+#else
+  *((void **) &attach) = dlsym(handle, HK_MEMORY_ATTACH_FN);
+#endif
+  if (attach)
+    attach(hk_memory());
   hk_string_t *fn_name = hk_string_from_chars(-1, HK_LOAD_FN_PREFIX);
   hk_string_inplace_concat(fn_name, name);
   load_module_t load;
@@ -123,12 +160,30 @@ static inline int32_t load_native_module(hk_state_t *state, hk_string_t *name)
   hk_string_free(fn_name);
   if (load(state) == HK_STATUS_ERROR)
   {
-    hk_runtime_error("cannot load module `%.*s`", name->length, name->chars);
+    hk_runtime_error("cannot load module `%.*s`", name->length,
+      hk_string_chars(name));
     return HK_STATUS_ERROR;
   }
   return HK_STATUS_OK;
 }
 
+static inline void intern_field_names(hk_value_t val)
+{
+  if (!hk_is_instance(val))
+    return;
+  hk_struct_t *ztruct = hk_as_instance(val)->ztruct;
+  for (int32_t i = 0; i < ztruct->length; ++i)
+  {
+    hk_field_t *field = &ztruct->fields[i];
+    hk_string_t *name = hk_string_intern(field->name);
+    if (name == field->name)
+      continue;
+    hk_incr_ref(name);
+    hk_string_release(field->name);
+    field->name = name;
+  }
+}
+
 void init_module_cache(void)
 {
   string_map_init(&module_cache, 0);
@@ -141,23 +196,30 @@ void free_module_cache(void)
 
 int32_t load_module(hk_state_t *state)
 {
-  hk_value_t *slots = &state->stack[state->stack_top];
-  hk_value_t val = slots[0];
+  int32_t index = state->stack_top;
+  hk_value_t val = state->stack[index];
   hk_assert(hk_is_string(val), "module name must be a string");
   hk_string_t *name = hk_as_string(val);
   hk_value_t result;
   if (get_module_result(name, &result))
   {
     hk_value_incr_ref(result);
-    slots[0] = result;
+    state->stack[index] = result;
     --state->stack_top;
     hk_string_release(name);
     return HK_STATUS_OK;
   }
-  if (load_native_module(state, name) == HK_STATUS_ERROR)
+  builtin_module_t *module = get_builtin_module(name);
+  if (module)
+  {
+    if (module->load(state) == HK_STATUS_ERROR)
+      return HK_STATUS_ERROR;
+  }
+  else if (load_native_module(state, name) == HK_STATUS_ERROR)
     return HK_STATUS_ERROR;
+  intern_field_names(state->stack[state->stack_top]);
   put_module_result(name, state->stack[state->stack_top]);
-  slots[0] = state->stack[state->stack_top];
+  state->stack[index] = state->stack[state->stack_top];
   --state->stack_top;
   hk_string_release(name);
   return HK_STATUS_OK;
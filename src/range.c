@@ -14,19 +14,32 @@ typedef struct
   int64_t current;
 } range_iterator_t;
 
+static range_iterator_t *iterator_pool[HK_ITERATOR_POOL_CAPACITY];
+static int32_t iterator_pool_length = 0;
+
 static inline range_iterator_t *range_iterator_allocate(hk_range_t *range);
 static void range_iterator_deinit(hk_iterator_t *it);
 static bool range_iterator_is_valid(hk_iterator_t *it);
 static hk_value_t range_iterator_get_current(hk_iterator_t *it);
 static hk_iterator_t *range_iterator_next(hk_iterator_t *it);
 static void range_iterator_inplace_next(hk_iterator_t *it);
+static void range_iterator_recycle(hk_iterator_t *it);
 
 static inline range_iterator_t *range_iterator_allocate(hk_range_t *range)
 {
-   range_iterator_t *range_it = (range_iterator_t *) hk_allocate(sizeof(*range_it));
-  hk_iterator_init((hk_iterator_t *) range_it, &range_iterator_deinit,
-    &range_iterator_is_valid, &range_iterator_get_current,
-    &range_iterator_next, &range_iterator_inplace_next);
+  range_iterator_t *range_it;
+  if (iterator_pool_length)
+  {
+    range_it = iterator_pool[--iterator_pool_length];
+    range_it->ref_count = 0;
+  }
+  else
+  {
+    range_it = (range_iterator_t *) hk_allocate(sizeof(*range_it));
+    hk_iterator_init((hk_iterator_t *) range_it, &range_iterator_deinit,
+      &range_iterator_is_valid, &range_iterator_get_current,
+      &range_iterator_next, &range_iterator_inplace_next, &range_iterator_recycle);
+  }
   hk_incr_ref(range);
   range_it->range = range;
   return range_it;
@@ -68,6 +81,16 @@ static void range_iterator_inplace_next(hk_iterator_t *it)
   range_it->current += range->step;
 }
 
+static void range_iterator_recycle(hk_iterator_t *it)
+{
+  if (iterator_pool_length == HK_ITERATOR_POOL_CAPACITY)
+  {
+    hk_free(it);
+    return;
+  }
+  iterator_pool[iterator_pool_length++] = (range_iterator_t *) it;
+}
+
 hk_range_t *hk_range_new(int64_t start, int64_t end)
 {
   hk_range_t *range = (hk_range_t *) hk_allocate(sizeof(*range));
@@ -80,7 +103,7 @@ hk_range_t *hk_range_new(int64_t start, int64_t end)
 
 void hk_range_free(hk_range_t *range)
 {
-  free(range);
+  hk_free(range);
 }
 
 void hk_range_release(hk_range_t *range)
@@ -5,6 +5,7 @@
 
 #include <hook/state.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <hook/struct.h>
 #include <hook/iterable.h>
@@ -14,23 +15,45 @@
 #include <hook/utils.h>
 #include "module.h"
 #include "builtin.h"
-
-static inline int32_t push(hk_state_t *state, hk_value_t val);
+#include "gc.h"
+
+#ifdef HK_JIT
+  #include "jit.h"
+#endif
+
+#define TRACE_HEAD_FRAMES 10
+#define TRACE_TAIL_FRAMES 10
+
+#ifdef HK_COMPUTED_GOTO
+  #define instruction(op) label_##op
+  #define next()          goto *labels[read_byte(&pc)]
+#else
+  #define instruction(op) case op
+  #define next()          break
+#endif
+
+static inline int32_t grow_stack(hk_state_t *state, int32_t min_capacity);
+static inline int32_t check_memory(void);
+static inline int32_t reserve(hk_state_t *state, int32_t size);
+static inline void push(hk_state_t *state, hk_value_t val);
+static inline int32_t push_or_grow(hk_state_t *state, hk_value_t val);
 static inline void pop(hk_state_t *state);
 static inline int32_t read_byte(uint8_t **pc);
 static inline int32_t read_word(uint8_t **pc);
 static inline int32_t do_range(hk_state_t *state);
-static inline int32_t do_array(hk_state_t *state, int32_t length);
+static inline int32_t do_range_loop(hk_state_t *state);
+static inline void do_array(hk_state_t *state, int32_t length);
 static inline int32_t do_struct(hk_state_t *state, int32_t length);
 static inline int32_t do_instance(hk_state_t *state, int32_t num_args);
-static inline int32_t adjust_instance_args(hk_state_t *state, int32_t length, int32_t num_args);
+static inline void adjust_instance_args(hk_state_t *state, int32_t length, int32_t num_args);
 static inline int32_t do_construct(hk_state_t *state, int32_t length);
 static inline int32_t do_iterator(hk_state_t *state);
-static inline int32_t do_closure(hk_state_t *state, hk_function_t *fn);
+static inline void do_closure(hk_state_t *state, hk_function_t *fn);
 static inline int32_t do_unpack_array(hk_state_t *state, int32_t n);
 static inline int32_t do_unpack_struct(hk_state_t *state, int32_t n);
 static inline int32_t do_add_element(hk_state_t *state);
 static inline int32_t do_get_element(hk_state_t *state);
+static inline int32_t do_load_element(hk_state_t *state, hk_value_t val1, hk_value_t val2);
 static inline void slice_string(hk_state_t *state, hk_value_t *slot, hk_string_t *str, hk_range_t *range);
 static inline void slice_array(hk_state_t *state, hk_value_t *slot, hk_array_t *arr, hk_range_t *range);
 static inline int32_t do_fetch_element(hk_state_t *state);
@@ -40,14 +63,18 @@ static inline int32_t do_delete_element(hk_state_t *state);
 static inline int32_t do_inplace_add_element(hk_state_t *state);
 static inline int32_t do_inplace_put_element(hk_state_t *state);
 static inline int32_t do_inplace_delete_element(hk_state_t *state);
-static inline int32_t do_get_field(hk_state_t *state, hk_string_t *name);
-static inline int32_t do_fetch_field(hk_state_t *state, hk_string_t *name);
+static inline int32_t lookup_field(hk_field_cache_t *cache, hk_struct_t *ztruct, hk_string_t *name);
+static inline int32_t do_get_field(hk_state_t *state, hk_string_t *name, hk_field_cache_t *cache);
+static inline int32_t do_load_field(hk_state_t *state, hk_value_t val, hk_string_t *name,
+  hk_field_cache_t *cache);
+static inline int32_t do_fetch_field(hk_state_t *state, hk_string_t *name, hk_field_cache_t *cache);
 static inline void do_set_field(hk_state_t *state);
-static inline int32_t do_put_field(hk_state_t *state, hk_string_t *name);
-static inline int32_t do_inplace_put_field(hk_state_t *state, hk_string_t *name);
+static inline int32_t do_put_field(hk_state_t *state, hk_string_t *name, hk_field_cache_t *cache);
+static inline int32_t do_inplace_put_field(hk_state_t *state, hk_string_t *name, hk_field_cache_t *cache);
 static inline void do_current(hk_state_t *state);
 static inline void do_next(hk_state_t *state);
 static inline void do_equal(hk_state_t *state);
+static inline bool are_numbers(hk_state_t *state);
 static inline int32_t do_greater(hk_state_t *state);
 static inline int32_t do_less(hk_state_t *state);
 static inline void do_not_equal(hk_state_t *state);
@@ -72,20 +99,74 @@ static inline void do_not(hk_state_t *state);
 static inline int32_t do_bitwise_not(hk_state_t *state);
 static inline int32_t do_increment(hk_state_t *state);
 static inline int32_t do_decrement(hk_state_t *state);
+static inline int32_t do_increment_local(hk_value_t *slot);
+static inline int32_t do_decrement_local(hk_value_t *slot);
 static inline int32_t do_call(hk_state_t *state, int32_t num_args);
-static inline int32_t adjust_call_args(hk_state_t *state, int32_t arity, int32_t num_args);
+static inline int32_t reserve_native(hk_state_t *state, hk_native_t *native, int32_t num_args);
+static inline void flatten_args(hk_value_t *args, int32_t length);
+static inline int32_t reserve_function(hk_state_t *state, hk_function_t *fn, int32_t num_args);
+static inline void adjust_call_args(hk_state_t *state, int32_t arity, int32_t num_args);
+static inline bool is_traced(int32_t index);
 static inline void print_trace(hk_string_t *name, hk_string_t *file, int32_t line);
-static inline int32_t call_function(hk_state_t *state, hk_value_t *locals, hk_closure_t *cl, int32_t *line);
+static inline void print_frame_trace(hk_function_t *fn, int32_t offset);
+static inline void push_frame(hk_state_t *state, hk_closure_t *cl, int32_t base);
+static inline void reuse_frame(hk_state_t *state, hk_frame_t *frame, hk_closure_t *cl,
+  int32_t base);
+static inline int32_t call_function(hk_state_t *state);
 static inline void discard_frame(hk_state_t *state, hk_value_t *slots);
 static inline void move_result(hk_state_t *state, hk_value_t *slots);
 
-static inline int32_t push(hk_state_t *state, hk_value_t val)
+static int32_t trace_top = -1;
+
+#ifdef HK_JIT
+static int32_t jit_depth = 0;
+
+static inline bool jit_ready(hk_function_t *fn);
+#endif
+
+static inline int32_t grow_stack(hk_state_t *state, int32_t min_capacity)
 {
-  if (state->stack_top == state->stack_end)
+  if (min_capacity > state->stack_limit)
   {
     hk_runtime_error("stack overflow");
     return HK_STATUS_ERROR;
   }
+  int32_t capacity = hk_power_of_two_ceil(min_capacity);
+  if (capacity > state->stack_limit)
+    capacity = state->stack_limit;
+  state->stack_end = capacity - 1;
+  state->stack = (hk_value_t *) hk_reallocate(state->stack,
+    sizeof(*state->stack) * capacity);
+  return HK_STATUS_OK;
+}
+
+static inline int32_t check_memory(void)
+{
+  if (!hk_memory_exceeded())
+    return HK_STATUS_OK;
+  hk_memory_t *memory = hk_memory();
+  hk_runtime_error("out of memory: %lld bytes in use, limit is %lld bytes",
+    (long long) memory->used, (long long) memory->limit);
+  return HK_STATUS_ERROR;
+}
+
+static inline int32_t reserve(hk_state_t *state, int32_t size)
+{
+  if (state->stack_top + size <= state->stack_end)
+    return HK_STATUS_OK;
+  return grow_stack(state, state->stack_top + size + 1);
+}
+
+static inline void push(hk_state_t *state, hk_value_t val)
+{
+  ++state->stack_top;
+  state->stack[state->stack_top] = val;
+}
+
+static inline int32_t push_or_grow(hk_state_t *state, hk_value_t val)
+{
+  if (reserve(state, 1) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
   ++state->stack_top;
   state->stack[state->stack_top] = val;
   return HK_STATUS_OK;
@@ -130,7 +211,25 @@ static inline int32_t do_range(hk_state_t *state)
   return HK_STATUS_OK;
 }
 
-static inline int32_t do_array(hk_state_t *state, int32_t length)
+static inline int32_t do_range_loop(hk_state_t *state)
+{
+  hk_value_t *slots = &state->stack[state->stack_top - 2];
+  hk_value_t val1 = slots[1];
+  hk_value_t val2 = slots[2];
+  if (!hk_is_number(val1) || !hk_is_number(val2))
+  {
+    hk_runtime_error("type error: range must be of type number");
+    return HK_STATUS_ERROR;
+  }
+  int64_t start = (int64_t) hk_as_number(val1);
+  int64_t end = (int64_t) hk_as_number(val2);
+  slots[0] = hk_number_value((double) start);
+  slots[1] = hk_number_value((double) end);
+  slots[2] = hk_number_value(start < end ? 1 : -1);
+  return HK_STATUS_OK;
+}
+
+static inline void do_array(hk_state_t *state, int32_t length)
 {
   hk_value_t *slots = &state->stack[state->stack_top - length + 1];
   hk_array_t *arr = hk_array_new_with_capacity(length);
@@ -138,13 +237,8 @@ static inline int32_t do_array(hk_state_t *state, int32_t length)
   for (int32_t i = 0; i < length; ++i)
     arr->elements[i] = slots[i];
   state->stack_top -= length;
-  if (push(state, hk_array_value(arr)) == HK_STATUS_ERROR)
-  {
-    hk_array_free(arr);
-    return HK_STATUS_ERROR;
-  }
+  push(state, hk_array_value(arr));
   hk_incr_ref(arr);
-  return HK_STATUS_OK;
 }
 
 static inline int32_t do_struct(hk_state_t *state, int32_t length)
@@ -159,7 +253,7 @@ static inline int32_t do_struct(hk_state_t *state, int32_t length)
     if (!hk_struct_define_field(ztruct, field_name))
     {
       hk_runtime_error("field %.*s is already defined", field_name->length,
-        field_name->chars);
+        hk_string_chars(field_name));
       hk_struct_free(ztruct);
       return HK_STATUS_ERROR;
     }
@@ -180,11 +274,14 @@ static inline int32_t do_instance(hk_state_t *state, int32_t num_args)
   hk_value_t val = slots[0];
   if (!hk_is_struct(val))
   {
-    hk_runtime_error("type error: cannot use %s as a struct", hk_type_name(val.type));
+    hk_runtime_error("type error: cannot use %s as a struct", hk_type_name(hk_type(val)));
     return HK_STATUS_ERROR;
   }
   hk_struct_t *ztruct = hk_as_struct(val);
   int32_t length = ztruct->length;
+  if (reserve(state, length - num_args) == HK_STATUS_ERROR)
+    return HK_STATUS_ERROR;
+  slots = &state->stack[state->stack_top - num_args];
   adjust_instance_args(state, length, num_args);
   hk_instance_t *inst = hk_instance_new(ztruct);
   for (int32_t i = 0; i < length; ++i)
@@ -196,7 +293,7 @@ static inline int32_t do_instance(hk_state_t *state, int32_t num_args)
   return HK_STATUS_OK;
 }
 
-static inline int32_t adjust_instance_args(hk_state_t *state, int32_t length, int32_t num_args)
+static inline void adjust_instance_args(hk_state_t *state, int32_t length, int32_t num_args)
 {
   if (num_args > length)
   {
@@ -206,15 +303,13 @@ static inline int32_t adjust_instance_args(hk_state_t *state, int32_t length, in
       --num_args;
     }
     while (num_args > length);
-    return HK_STATUS_OK;
+    return;
   }
   while (num_args < length)
   {
-    if (push(state, HK_NIL_VALUE) == HK_STATUS_ERROR)
-      return HK_STATUS_ERROR;
+    push(state, HK_NIL_VALUE);
     ++num_args;
   }
-  return HK_STATUS_OK;
 }
 
 static inline int32_t do_construct(hk_state_t *state, int32_t length)
@@ -230,7 +325,7 @@ static inline int32_t do_construct(hk_state_t *state, int32_t length)
     if (hk_struct_define_field(ztruct, field_name))
       continue;
     hk_runtime_error("field %.*s is already defined", field_name->length,
-      field_name->chars);
+      hk_string_chars(field_name));
     hk_struct_free(ztruct);
     return HK_STATUS_ERROR;
   }
@@ -256,7 +351,7 @@ static inline int32_t do_iterator(hk_state_t *state)
   hk_iterator_t *it = hk_new_iterator(val);
   if (!it)
   {
-    hk_runtime_error("type error: value of type %s is not iterable", hk_type_name(val.type));
+    hk_runtime_error("type error: value of type %s is not iterable", hk_type_name(hk_type(val)));
     return HK_STATUS_ERROR;
   }
   hk_incr_ref(it);
@@ -265,7 +360,7 @@ static inline int32_t do_iterator(hk_state_t *state)
   return HK_STATUS_OK;
 }
 
-static inline int32_t do_closure(hk_state_t *state, hk_function_t *fn)
+static inline void do_closure(hk_state_t *state, hk_function_t *fn)
 {
   int32_t num_nonlocals = fn->num_nonlocals;
   hk_value_t *slots = &state->stack[state->stack_top - num_nonlocals + 1];
@@ -273,13 +368,8 @@ static inline int32_t do_closure(hk_state_t *state, hk_function_t *fn)
   for (int32_t i = 0; i < num_nonlocals; ++i)
     cl->nonlocals[i] = slots[i];
   state->stack_top -= num_nonlocals;
-  if (push(state, hk_closure_value(cl)) == HK_STATUS_ERROR)
-  {
-    hk_closure_free(cl);
-    return HK_STATUS_ERROR;
-  }
+  push(state, hk_closure_value(cl));
   hk_incr_ref(cl);
-  return HK_STATUS_OK;
 }
 
 static inline int32_t do_unpack_array(hk_state_t *state, int32_t n)
@@ -288,25 +378,21 @@ static inline int32_t do_unpack_array(hk_state_t *state, int32_t n)
   if (!hk_is_array(val))
   {
     hk_runtime_error("type error: value of type %s is not an array",
-      hk_type_name(val.type));
+      hk_type_name(hk_type(val)));
     return HK_STATUS_ERROR;
   }
   hk_array_t *arr = hk_as_array(val);
   --state->stack_top;
-  int32_t status = HK_STATUS_OK;
   for (int32_t i = 0; i < n && i < arr->length; ++i)
   {
     hk_value_t elem = hk_array_get_element(arr, i);
-    if ((status = push(state, elem)) == HK_STATUS_ERROR)
-      goto end;
+    push(state, elem);
     hk_value_incr_ref(elem);
   }
   for (int32_t i = arr->length; i < n; ++i)
-    if ((status = push(state, HK_NIL_VALUE)) == HK_STATUS_ERROR)
-      break;
-end:
+    push(state, HK_NIL_VALUE);
   hk_array_release(arr);
-  return status;
+  return HK_STATUS_OK;
 }
 
 static inline int32_t do_unpack_struct(hk_state_t *state, int32_t n)
@@ -315,7 +401,7 @@ static inline int32_t do_unpack_struct(hk_state_t *state, int32_t n)
   if (!hk_is_instance(val))
   {
     hk_runtime_error("type error: value of type %s is not an instance of struct",
-      hk_type_name(val.type));
+      hk_type_name(hk_type(val)));
     return HK_STATUS_ERROR;
   }
   hk_instance_t *inst = hk_as_instance(val);
@@ -343,7 +429,7 @@ static inline int32_t do_add_element(hk_state_t *state)
   hk_value_t val2 = slots[1];
   if (!hk_is_array(val1))
   {
-    hk_runtime_error("type error: cannot use %s as an array", hk_type_name(val1.type));
+    hk_runtime_error("type error: cannot use %s as an array", hk_type_name(hk_type(val1)));
     return HK_STATUS_ERROR;
   }
   hk_array_t *arr = hk_as_array(val1);
@@ -353,7 +439,7 @@ static inline int32_t do_add_element(hk_state_t *state)
   --state->stack_top;
   hk_array_release(arr);  
   hk_value_decr_ref(val2);
-  return HK_STATUS_OK;
+  return check_memory();
 }
 
 static inline int32_t do_get_element(hk_state_t *state)
@@ -373,7 +459,7 @@ static inline int32_t do_get_element(hk_state_t *state)
           index, str->length);
         return HK_STATUS_ERROR;
       }
-      hk_value_t result = hk_string_value(hk_string_from_chars(1, &str->chars[(int32_t) index]));
+      hk_value_t result = hk_string_value(hk_string_from_chars(1, &hk_string_chars(str)[(int32_t) index]));
       hk_value_incr_ref(result);
       slots[0] = result;
       --state->stack_top;
@@ -382,7 +468,7 @@ static inline int32_t do_get_element(hk_state_t *state)
     }
     if (!hk_is_range(val2))
     {
-      hk_runtime_error("type error: string cannot be indexed by %s", hk_type_name(val2.type));
+      hk_runtime_error("type error: string cannot be indexed by %s", hk_type_name(hk_type(val2)));
       return HK_STATUS_ERROR;
     }
     slice_string(state, slots, str, hk_as_range(val2));
@@ -390,7 +476,7 @@ static inline int32_t do_get_element(hk_state_t *state)
   }
   if (!hk_is_array(val1))
   {
-    hk_runtime_error("type error: %s cannot be indexed", hk_type_name(val1.type));
+    hk_runtime_error("type error: %s cannot be indexed", hk_type_name(hk_type(val1)));
     return HK_STATUS_ERROR;
   }
   hk_array_t *arr = hk_as_array(val1);
@@ -412,13 +498,37 @@ static inline int32_t do_get_element(hk_state_t *state)
   }
   if (!hk_is_range(val2))
   {
-    hk_runtime_error("type error: array cannot be indexed by %s", hk_type_name(val2.type));
+    hk_runtime_error("type error: array cannot be indexed by %s", hk_type_name(hk_type(val2)));
     return HK_STATUS_ERROR;
   }
   slice_array(state, slots, arr, hk_as_range(val2));
   return HK_STATUS_OK;
 }
 
+static inline int32_t do_load_element(hk_state_t *state, hk_value_t val1, hk_value_t val2)
+{
+  if (!hk_is_array(val1) || !hk_is_int(val2))
+  {
+    push(state, val1);
+    hk_value_incr_ref(val1);
+    push(state, val2);
+    hk_value_incr_ref(val2);
+    return do_get_element(state);
+  }
+  hk_array_t *arr = hk_as_array(val1);
+  int64_t index = (int64_t) hk_as_number(val2);
+  if (index < 0 || index >= arr->length)
+  {
+    hk_runtime_error("range error: index %d is out of bounds for array of length %d",
+      index, arr->length);
+    return HK_STATUS_ERROR;
+  }
+  hk_value_t result = hk_array_get_element(arr, (int32_t) index);
+  push(state, result);
+  hk_value_incr_ref(result);
+  return HK_STATUS_OK;
+}
+
 static inline void slice_string(hk_state_t *state, hk_value_t *slot, hk_string_t *str, hk_range_t *range)
 {
   int32_t str_end = str->length - 1;
@@ -437,7 +547,7 @@ static inline void slice_string(hk_state_t *state, hk_value_t *slot, hk_string_t
     return;
   }
   int32_t length = end - start + 1;
-  result = hk_string_from_chars(length, &str->chars[start]);
+  result = hk_string_from_chars(length, &hk_string_chars(str)[start]);
 end:
   hk_incr_ref(result);
   *slot = hk_string_value(result);
@@ -487,12 +597,12 @@ static inline int32_t do_fetch_element(hk_state_t *state)
   hk_value_t val2 = slots[1];
   if (!hk_is_array(val1))
   {
-    hk_runtime_error("type error: cannot use %s as an array", hk_type_name(val1.type));
+    hk_runtime_error("type error: cannot use %s as an array", hk_type_name(hk_type(val1)));
     return HK_STATUS_ERROR;
   }
   if (!hk_is_int(val2))
   {
-    hk_runtime_error("type error: array cannot be indexed by %s", hk_type_name(val2.type));
+    hk_runtime_error("type error: array cannot be indexed by %s", hk_type_name(hk_type(val2)));
     return HK_STATUS_ERROR;
   }
   hk_array_t *arr = hk_as_array(val1);
@@ -504,8 +614,7 @@ static inline int32_t do_fetch_element(hk_state_t *state)
     return HK_STATUS_ERROR;
   }
   hk_value_t elem = hk_array_get_element(arr, (int32_t) index);
-  if (push(state, elem) == HK_STATUS_ERROR)
-    return HK_STATUS_ERROR;
+  push(state, elem);
   hk_value_incr_ref(elem);
   return HK_STATUS_OK;
 }
@@ -534,12 +643,12 @@ static inline int32_t do_put_element(hk_state_t *state)
   hk_value_t val3 = slots[2];
   if (!hk_is_array(val1))
   {
-    hk_runtime_error("type error: cannot use %s as an array", hk_type_name(val1.type));
+    hk_runtime_error("type error: cannot use %s as an array", hk_type_name(hk_type(val1)));
     return HK_STATUS_ERROR;
   }
   if (!hk_is_int(val2))
   {
-    hk_runtime_error("type error: array cannot be indexed by %s", hk_type_name(val2.type));
+    hk_runtime_error("type error: array cannot be indexed by %s", hk_type_name(hk_type(val2)));
     return HK_STATUS_ERROR;
   }
   hk_array_t *arr = hk_as_array(val1);
@@ -566,12 +675,12 @@ static inline int32_t do_delete_element(hk_state_t *state)
   hk_value_t val2 = slots[1];
   if (!hk_is_array(val1))
   {
-    hk_runtime_error("type error: cannot use %s as an array", hk_type_name(val1.type));
+    hk_runtime_error("type error: cannot use %s as an array", hk_type_name(hk_type(val1)));
     return HK_STATUS_ERROR;
   }
   if (!hk_is_int(val2))
   {
-    hk_runtime_error("type error: array cannot be indexed by %s", hk_type_name(val2.type));
+    hk_runtime_error("type error: array cannot be indexed by %s", hk_type_name(hk_type(val2)));
     return HK_STATUS_ERROR;
   }
   hk_array_t *arr = hk_as_array(val1);
@@ -597,7 +706,7 @@ static inline int32_t do_inplace_add_element(hk_state_t *state)
   hk_value_t val2 = slots[1];
   if (!hk_is_array(val1))
   {
-    hk_runtime_error("type error: cannot use %s as an array", hk_type_name(val1.type));
+    hk_runtime_error("type error: cannot use %s as an array", hk_type_name(hk_type(val1)));
     return HK_STATUS_ERROR;
   }
   hk_array_t *arr = hk_as_array(val1);
@@ -606,7 +715,7 @@ static inline int32_t do_inplace_add_element(hk_state_t *state)
     hk_array_inplace_add_element(arr, val2);
     --state->stack_top;
     hk_value_decr_ref(val2);
-    return HK_STATUS_OK;
+    return check_memory();
   }
   hk_array_t *result = hk_array_add_element(arr, val2);
   hk_incr_ref(result);
@@ -614,7 +723,7 @@ static inline int32_t do_inplace_add_element(hk_state_t *state)
   --state->stack_top;
   hk_array_release(arr);
   hk_value_decr_ref(val2);
-  return HK_STATUS_OK;
+  return check_memory();
 }
 
 static inline int32_t do_inplace_put_element(hk_state_t *state)
@@ -625,12 +734,12 @@ static inline int32_t do_inplace_put_element(hk_state_t *state)
   hk_value_t val3 = slots[2];
   if (!hk_is_array(val1))
   {
-    hk_runtime_error("type error: cannot use %s as an array", hk_type_name(val1.type));
+    hk_runtime_error("type error: cannot use %s as an array", hk_type_name(hk_type(val1)));
     return HK_STATUS_ERROR;
   }
   if (!hk_is_int(val2))
   {
-    hk_runtime_error("type error: array cannot be indexed by %s", hk_type_name(val2.type));
+    hk_runtime_error("type error: array cannot be indexed by %s", hk_type_name(hk_type(val2)));
     return HK_STATUS_ERROR;
   }
   hk_array_t *arr = hk_as_array(val1);
@@ -664,12 +773,12 @@ static inline int32_t do_inplace_delete_element(hk_state_t *state)
   hk_value_t val2 = slots[1];
   if (!hk_is_array(val1))
   {
-    hk_runtime_error("type error: cannot use %s as an array", hk_type_name(val1.type));
+    hk_runtime_error("type error: cannot use %s as an array", hk_type_name(hk_type(val1)));
     return HK_STATUS_ERROR;
   }
   if (!hk_is_int(val2))
   {
-    hk_runtime_error("type error: array cannot be indexed by %s", hk_type_name(val2.type));
+    hk_runtime_error("type error: array cannot be indexed by %s", hk_type_name(hk_type(val2)));
     return HK_STATUS_ERROR;
   }
   hk_array_t *arr = hk_as_array(val1);
@@ -694,18 +803,33 @@ static inline int32_t do_inplace_delete_element(hk_state_t *state)
   return HK_STATUS_OK;
 }
 
-static inline int32_t do_get_field(hk_state_t *state, hk_string_t *name)
+static inline int32_t lookup_field(hk_field_cache_t *cache, hk_struct_t *ztruct, hk_string_t *name)
+{
+  if (cache->ztruct == ztruct)
+    return cache->index;
+  int32_t index = hk_struct_index_of(ztruct, name);
+  if (index == -1)
+    return -1;
+  if (cache->ztruct)
+    hk_struct_release(cache->ztruct);
+  hk_incr_ref(ztruct);
+  cache->ztruct = ztruct;
+  cache->index = index;
+  return index;
+}
+
+static inline int32_t do_get_field(hk_state_t *state, hk_string_t *name, hk_field_cache_t *cache)
 {
   hk_value_t *slots = &state->stack[state->stack_top];
   hk_value_t val = slots[0];
   if (!hk_is_instance(val))
   {
     hk_runtime_error("type error: cannot use %s as an instance of struct",
-      hk_type_name(val.type));
+      hk_type_name(hk_type(val)));
     return HK_STATUS_ERROR;
   }
   hk_instance_t *inst = hk_as_instance(val);
-  int32_t index = hk_struct_index_of(inst->ztruct, name);
+  int32_t index = lookup_field(cache, inst->ztruct, name);
   if (index == -1)
   {
     hk_runtime_error("no field %.*s on struct", name->length, name->chars);
@@ -718,28 +842,48 @@ static inline int32_t do_get_field(hk_state_t *state, hk_string_t *name)
   return HK_STATUS_OK;
 }
 
-static inline int32_t do_fetch_field(hk_state_t *state, hk_string_t *name)
+static inline int32_t do_load_field(hk_state_t *state, hk_value_t val, hk_string_t *name,
+  hk_field_cache_t *cache)
+{
+  if (!hk_is_instance(val))
+  {
+    hk_runtime_error("type error: cannot use %s as an instance of struct",
+      hk_type_name(hk_type(val)));
+    return HK_STATUS_ERROR;
+  }
+  hk_instance_t *inst = hk_as_instance(val);
+  int32_t index = lookup_field(cache, inst->ztruct, name);
+  if (index == -1)
+  {
+    hk_runtime_error("no field %.*s on struct", name->length, name->chars);
+    return HK_STATUS_ERROR;
+  }
+  hk_value_t value = hk_instance_get_field(inst, index);
+  push(state, value);
+  hk_value_incr_ref(value);
+  return HK_STATUS_OK;
+}
+
+static inline int32_t do_fetch_field(hk_state_t *state, hk_string_t *name, hk_field_cache_t *cache)
 {
   hk_value_t *slots = &state->stack[state->stack_top];
   hk_value_t val = slots[0];
   if (!hk_is_instance(val))
   {
     hk_runtime_error("type error: cannot use %s as an instance of struct",
-      hk_type_name(val.type));
+      hk_type_name(hk_type(val)));
     return HK_STATUS_ERROR;
   }
   hk_instance_t *inst = hk_as_instance(val);
-  int32_t index = hk_struct_index_of(inst->ztruct, name);
+  int32_t index = lookup_field(cache, inst->ztruct, name);
   if (index == -1)
   {
     hk_runtime_error("no field %.*s on struct", name->length, name->chars);
     return HK_STATUS_ERROR;
   }
-  if (push(state, hk_number_value(index)) == HK_STATUS_ERROR)
-    return HK_STATUS_ERROR;
+  push(state, hk_number_value(index));
   hk_value_t value = hk_instance_get_field(inst, index);
-  if (push(state, value) == HK_STATUS_ERROR)
-    return HK_STATUS_ERROR;
+  push(state, value);
   hk_value_incr_ref(value);
   return HK_STATUS_OK;
 }
@@ -760,7 +904,7 @@ static inline void do_set_field(hk_state_t *state)
   hk_value_decr_ref(val3);
 }
 
-static inline int32_t do_put_field(hk_state_t *state, hk_string_t *name)
+static inline int32_t do_put_field(hk_state_t *state, hk_string_t *name, hk_field_cache_t *cache)
 {
   hk_value_t *slots = &state->stack[state->stack_top - 1];
   hk_value_t val1 = slots[0];
@@ -768,11 +912,11 @@ static inline int32_t do_put_field(hk_state_t *state, hk_string_t *name)
   if (!hk_is_instance(val1))
   {
     hk_runtime_error("type error: cannot use %s as an instance of struct",
-      hk_type_name(val1.type));
+      hk_type_name(hk_type(val1)));
     return HK_STATUS_ERROR;
   }
   hk_instance_t *inst = hk_as_instance(val1);
-  int32_t index = hk_struct_index_of(inst->ztruct, name);
+  int32_t index = lookup_field(cache, inst->ztruct, name);
   if (index == -1)
   {
     hk_runtime_error("no field %.*s on struct", name->length, name->chars);
@@ -787,7 +931,7 @@ static inline int32_t do_put_field(hk_state_t *state, hk_string_t *name)
   return HK_STATUS_OK;
 }
 
-static inline int32_t do_inplace_put_field(hk_state_t *state, hk_string_t *name)
+static inline int32_t do_inplace_put_field(hk_state_t *state, hk_string_t *name, hk_field_cache_t *cache)
 {
   hk_value_t *slots = &state->stack[state->stack_top - 1];
   hk_value_t val1 = slots[0];
@@ -795,11 +939,11 @@ static inline int32_t do_inplace_put_field(hk_state_t *state, hk_string_t *name)
   if (!hk_is_instance(val1))
   {
     hk_runtime_error("type error: cannot use %s as an instance of struct",
-      hk_type_name(val1.type));
+      hk_type_name(hk_type(val1)));
     return HK_STATUS_ERROR;
   }
   hk_instance_t *inst = hk_as_instance(val1);
-  int32_t index = hk_struct_index_of(inst->ztruct, name);
+  int32_t index = lookup_field(cache, inst->ztruct, name);
   if (index == -1)
   {
     hk_runtime_error("no field %.*s on struct", name->length, name->chars);
@@ -837,11 +981,13 @@ static inline void do_next(hk_state_t *state)
   hk_value_t *slots = &state->stack[state->stack_top];
   hk_value_t val = slots[0];
   hk_iterator_t *it = hk_as_iterator(val);
-  if (it->ref_count == 2)
+  if (it->ref_count == 1)
   {
+    ++state->num_inplace_next;
     hk_iterator_inplace_next(it);
     return;
   }
+  ++state->num_copying_next;
   hk_iterator_t *result = hk_iterator_next(it);
   hk_incr_ref(result);
   slots[0] = hk_iterator_value(result);
@@ -859,6 +1005,12 @@ static inline void do_equal(hk_state_t *state)
   hk_value_release(val2);
 }
 
+static inline bool are_numbers(hk_state_t *state)
+{
+  hk_value_t *slots = &state->stack[state->stack_top - 1];
+  return hk_is_number(slots[0]) && hk_is_number(slots[1]);
+}
+
 static inline int32_t do_greater(hk_state_t *state)
 {
   hk_value_t *slots = &state->stack[state->stack_top - 1];
@@ -937,8 +1089,8 @@ static inline int32_t do_bitwise_or(hk_state_t *state)
   hk_value_t val2 = slots[1];
   if (!hk_is_number(val1) || !hk_is_number(val2))
   {
-    hk_runtime_error("type error: cannot apply `bitwise or` between %s and %s", hk_type_name(val1.type),
-      hk_type_name(val2.type));
+    hk_runtime_error("type error: cannot apply `bitwise or` between %s and %s", hk_type_name(hk_type(val1)),
+      hk_type_name(hk_type(val2)));
     return HK_STATUS_ERROR;
   }
   int64_t data = ((int64_t) hk_as_number(val1)) | ((int64_t) hk_as_number(val2));
@@ -954,8 +1106,8 @@ static inline int32_t do_bitwise_xor(hk_state_t *state)
   hk_value_t val2 = slots[1];
   if (!hk_is_number(val1) || !hk_is_number(val2))
   {
-    hk_runtime_error("type error: cannot apply `bitwise xor` between %s and %s", hk_type_name(val1.type),
-      hk_type_name(val2.type));
+    hk_runtime_error("type error: cannot apply `bitwise xor` between %s and %s", hk_type_name(hk_type(val1)),
+      hk_type_name(hk_type(val2)));
     return HK_STATUS_ERROR;
   }
   int64_t data = ((int64_t) hk_as_number(val1)) ^ ((int64_t) hk_as_number(val2));
@@ -971,8 +1123,8 @@ static inline int32_t do_bitwise_and(hk_state_t *state)
   hk_value_t val2 = slots[1];
   if (!hk_is_number(val1) || !hk_is_number(val2))
   {
-    hk_runtime_error("type error: cannot apply `bitwise and` between %s and %s", hk_type_name(val1.type),
-      hk_type_name(val2.type));
+    hk_runtime_error("type error: cannot apply `bitwise and` between %s and %s", hk_type_name(hk_type(val1)),
+      hk_type_name(hk_type(val2)));
     return HK_STATUS_ERROR;
   }
   int64_t data = ((int64_t) hk_as_number(val1)) & ((int64_t) hk_as_number(val2));
@@ -988,8 +1140,8 @@ static inline int32_t do_left_shift(hk_state_t *state)
   hk_value_t val2 = slots[1];
   if (!hk_is_number(val1) || !hk_is_number(val2))
   {
-    hk_runtime_error("type error: cannot apply `left shift` between %s and %s", hk_type_name(val1.type),
-      hk_type_name(val2.type));
+    hk_runtime_error("type error: cannot apply `left shift` between %s and %s", hk_type_name(hk_type(val1)),
+      hk_type_name(hk_type(val2)));
     return HK_STATUS_ERROR;
   }
   int64_t data = ((int64_t) hk_as_number(val1)) << ((int64_t) hk_as_number(val2));
@@ -1005,8 +1157,8 @@ static inline int32_t do_right_shift(hk_state_t *state)
   hk_value_t val2 = slots[1];
   if (!hk_is_number(val1) || !hk_is_number(val2))
   {
-    hk_runtime_error("type error: cannot apply `right shift` between %s and %s", hk_type_name(val1.type),
-      hk_type_name(val2.type));
+    hk_runtime_error("type error: cannot apply `right shift` between %s and %s", hk_type_name(hk_type(val1)),
+      hk_type_name(hk_type(val2)));
     return HK_STATUS_ERROR;
   }
   int64_t data = ((int64_t) hk_as_number(val1)) >> ((int64_t) hk_as_number(val2));
@@ -1024,7 +1176,7 @@ static inline int32_t do_add(hk_state_t *state)
   {
     if (!hk_is_number(val2))
     {
-      hk_runtime_error("type error: cannot add %s to number", hk_type_name(val2.type));
+      hk_runtime_error("type error: cannot add %s to number", hk_type_name(hk_type(val2)));
       return HK_STATUS_ERROR;
     }
     double data = hk_as_number(val1) + hk_as_number(val2);
@@ -1037,7 +1189,7 @@ static inline int32_t do_add(hk_state_t *state)
     if (!hk_is_string(val2))
     {
       hk_runtime_error("type error: cannot concatenate string and %s",
-        hk_type_name(val2.type));
+        hk_type_name(hk_type(val2)));
       return HK_STATUS_ERROR;
     }
     return concat_strings(state, slots, val1, val2);
@@ -1047,13 +1199,13 @@ static inline int32_t do_add(hk_state_t *state)
     if (!hk_is_array(val2))
     {
       hk_runtime_error("type error: cannot concatenate array and %s",
-        hk_type_name(val2.type));
+        hk_type_name(hk_type(val2)));
       return HK_STATUS_ERROR;
     }
     return concat_arrays(state, slots, val1, val2);
   }
-  hk_runtime_error("type error: cannot add %s to %s", hk_type_name(val2.type),
-    hk_type_name(val1.type));
+  hk_runtime_error("type error: cannot add %s to %s", hk_type_name(hk_type(val2)),
+    hk_type_name(hk_type(val1)));
   return HK_STATUS_ERROR;
 }
 
@@ -1074,20 +1226,25 @@ static inline int32_t concat_strings(hk_state_t *state, hk_value_t *slots, hk_va
     hk_string_release(str2);
     return HK_STATUS_OK;
   }
+  if (str1->length > INT32_MAX - 1 - str2->length)
+  {
+    hk_runtime_error("string too long");
+    return HK_STATUS_ERROR;
+  }
   if (str1->ref_count == 1)
   {
     hk_string_inplace_concat(str1, str2);
     --state->stack_top;
     hk_string_release(str2);
-    return HK_STATUS_OK;
+    return check_memory();
   }
-  hk_string_t *result = hk_string_concat(str1, str2);
+  hk_string_t *result = hk_string_rope(str1, str2);
   hk_incr_ref(result);
   slots[0] = hk_string_value(result);
   --state->stack_top;
   hk_string_release(str1);
   hk_string_release(str2);
-  return HK_STATUS_OK;
+  return check_memory();
 }
 
 static inline int32_t concat_arrays(hk_state_t *state, hk_value_t *slots, hk_value_t val1, hk_value_t val2)
@@ -1112,7 +1269,7 @@ static inline int32_t concat_arrays(hk_state_t *state, hk_value_t *slots, hk_val
     hk_array_inplace_concat(arr1, arr2);
     --state->stack_top;
     hk_array_release(arr2);
-    return HK_STATUS_OK;
+    return check_memory();
   }
   hk_array_t *result = hk_array_concat(arr1, arr2);
   hk_incr_ref(result);
@@ -1120,7 +1277,7 @@ static inline int32_t concat_arrays(hk_state_t *state, hk_value_t *slots, hk_val
   --state->stack_top;
   hk_array_release(arr1);
   hk_array_release(arr2);
-  return HK_STATUS_OK;
+  return check_memory();
 }
 
 static inline int32_t do_subtract(hk_state_t *state)
@@ -1133,7 +1290,7 @@ static inline int32_t do_subtract(hk_state_t *state)
     if (!hk_is_number(val2))
     {
       hk_runtime_error("type error: cannot subtract %s from number",
-        hk_type_name(val2.type));
+        hk_type_name(hk_type(val2)));
       return HK_STATUS_ERROR;
     }
     double data = hk_as_number(val1) - hk_as_number(val2);
@@ -1146,13 +1303,13 @@ static inline int32_t do_subtract(hk_state_t *state)
     if (!hk_is_array(val2))
     {
       hk_runtime_error("type error: cannot diff between array and %s",
-        hk_type_name(val2.type));
+        hk_type_name(hk_type(val2)));
       return HK_STATUS_ERROR;
     }
     return diff_arrays(state, slots, val1, val2);
   }
-  hk_runtime_error("type error: cannot subtract %s from %s", hk_type_name(val2.type),
-    hk_type_name(val1.type));
+  hk_runtime_error("type error: cannot subtract %s from %s", hk_type_name(hk_type(val2)),
+    hk_type_name(hk_type(val1)));
   return HK_STATUS_ERROR;
 }
 
@@ -1189,8 +1346,8 @@ static inline int32_t do_multiply(hk_state_t *state)
   hk_value_t val2 = slots[1];
   if (!hk_is_number(val1) || !hk_is_number(val2))
   {
-    hk_runtime_error("type error: cannot multiply %s to %s", hk_type_name(val2.type),
-      hk_type_name(val1.type));
+    hk_runtime_error("type error: cannot multiply %s to %s", hk_type_name(hk_type(val2)),
+      hk_type_name(hk_type(val1)));
     return HK_STATUS_ERROR;
   }
   double data = hk_as_number(val1) * hk_as_number(val2);
@@ -1206,8 +1363,8 @@ static inline int32_t do_divide(hk_state_t *state)
   hk_value_t val2 = slots[1];
   if (!hk_is_number(val1) || !hk_is_number(val2))
   {
-    hk_runtime_error("type error: cannot divide %s by %s", hk_type_name(val1.type),
-      hk_type_name(val2.type));
+    hk_runtime_error("type error: cannot divide %s by %s", hk_type_name(hk_type(val1)),
+      hk_type_name(hk_type(val2)));
     return HK_STATUS_ERROR;
   }
   double data = hk_as_number(val1) / hk_as_number(val2);
@@ -1224,7 +1381,7 @@ static inline int32_t do_quotient(hk_state_t *state)
   if (!hk_is_number(val1) || !hk_is_number(val2))
   {
     hk_runtime_error("type error: cannot apply `quotient` between %s and %s",
-      hk_type_name(val1.type), hk_type_name(val2.type));
+      hk_type_name(hk_type(val1)), hk_type_name(hk_type(val2)));
     return HK_STATUS_ERROR;
   }
   double data = floor(hk_as_number(val1) / hk_as_number(val2));
@@ -1241,7 +1398,7 @@ static inline int32_t do_remainder(hk_state_t *state)
   if (!hk_is_number(val1) || !hk_is_number(val2))
   {
     hk_runtime_error("type error: cannot apply `remainder` between %s and %s",
-      hk_type_name(val1.type), hk_type_name(val2.type));
+      hk_type_name(hk_type(val1)), hk_type_name(hk_type(val2)));
     return HK_STATUS_ERROR;
   }
   double data = fmod(hk_as_number(val1), hk_as_number(val2));
@@ -1256,7 +1413,7 @@ static inline int32_t do_negate(hk_state_t *state)
   hk_value_t val = slots[0];
   if (!hk_is_number(val))
   {
-    hk_runtime_error("type error: cannot apply `negate` to %s", hk_type_name(val.type));
+    hk_runtime_error("type error: cannot apply `negate` to %s", hk_type_name(hk_type(val)));
     return HK_STATUS_ERROR;
   }
   double data = -hk_as_number(val);
@@ -1278,7 +1435,7 @@ static inline int32_t do_bitwise_not(hk_state_t *state)
   hk_value_t val = slots[0];
   if (!hk_is_number(val))
   {
-    hk_runtime_error("type error: cannot apply `bitwise not` to %s", hk_type_name(val.type));
+    hk_runtime_error("type error: cannot apply `bitwise not` to %s", hk_type_name(hk_type(val)));
     return HK_STATUS_ERROR;
   }
   int64_t data = ~((int64_t) hk_as_number(val));
@@ -1293,10 +1450,10 @@ static inline int32_t do_increment(hk_state_t *state)
   if (!hk_is_number(val))
   {
     hk_runtime_error("type error: cannot increment value of type %s",
-      hk_type_name(val.type));
+      hk_type_name(hk_type(val)));
     return HK_STATUS_ERROR;
   }
-  ++slots[0].as.number_value;
+  slots[0] = hk_number_value(hk_as_number(val) + 1);
   return HK_STATUS_OK;
 }
 
@@ -1307,74 +1464,121 @@ static inline int32_t do_decrement(hk_state_t *state)
   if (!hk_is_number(val))
   {
     hk_runtime_error("type error: cannot decrement value of type %s",
-      hk_type_name(val.type));
+      hk_type_name(hk_type(val)));
+    return HK_STATUS_ERROR;
+  }
+  slots[0] = hk_number_value(hk_as_number(val) - 1);
+  return HK_STATUS_OK;
+}
+
+static inline int32_t do_increment_local(hk_value_t *slot)
+{
+  hk_value_t val = *slot;
+  if (!hk_is_number(val))
+  {
+    hk_runtime_error("type error: cannot increment value of type %s",
+      hk_type_name(hk_type(val)));
+    return HK_STATUS_ERROR;
+  }
+  *slot = hk_number_value(hk_as_number(val) + 1);
+  return HK_STATUS_OK;
+}
+
+static inline int32_t do_decrement_local(hk_value_t *slot)
+{
+  hk_value_t val = *slot;
+  if (!hk_is_number(val))
+  {
+    hk_runtime_error("type error: cannot decrement value of type %s",
+      hk_type_name(hk_type(val)));
     return HK_STATUS_ERROR;
   }
-  --slots[0].as.number_value;
+  *slot = hk_number_value(hk_as_number(val) - 1);
   return HK_STATUS_OK;
 }
 
 static inline int32_t do_call(hk_state_t *state, int32_t num_args)
 {
-  hk_value_t *slots = &state->stack[state->stack_top - num_args];
-  hk_value_t val = slots[0];
+  int32_t base = state->stack_top - num_args;
+  hk_value_t val = state->stack[base];
   if (!hk_is_callable(val))
   {
     hk_runtime_error("type error: cannot call value of type %s",
-      hk_type_name(val.type));
-    discard_frame(state, slots);
+      hk_type_name(hk_type(val)));
+    discard_frame(state, &state->stack[base]);
     return HK_STATUS_ERROR;
   }
   if (hk_is_native(val))
   {
     hk_native_t *native = hk_as_native(val);
-    if (adjust_call_args(state, native->arity, num_args) == HK_STATUS_ERROR)
+    if (reserve_native(state, native, num_args) == HK_STATUS_ERROR)
     {
-      discard_frame(state, slots);
+      discard_frame(state, &state->stack[base]);
       return HK_STATUS_ERROR;
     }
+    adjust_call_args(state, native->arity, num_args);
+    flatten_args(&state->stack[base + 1], state->stack_top - base);
     int32_t status;
-    if ((status = native->call(state, slots)) != HK_STATUS_OK)
+    if ((status = native->call(state, &state->stack[base])) != HK_STATUS_OK
+      || (status = check_memory()) != HK_STATUS_OK)
     {
-      if (status != HK_STATUS_NO_TRACE)
+      if (status != HK_STATUS_NO_TRACE && is_traced(state->frames_top))
         print_trace(native->name, NULL, 0);
-      discard_frame(state, slots);
+      discard_frame(state, &state->stack[base]);
       return HK_STATUS_ERROR;
     }
     hk_native_release(native);
-    move_result(state, slots);
+    move_result(state, &state->stack[base]);
     return HK_STATUS_OK;
   }
   hk_closure_t *cl = hk_as_closure(val);
-  hk_function_t *fn = cl->fn;
-  if (adjust_call_args(state, fn->arity, num_args) == HK_STATUS_ERROR)
+  if (reserve_function(state, cl->fn, num_args) == HK_STATUS_ERROR)
   {
-    discard_frame(state, slots);
+    discard_frame(state, &state->stack[base]);
     return HK_STATUS_ERROR;
   }
-  int32_t line;
-  if (call_function(state, slots, cl, &line) == HK_STATUS_ERROR)
+  adjust_call_args(state, cl->fn->arity, num_args);
+  if (check_memory() == HK_STATUS_ERROR)
   {
-    print_trace(fn->name, fn->file, line);
-    discard_frame(state, slots);
+    discard_frame(state, &state->stack[base]);
     return HK_STATUS_ERROR;
   }
-  hk_closure_release(cl);
-  move_result(state, slots);
-  return HK_STATUS_OK;
+  gc_poll();
+  push_frame(state, cl, base);
+  return call_function(state);
 }
 
-static inline int32_t adjust_call_args(hk_state_t *state, int32_t arity,int32_t num_args)
+static inline int32_t reserve_native(hk_state_t *state, hk_native_t *native, int32_t num_args)
+{
+  int32_t size = HK_STACK_NATIVE_CAPACITY;
+  if (native->arity > num_args)
+    size += native->arity - num_args;
+  return reserve(state, size);
+}
+
+static inline void flatten_args(hk_value_t *args, int32_t length)
+{
+  for (int32_t i = 0; i < length; ++i)
+  {
+    hk_value_t val = args[i];
+    if (hk_is_string(val) && !hk_as_string(val)->chars)
+      hk_string_flatten(hk_as_string(val));
+  }
+}
+
+static inline int32_t reserve_function(hk_state_t *state, hk_function_t *fn, int32_t num_args)
+{
+  int32_t used = num_args < fn->arity ? num_args : fn->arity;
+  return reserve(state, fn->max_stack - used - 1);
+}
+
+static inline void adjust_call_args(hk_state_t *state, int32_t arity, int32_t num_args)
 {
-  if (num_args >= arity)
-    return HK_STATUS_OK;
   while (num_args < arity)
   {
-    if (push(state, HK_NIL_VALUE) == HK_STATUS_ERROR)
-      return HK_STATUS_ERROR;
+    push(state, HK_NIL_VALUE);
     ++num_args;
   }
-  return HK_STATUS_OK;
 }
 
 static inline void print_trace(hk_string_t *name, hk_string_t *file, int32_t line)
@@ -1388,109 +1592,300 @@ static inline void print_trace(hk_string_t *name, hk_string_t *file, int32_t lin
   fprintf(stderr, "  at %s() in <native>\n", name_chars);
 }
 
-static inline int32_t call_function(hk_state_t *state, hk_value_t *locals, hk_closure_t *cl, int32_t *line)
+static inline bool is_traced(int32_t index)
+{
+  return trace_top == -1 || trace_top - index < TRACE_HEAD_FRAMES || index < TRACE_TAIL_FRAMES;
+}
+
+static inline void print_frame_trace(hk_function_t *fn, int32_t offset)
 {
-  hk_value_t *slots = state->stack;
-  hk_function_t *fn = cl->fn;
-  hk_value_t *nonlocals = cl->nonlocals;
   hk_chunk_t *chunk = &fn->chunk;
-  uint8_t *code = chunk->code;
-  hk_value_t *consts = chunk->consts->elements;
-  hk_function_t **functions = fn->functions;
-  uint8_t *pc = code;
+  for (int32_t i = 0; i < chunk->inlines_length; ++i)
+  {
+    hk_inline_t *inl = &chunk->inlines[i];
+    if (offset > inl->start && offset <= inl->end)
+      print_trace(inl->name, fn->file, inl->line);
+  }
+  print_trace(fn->name, fn->file, hk_chunk_get_line(chunk, offset));
+}
+
+static inline void push_frame(hk_state_t *state, hk_closure_t *cl, int32_t base)
+{
+  if (state->frames_top == state->frames_end)
+  {
+    int32_t capacity = (state->frames_end + 1) << 1;
+    state->frames_end = capacity - 1;
+    state->frames = (hk_frame_t *) hk_reallocate(state->frames,
+      sizeof(*state->frames) * capacity);
+  }
+  hk_frame_t *frame = &state->frames[++state->frames_top];
+  frame->cl = cl;
+  frame->pc = cl->fn->chunk.code;
+  frame->base = base;
+}
+
+static inline void reuse_frame(hk_state_t *state, hk_frame_t *frame, hk_closure_t *cl,
+  int32_t base)
+{
+  hk_value_t *slots = &state->stack[frame->base];
+  int32_t length = state->stack_top - base + 1;
+  hk_closure_release(frame->cl);
+  for (int32_t i = frame->base + 1; i < base; ++i)
+    hk_value_release(state->stack[i]);
+  memmove(slots, &state->stack[base], sizeof(*slots) * length);
+  state->stack_top = frame->base + length - 1;
+  frame->cl = cl;
+  frame->pc = cl->fn->chunk.code;
+}
+
+#ifdef HK_COMPUTED_GOTO
+  #pragma GCC diagnostic push
+  #pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+static inline int32_t call_function(hk_state_t *state)
+{
+#ifdef HK_COMPUTED_GOTO
+  static const void *labels[] = {
+    [HK_OP_NIL] = &&label_HK_OP_NIL,
+    [HK_OP_FALSE] = &&label_HK_OP_FALSE,
+    [HK_OP_TRUE] = &&label_HK_OP_TRUE,
+    [HK_OP_INT] = &&label_HK_OP_INT,
+    [HK_OP_CONSTANT] = &&label_HK_OP_CONSTANT,
+    [HK_OP_RANGE] = &&label_HK_OP_RANGE,
+    [HK_OP_ARRAY] = &&label_HK_OP_ARRAY,
+    [HK_OP_STRUCT] = &&label_HK_OP_STRUCT,
+    [HK_OP_INSTANCE] = &&label_HK_OP_INSTANCE,
+    [HK_OP_CONSTRUCT] = &&label_HK_OP_CONSTRUCT,
+    [HK_OP_ITERATOR] = &&label_HK_OP_ITERATOR,
+    [HK_OP_CLOSURE] = &&label_HK_OP_CLOSURE,
+    [HK_OP_UNPACK_ARRAY] = &&label_HK_OP_UNPACK_ARRAY,
+    [HK_OP_UNPACK_STRUCT] = &&label_HK_OP_UNPACK_STRUCT,
+    [HK_OP_POP] = &&label_HK_OP_POP,
+    [HK_OP_GLOBAL] = &&label_HK_OP_GLOBAL,
+    [HK_OP_NONLOCAL] = &&label_HK_OP_NONLOCAL,
+    [HK_OP_LOAD] = &&label_HK_OP_LOAD,
+    [HK_OP_STORE] = &&label_HK_OP_STORE,
+    [HK_OP_ADD_ELEMENT] = &&label_HK_OP_ADD_ELEMENT,
+    [HK_OP_GET_ELEMENT] = &&label_HK_OP_GET_ELEMENT,
+    [HK_OP_FETCH_ELEMENT] = &&label_HK_OP_FETCH_ELEMENT,
+    [HK_OP_SET_ELEMENT] = &&label_HK_OP_SET_ELEMENT,
+    [HK_OP_PUT_ELEMENT] = &&label_HK_OP_PUT_ELEMENT,
+    [HK_OP_DELETE_ELEMENT] = &&label_HK_OP_DELETE_ELEMENT,
+    [HK_OP_INPLACE_ADD_ELEMENT] = &&label_HK_OP_INPLACE_ADD_ELEMENT,
+    [HK_OP_INPLACE_PUT_ELEMENT] = &&label_HK_OP_INPLACE_PUT_ELEMENT,
+    [HK_OP_INPLACE_DELETE_ELEMENT] = &&label_HK_OP_INPLACE_DELETE_ELEMENT,
+    [HK_OP_GET_FIELD] = &&label_HK_OP_GET_FIELD,
+    [HK_OP_FETCH_FIELD] = &&label_HK_OP_FETCH_FIELD,
+    [HK_OP_SET_FIELD] = &&label_HK_OP_SET_FIELD,
+    [HK_OP_PUT_FIELD] = &&label_HK_OP_PUT_FIELD,
+    [HK_OP_INPLACE_PUT_FIELD] = &&label_HK_OP_INPLACE_PUT_FIELD,
+    [HK_OP_CURRENT] = &&label_HK_OP_CURRENT,
+    [HK_OP_JUMP] = &&label_HK_OP_JUMP,
+    [HK_OP_JUMP_IF_FALSE] = &&label_HK_OP_JUMP_IF_FALSE,
+    [HK_OP_JUMP_IF_TRUE] = &&label_HK_OP_JUMP_IF_TRUE,
+    [HK_OP_JUMP_IF_TRUE_OR_POP] = &&label_HK_OP_JUMP_IF_TRUE_OR_POP,
+    [HK_OP_JUMP_IF_FALSE_OR_POP] = &&label_HK_OP_JUMP_IF_FALSE_OR_POP,
+    [HK_OP_JUMP_IF_NOT_EQUAL] = &&label_HK_OP_JUMP_IF_NOT_EQUAL,
+    [HK_OP_JUMP_IF_NOT_VALID] = &&label_HK_OP_JUMP_IF_NOT_VALID,
+    [HK_OP_NEXT] = &&label_HK_OP_NEXT,
+    [HK_OP_EQUAL] = &&label_HK_OP_EQUAL,
+    [HK_OP_GREATER] = &&label_HK_OP_GREATER,
+    [HK_OP_LESS] = &&label_HK_OP_LESS,
+    [HK_OP_NOT_EQUAL] = &&label_HK_OP_NOT_EQUAL,
+    [HK_OP_NOT_GREATER] = &&label_HK_OP_NOT_GREATER,
+    [HK_OP_NOT_LESS] = &&label_HK_OP_NOT_LESS,
+    [HK_OP_BITWISE_OR] = &&label_HK_OP_BITWISE_OR,
+    [HK_OP_BITWISE_XOR] = &&label_HK_OP_BITWISE_XOR,
+    [HK_OP_BITWISE_AND] = &&label_HK_OP_BITWISE_AND,
+    [HK_OP_LEFT_SHIFT] = &&label_HK_OP_LEFT_SHIFT,
+    [HK_OP_RIGHT_SHIFT] = &&label_HK_OP_RIGHT_SHIFT,
+    [HK_OP_ADD] = &&label_HK_OP_ADD,
+    [HK_OP_SUBTRACT] = &&label_HK_OP_SUBTRACT,
+    [HK_OP_MULTIPLY] = &&label_HK_OP_MULTIPLY,
+    [HK_OP_DIVIDE] = &&label_HK_OP_DIVIDE,
+    [HK_OP_QUOTIENT] = &&label_HK_OP_QUOTIENT,
+    [HK_OP_REMAINDER] = &&label_HK_OP_REMAINDER,
+    [HK_OP_NEGATE] = &&label_HK_OP_NEGATE,
+    [HK_OP_NOT] = &&label_HK_OP_NOT,
+    [HK_OP_BITWISE_NOT] = &&label_HK_OP_BITWISE_NOT,
+    [HK_OP_INCREMENT] = &&label_HK_OP_INCREMENT,
+    [HK_OP_DECREMENT] = &&label_HK_OP_DECREMENT,
+    [HK_OP_CALL] = &&label_HK_OP_CALL,
+    [HK_OP_LOAD_MODULE] = &&label_HK_OP_LOAD_MODULE,
+    [HK_OP_RETURN] = &&label_HK_OP_RETURN,
+    [HK_OP_RETURN_NIL] = &&label_HK_OP_RETURN_NIL,
+    [HK_OP_LOAD_LOAD] = &&label_HK_OP_LOAD_LOAD,
+    [HK_OP_INCREMENT_LOCAL] = &&label_HK_OP_INCREMENT_LOCAL,
+    [HK_OP_DECREMENT_LOCAL] = &&label_HK_OP_DECREMENT_LOCAL,
+    [HK_OP_JUMP_IF_NOT_LESS] = &&label_HK_OP_JUMP_IF_NOT_LESS,
+    [HK_OP_GREATER_NUM] = &&label_HK_OP_GREATER_NUM,
+    [HK_OP_LESS_NUM] = &&label_HK_OP_LESS_NUM,
+    [HK_OP_NOT_GREATER_NUM] = &&label_HK_OP_NOT_GREATER_NUM,
+    [HK_OP_NOT_LESS_NUM] = &&label_HK_OP_NOT_LESS_NUM,
+    [HK_OP_ADD_NUM] = &&label_HK_OP_ADD_NUM,
+    [HK_OP_SUBTRACT_NUM] = &&label_HK_OP_SUBTRACT_NUM,
+    [HK_OP_MULTIPLY_NUM] = &&label_HK_OP_MULTIPLY_NUM,
+    [HK_OP_DIVIDE_NUM] = &&label_HK_OP_DIVIDE_NUM,
+    [HK_OP_TAIL_CALL] = &&label_HK_OP_TAIL_CALL,
+    [HK_OP_RANGE_LOOP] = &&label_HK_OP_RANGE_LOOP,
+    [HK_OP_RANGE_STEP] = &&label_HK_OP_RANGE_STEP,
+    [HK_OP_MOVE] = &&label_HK_OP_MOVE,
+    [HK_OP_LOAD_ELEMENT] = &&label_HK_OP_LOAD_ELEMENT,
+    [HK_OP_LOAD_FIELD] = &&label_HK_OP_LOAD_FIELD,
+    [HK_OP_NONLOCAL_ELEMENT] = &&label_HK_OP_NONLOCAL_ELEMENT,
+    [HK_OP_NONLOCAL_FIELD] = &&label_HK_OP_NONLOCAL_FIELD,
+    [HK_OP_GREATER_UNCHECKED] = &&label_HK_OP_GREATER_UNCHECKED,
+    [HK_OP_LESS_UNCHECKED] = &&label_HK_OP_LESS_UNCHECKED,
+    [HK_OP_NOT_GREATER_UNCHECKED] = &&label_HK_OP_NOT_GREATER_UNCHECKED,
+    [HK_OP_NOT_LESS_UNCHECKED] = &&label_HK_OP_NOT_LESS_UNCHECKED,
+    [HK_OP_ADD_UNCHECKED] = &&label_HK_OP_ADD_UNCHECKED,
+    [HK_OP_SUBTRACT_UNCHECKED] = &&label_HK_OP_SUBTRACT_UNCHECKED,
+    [HK_OP_MULTIPLY_UNCHECKED] = &&label_HK_OP_MULTIPLY_UNCHECKED,
+    [HK_OP_DIVIDE_UNCHECKED] = &&label_HK_OP_DIVIDE_UNCHECKED,
+    [HK_OP_INCREMENT_NUM] = &&label_HK_OP_INCREMENT_NUM,
+    [HK_OP_DECREMENT_NUM] = &&label_HK_OP_DECREMENT_NUM,
+    [HK_OP_WIDE] = &&label_HK_OP_WIDE
+  };
+#endif
+  int32_t entry = state->frames_top;
+  hk_value_t *slots;
+  hk_value_t *locals;
+  hk_value_t *nonlocals;
+  hk_value_t *consts;
+  hk_field_cache_t *caches;
+  hk_function_t **functions;
+  uint8_t *code;
+  uint8_t *pc;
+enter:
+  {
+    hk_frame_t *frame = &state->frames[state->frames_top];
+    hk_closure_t *cl = frame->cl;
+    hk_function_t *fn = cl->fn;
+    slots = state->stack;
+    locals = &slots[frame->base];
+    nonlocals = cl->nonlocals;
+    consts = fn->chunk.consts->elements;
+    caches = fn->chunk.caches;
+    functions = fn->functions;
+    code = fn->chunk.code;
+    pc = frame->pc;
+#ifdef HK_JIT
+    if (pc == code && jit_ready(fn))
+    {
+      ++jit_depth;
+      int32_t status = fn->jit_code(state);
+      --jit_depth;
+      frame = &state->frames[state->frames_top];
+      slots = state->stack;
+      locals = &slots[frame->base];
+      if (status == HK_STATUS_OK)
+        goto leave;
+      pc = frame->pc;
+      if (status == HK_STATUS_ERROR)
+        goto error;
+    }
+#endif
+  }
   for (;;)
   {
-    hk_opcode_t op = (hk_opcode_t) read_byte(&pc);
-    switch (op)
+#ifdef HK_COMPUTED_GOTO
+    next();
+#else
+    switch ((hk_opcode_t) read_byte(&pc))
+#endif
     {
-    case HK_OP_NIL:
-      if (push(state, HK_NIL_VALUE) == HK_STATUS_ERROR)
-        goto error;
-      break;
-    case HK_OP_FALSE:
-      if (push(state, HK_FALSE_VALUE) == HK_STATUS_ERROR)
-        goto error;
-      break;
-    case HK_OP_TRUE:
-      if (push(state, HK_TRUE_VALUE) == HK_STATUS_ERROR)
-        goto error;
-      break;
-    case HK_OP_INT:
-      if (push(state, hk_number_value(read_word(&pc))) == HK_STATUS_ERROR)
-        goto error;
-      break;
-    case HK_OP_CONSTANT:
+    instruction(HK_OP_NIL):
+      push(state, HK_NIL_VALUE);
+      next();
+    instruction(HK_OP_FALSE):
+      push(state, HK_FALSE_VALUE);
+      next();
+    instruction(HK_OP_TRUE):
+      push(state, HK_TRUE_VALUE);
+      next();
+    instruction(HK_OP_INT):
+      push(state, hk_number_value(read_word(&pc)));
+      next();
+    instruction(HK_OP_CONSTANT):
       {
         hk_value_t val = consts[read_byte(&pc)];
-        if (push(state, val) == HK_STATUS_ERROR)
-          goto error;
+        push(state, val);
         hk_value_incr_ref(val);
       }
-      break;
-    case HK_OP_RANGE:
+      next();
+    instruction(HK_OP_RANGE):
       if (do_range(state) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_ARRAY:
-      if (do_array(state, read_byte(&pc)) == HK_STATUS_ERROR)
+      next();
+    instruction(HK_OP_RANGE_LOOP):
+      if (do_range_loop(state) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_STRUCT:
+      next();
+    instruction(HK_OP_ARRAY):
+      do_array(state, read_byte(&pc));
+      next();
+    instruction(HK_OP_STRUCT):
       if (do_struct(state, read_byte(&pc)) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_INSTANCE:
+      next();
+    instruction(HK_OP_INSTANCE):
       if (do_instance(state, read_byte(&pc)) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_CONSTRUCT:
+      slots = state->stack;
+      locals = &slots[state->frames[state->frames_top].base];
+      next();
+    instruction(HK_OP_CONSTRUCT):
       if (do_construct(state, read_byte(&pc)) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_ITERATOR:
+      next();
+    instruction(HK_OP_ITERATOR):
       if (do_iterator(state) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_CLOSURE:
-      if (do_closure(state, functions[read_byte(&pc)]) == HK_STATUS_ERROR)
-        goto error;
-      break;
-    case HK_OP_UNPACK_ARRAY:
+      next();
+    instruction(HK_OP_CLOSURE):
+      do_closure(state, functions[read_byte(&pc)]);
+      next();
+    instruction(HK_OP_UNPACK_ARRAY):
       if (do_unpack_array(state, read_byte(&pc)) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_UNPACK_STRUCT:
+      next();
+    instruction(HK_OP_UNPACK_STRUCT):
       if (do_unpack_struct(state, read_byte(&pc)) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_POP:
+      next();
+    instruction(HK_OP_POP):
       hk_value_release(slots[state->stack_top--]);
-      break;
-    case HK_OP_GLOBAL:
+      next();
+    instruction(HK_OP_GLOBAL):
       {
         hk_value_t val = slots[read_byte(&pc)];
-        if (push(state, val) == HK_STATUS_ERROR)
-          goto error;
+        push(state, val);
         hk_value_incr_ref(val);
       }
-      break;
-    case HK_OP_NONLOCAL:
+      next();
+    instruction(HK_OP_NONLOCAL):
       {
         hk_value_t val = nonlocals[read_byte(&pc)];
-        if (push(state, val) == HK_STATUS_ERROR)
-          goto error;
+        push(state, val);
         hk_value_incr_ref(val);
       }
-      break;
-    case HK_OP_LOAD:
+      next();
+    instruction(HK_OP_LOAD):
       {
         hk_value_t val = locals[read_byte(&pc)];
-        if (push(state, val) == HK_STATUS_ERROR)
-          goto error;
+        push(state, val);
         hk_value_incr_ref(val);
       }
-      break;
-    case HK_OP_STORE:
+      next();
+    instruction(HK_OP_MOVE):
+      {
+        int32_t index = read_byte(&pc);
+        push(state, locals[index]);
+        locals[index] = HK_NIL_VALUE;
+      }
+      next();
+    instruction(HK_OP_STORE):
       {
         int32_t index = read_byte(&pc);
         hk_value_t val = slots[state->stack_top];
@@ -1498,68 +1893,164 @@ static inline int32_t call_function(hk_state_t *state, hk_value_t *locals, hk_cl
         hk_value_release(locals[index]);
         locals[index] = val;
       }
-      break;
-    case HK_OP_ADD_ELEMENT:
+      next();
+    instruction(HK_OP_ADD_ELEMENT):
       if (do_add_element(state) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_GET_ELEMENT:
+      next();
+    instruction(HK_OP_LOAD_ELEMENT):
+      {
+        hk_value_t val1 = locals[read_byte(&pc)];
+        hk_value_t val2 = locals[read_byte(&pc)];
+        if (do_load_element(state, val1, val2) == HK_STATUS_ERROR)
+          goto error;
+      }
+      next();
+    instruction(HK_OP_NONLOCAL_ELEMENT):
+      {
+        hk_value_t val1 = nonlocals[read_byte(&pc)];
+        hk_value_t val2 = locals[read_byte(&pc)];
+        if (do_load_element(state, val1, val2) == HK_STATUS_ERROR)
+          goto error;
+      }
+      next();
+    instruction(HK_OP_GET_ELEMENT):
       if (do_get_element(state) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_FETCH_ELEMENT:
+      next();
+    instruction(HK_OP_FETCH_ELEMENT):
       if (do_fetch_element(state) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_SET_ELEMENT:
+      next();
+    instruction(HK_OP_SET_ELEMENT):
       do_set_element(state);
-      break;
-    case HK_OP_PUT_ELEMENT:
+      next();
+    instruction(HK_OP_PUT_ELEMENT):
       if (do_put_element(state) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_DELETE_ELEMENT:
+      next();
+    instruction(HK_OP_DELETE_ELEMENT):
       if (do_delete_element(state) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_INPLACE_ADD_ELEMENT:
+      next();
+    instruction(HK_OP_INPLACE_ADD_ELEMENT):
       if (do_inplace_add_element(state) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_INPLACE_PUT_ELEMENT:
+      next();
+    instruction(HK_OP_INPLACE_PUT_ELEMENT):
       if (do_inplace_put_element(state) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_INPLACE_DELETE_ELEMENT:
+      next();
+    instruction(HK_OP_INPLACE_DELETE_ELEMENT):
       if (do_inplace_delete_element(state) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_GET_FIELD:
-      if (do_get_field(state, hk_as_string(consts[read_byte(&pc)])) == HK_STATUS_ERROR)
-        goto error;
-      break;
-    case HK_OP_FETCH_FIELD:
-      if (do_fetch_field(state, hk_as_string(consts[read_byte(&pc)])) == HK_STATUS_ERROR)
-        goto error;
-      break;
-    case HK_OP_SET_FIELD:
+      next();
+    instruction(HK_OP_GET_FIELD):
+      {
+        hk_string_t *name = hk_as_string(consts[read_byte(&pc)]);
+        if (do_get_field(state, name, &caches[read_word(&pc)]) == HK_STATUS_ERROR)
+          goto error;
+      }
+      next();
+    instruction(HK_OP_LOAD_FIELD):
+      {
+        hk_value_t val = locals[read_byte(&pc)];
+        hk_string_t *name = hk_as_string(consts[read_byte(&pc)]);
+        if (do_load_field(state, val, name, &caches[read_word(&pc)]) == HK_STATUS_ERROR)
+          goto error;
+      }
+      next();
+    instruction(HK_OP_NONLOCAL_FIELD):
+      {
+        hk_value_t val = nonlocals[read_byte(&pc)];
+        hk_string_t *name = hk_as_string(consts[read_byte(&pc)]);
+        if (do_load_field(state, val, name, &caches[read_word(&pc)]) == HK_STATUS_ERROR)
+          goto error;
+      }
+      next();
+    instruction(HK_OP_FETCH_FIELD):
+      {
+        hk_string_t *name = hk_as_string(consts[read_byte(&pc)]);
+        if (do_fetch_field(state, name, &caches[read_word(&pc)]) == HK_STATUS_ERROR)
+          goto error;
+      }
+      next();
+    instruction(HK_OP_SET_FIELD):
       do_set_field(state);
-      break;
-    case HK_OP_PUT_FIELD:
-      if (do_put_field(state, hk_as_string(consts[read_byte(&pc)])) == HK_STATUS_ERROR)
-        goto error;
-      break;
-    case HK_OP_INPLACE_PUT_FIELD:
-      if (do_inplace_put_field(state, hk_as_string(consts[read_byte(&pc)])) == HK_STATUS_ERROR)
-        goto error;
-      break;
-    case HK_OP_CURRENT:
+      next();
+    instruction(HK_OP_PUT_FIELD):
+      {
+        hk_string_t *name = hk_as_string(consts[read_byte(&pc)]);
+        if (do_put_field(state, name, &caches[read_word(&pc)]) == HK_STATUS_ERROR)
+          goto error;
+      }
+      next();
+    instruction(HK_OP_INPLACE_PUT_FIELD):
+      {
+        hk_string_t *name = hk_as_string(consts[read_byte(&pc)]);
+        if (do_inplace_put_field(state, name, &caches[read_word(&pc)]) == HK_STATUS_ERROR)
+          goto error;
+      }
+      next();
+    instruction(HK_OP_WIDE):
+      {
+        hk_opcode_t op = (hk_opcode_t) read_byte(&pc);
+        int32_t index = read_word(&pc);
+        switch (op)
+        {
+        case HK_OP_CONSTANT:
+          {
+            hk_value_t val = consts[index];
+            push(state, val);
+            hk_value_incr_ref(val);
+          }
+          break;
+        case HK_OP_CLOSURE:
+          do_closure(state, functions[index]);
+          break;
+        case HK_OP_LOAD:
+          {
+            hk_value_t val = locals[index];
+            push(state, val);
+            hk_value_incr_ref(val);
+          }
+          break;
+        case HK_OP_STORE:
+          {
+            hk_value_t val = slots[state->stack_top];
+            --state->stack_top;
+            hk_value_release(locals[index]);
+            locals[index] = val;
+          }
+          break;
+        case HK_OP_GET_FIELD:
+          if (do_get_field(state, hk_as_string(consts[index]), &caches[read_word(&pc)]) == HK_STATUS_ERROR)
+            goto error;
+          break;
+        case HK_OP_FETCH_FIELD:
+          if (do_fetch_field(state, hk_as_string(consts[index]), &caches[read_word(&pc)]) == HK_STATUS_ERROR)
+            goto error;
+          break;
+        case HK_OP_PUT_FIELD:
+          if (do_put_field(state, hk_as_string(consts[index]), &caches[read_word(&pc)]) == HK_STATUS_ERROR)
+            goto error;
+          break;
+        case HK_OP_INPLACE_PUT_FIELD:
+          if (do_inplace_put_field(state, hk_as_string(consts[index]), &caches[read_word(&pc)]) == HK_STATUS_ERROR)
+            goto error;
+          break;
+        default:
+          break;
+        }
+      }
+      next();
+    instruction(HK_OP_CURRENT):
       do_current(state);
-      break;
-    case HK_OP_JUMP:
+      next();
+    instruction(HK_OP_JUMP):
       pc = &code[read_word(&pc)];
-      break;
-    case HK_OP_JUMP_IF_FALSE:
+      next();
+    instruction(HK_OP_JUMP_IF_FALSE):
       {
         int32_t offset = read_word(&pc);
         hk_value_t val = slots[state->stack_top];
@@ -1568,8 +2059,8 @@ static inline int32_t call_function(hk_state_t *state, hk_value_t *locals, hk_cl
         hk_value_release(val);
         --state->stack_top;
       }
-      break;
-    case HK_OP_JUMP_IF_TRUE:
+      next();
+    instruction(HK_OP_JUMP_IF_TRUE):
       {
         int32_t offset = read_word(&pc);
         hk_value_t val = slots[state->stack_top];
@@ -1578,34 +2069,34 @@ static inline int32_t call_function(hk_state_t *state, hk_value_t *locals, hk_cl
         hk_value_release(val);
         --state->stack_top;
       }
-      break;
-    case HK_OP_JUMP_IF_TRUE_OR_POP:
+      next();
+    instruction(HK_OP_JUMP_IF_TRUE_OR_POP):
       {
         int32_t offset = read_word(&pc);
         hk_value_t val = slots[state->stack_top];
         if (hk_is_truthy(val))
         {
           pc = &code[offset];
-          break;
+          next();
         }
         hk_value_release(val);
         --state->stack_top;
       }
-      break;
-    case HK_OP_JUMP_IF_FALSE_OR_POP:
+      next();
+    instruction(HK_OP_JUMP_IF_FALSE_OR_POP):
       {
         int32_t offset = read_word(&pc);
         hk_value_t val = slots[state->stack_top];
         if (hk_is_falsey(val))
         {
           pc = &code[offset];
-          break;
+          next();
         }
         hk_value_release(val);
         --state->stack_top;
       }
-      break;
-    case HK_OP_JUMP_IF_NOT_EQUAL:
+      next();
+    instruction(HK_OP_JUMP_IF_NOT_EQUAL):
       {
         int32_t offset = read_word(&pc);
         hk_value_t val1 = slots[state->stack_top - 1];
@@ -1615,14 +2106,14 @@ static inline int32_t call_function(hk_state_t *state, hk_value_t *locals, hk_cl
           hk_value_release(val1);
           hk_value_release(val2);
           state->stack_top -= 2;
-          break;
+          next();
         }
         pc = &code[offset];
         hk_value_release(val2);
         --state->stack_top;
       }
-      break;
-    case HK_OP_JUMP_IF_NOT_VALID:
+      next();
+    instruction(HK_OP_JUMP_IF_NOT_VALID):
       {
         int32_t offset = read_word(&pc);
         hk_value_t val = slots[state->stack_top];
@@ -1630,116 +2121,451 @@ static inline int32_t call_function(hk_state_t *state, hk_value_t *locals, hk_cl
         if (!hk_iterator_is_valid(it))
           pc = &code[offset];
       }
-      break;
-    case HK_OP_NEXT:
+      next();
+    instruction(HK_OP_NEXT):
       do_next(state);
-      break;
-    case HK_OP_EQUAL:
+      next();
+    instruction(HK_OP_RANGE_STEP):
+      {
+        int32_t offset = read_word(&pc);
+        hk_value_t *range = &slots[state->stack_top - 2];
+        double step = hk_as_number(range[2]);
+        double current = hk_as_number(range[0]) + step;
+        range[0] = hk_number_value(current);
+        if (step > 0 ? current > hk_as_number(range[1]) : current < hk_as_number(range[1]))
+          pc = &code[offset];
+      }
+      next();
+    instruction(HK_OP_EQUAL):
       do_equal(state);
-      break;
-    case HK_OP_GREATER:
+      next();
+    instruction(HK_OP_GREATER):
+      if (are_numbers(state))
+        pc[-1] = HK_OP_GREATER_NUM;
       if (do_greater(state) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_LESS:
+      next();
+    instruction(HK_OP_GREATER_NUM):
+      {
+        hk_value_t val1 = slots[state->stack_top - 1];
+        hk_value_t val2 = slots[state->stack_top];
+        if (!hk_is_number(val1) || !hk_is_number(val2))
+        {
+          pc[-1] = HK_OP_GREATER;
+          if (do_greater(state) == HK_STATUS_ERROR)
+            goto error;
+          next();
+        }
+        --state->stack_top;
+        slots[state->stack_top] = hk_as_number(val1) > hk_as_number(val2) ? HK_TRUE_VALUE : HK_FALSE_VALUE;
+      }
+      next();
+    instruction(HK_OP_GREATER_UNCHECKED):
+      {
+        hk_value_t val1 = slots[state->stack_top - 1];
+        hk_value_t val2 = slots[state->stack_top];
+        --state->stack_top;
+        slots[state->stack_top] = hk_as_number(val1) > hk_as_number(val2) ? HK_TRUE_VALUE : HK_FALSE_VALUE;
+      }
+      next();
+    instruction(HK_OP_LESS):
+      if (are_numbers(state))
+        pc[-1] = HK_OP_LESS_NUM;
       if (do_less(state) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_NOT_EQUAL:
+      next();
+    instruction(HK_OP_LESS_NUM):
+      {
+        hk_value_t val1 = slots[state->stack_top - 1];
+        hk_value_t val2 = slots[state->stack_top];
+        if (!hk_is_number(val1) || !hk_is_number(val2))
+        {
+          pc[-1] = HK_OP_LESS;
+          if (do_less(state) == HK_STATUS_ERROR)
+            goto error;
+          next();
+        }
+        --state->stack_top;
+        slots[state->stack_top] = hk_as_number(val1) < hk_as_number(val2) ? HK_TRUE_VALUE : HK_FALSE_VALUE;
+      }
+      next();
+    instruction(HK_OP_LESS_UNCHECKED):
+      {
+        hk_value_t val1 = slots[state->stack_top - 1];
+        hk_value_t val2 = slots[state->stack_top];
+        --state->stack_top;
+        slots[state->stack_top] = hk_as_number(val1) < hk_as_number(val2) ? HK_TRUE_VALUE : HK_FALSE_VALUE;
+      }
+      next();
+    instruction(HK_OP_NOT_EQUAL):
       do_not_equal(state);
-      break;
-    case HK_OP_NOT_GREATER:
+      next();
+    instruction(HK_OP_NOT_GREATER):
+      if (are_numbers(state))
+        pc[-1] = HK_OP_NOT_GREATER_NUM;
       if (do_not_greater(state) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_NOT_LESS:
+      next();
+    instruction(HK_OP_NOT_GREATER_NUM):
+      {
+        hk_value_t val1 = slots[state->stack_top - 1];
+        hk_value_t val2 = slots[state->stack_top];
+        if (!hk_is_number(val1) || !hk_is_number(val2))
+        {
+          pc[-1] = HK_OP_NOT_GREATER;
+          if (do_not_greater(state) == HK_STATUS_ERROR)
+            goto error;
+          next();
+        }
+        --state->stack_top;
+        slots[state->stack_top] = !(hk_as_number(val1) > hk_as_number(val2)) ? HK_TRUE_VALUE : HK_FALSE_VALUE;
+      }
+      next();
+    instruction(HK_OP_NOT_GREATER_UNCHECKED):
+      {
+        hk_value_t val1 = slots[state->stack_top - 1];
+        hk_value_t val2 = slots[state->stack_top];
+        --state->stack_top;
+        slots[state->stack_top] = !(hk_as_number(val1) > hk_as_number(val2)) ? HK_TRUE_VALUE : HK_FALSE_VALUE;
+      }
+      next();
+    instruction(HK_OP_NOT_LESS):
+      if (are_numbers(state))
+        pc[-1] = HK_OP_NOT_LESS_NUM;
       if (do_not_less(state) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_BITWISE_OR:
+      next();
+    instruction(HK_OP_NOT_LESS_NUM):
+      {
+        hk_value_t val1 = slots[state->stack_top - 1];
+        hk_value_t val2 = slots[state->stack_top];
+        if (!hk_is_number(val1) || !hk_is_number(val2))
+        {
+          pc[-1] = HK_OP_NOT_LESS;
+          if (do_not_less(state) == HK_STATUS_ERROR)
+            goto error;
+          next();
+        }
+        --state->stack_top;
+        slots[state->stack_top] = !(hk_as_number(val1) < hk_as_number(val2)) ? HK_TRUE_VALUE : HK_FALSE_VALUE;
+      }
+      next();
+    instruction(HK_OP_NOT_LESS_UNCHECKED):
+      {
+        hk_value_t val1 = slots[state->stack_top - 1];
+        hk_value_t val2 = slots[state->stack_top];
+        --state->stack_top;
+        slots[state->stack_top] = !(hk_as_number(val1) < hk_as_number(val2)) ? HK_TRUE_VALUE : HK_FALSE_VALUE;
+      }
+      next();
+    instruction(HK_OP_BITWISE_OR):
       if (do_bitwise_or(state) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_BITWISE_XOR:
+      next();
+    instruction(HK_OP_BITWISE_XOR):
       if (do_bitwise_xor(state) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_BITWISE_AND:
+      next();
+    instruction(HK_OP_BITWISE_AND):
       if (do_bitwise_and(state) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_LEFT_SHIFT:
+      next();
+    instruction(HK_OP_LEFT_SHIFT):
       if (do_left_shift(state) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_RIGHT_SHIFT:
+      next();
+    instruction(HK_OP_RIGHT_SHIFT):
       if (do_right_shift(state) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_ADD:
+      next();
+    instruction(HK_OP_ADD):
+      if (are_numbers(state))
+        pc[-1] = HK_OP_ADD_NUM;
       if (do_add(state) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_SUBTRACT:
+      next();
+    instruction(HK_OP_ADD_NUM):
+      {
+        hk_value_t val1 = slots[state->stack_top - 1];
+        hk_value_t val2 = slots[state->stack_top];
+        if (!hk_is_number(val1) || !hk_is_number(val2))
+        {
+          pc[-1] = HK_OP_ADD;
+          if (do_add(state) == HK_STATUS_ERROR)
+            goto error;
+          next();
+        }
+        --state->stack_top;
+        slots[state->stack_top] = hk_number_value(hk_as_number(val1) + hk_as_number(val2));
+      }
+      next();
+    instruction(HK_OP_ADD_UNCHECKED):
+      {
+        hk_value_t val1 = slots[state->stack_top - 1];
+        hk_value_t val2 = slots[state->stack_top];
+        --state->stack_top;
+        slots[state->stack_top] = hk_number_value(hk_as_number(val1) + hk_as_number(val2));
+      }
+      next();
+    instruction(HK_OP_SUBTRACT):
+      if (are_numbers(state))
+        pc[-1] = HK_OP_SUBTRACT_NUM;
       if (do_subtract(state) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_MULTIPLY:
+      next();
+    instruction(HK_OP_SUBTRACT_NUM):
+      {
+        hk_value_t val1 = slots[state->stack_top - 1];
+        hk_value_t val2 = slots[state->stack_top];
+        if (!hk_is_number(val1) || !hk_is_number(val2))
+        {
+          pc[-1] = HK_OP_SUBTRACT;
+          if (do_subtract(state) == HK_STATUS_ERROR)
+            goto error;
+          next();
+        }
+        --state->stack_top;
+        slots[state->stack_top] = hk_number_value(hk_as_number(val1) - hk_as_number(val2));
+      }
+      next();
+    instruction(HK_OP_SUBTRACT_UNCHECKED):
+      {
+        hk_value_t val1 = slots[state->stack_top - 1];
+        hk_value_t val2 = slots[state->stack_top];
+        --state->stack_top;
+        slots[state->stack_top] = hk_number_value(hk_as_number(val1) - hk_as_number(val2));
+      }
+      next();
+    instruction(HK_OP_MULTIPLY):
+      if (are_numbers(state))
+        pc[-1] = HK_OP_MULTIPLY_NUM;
       if (do_multiply(state) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_DIVIDE:
+      next();
+    instruction(HK_OP_MULTIPLY_NUM):
+      {
+        hk_value_t val1 = slots[state->stack_top - 1];
+        hk_value_t val2 = slots[state->stack_top];
+        if (!hk_is_number(val1) || !hk_is_number(val2))
+        {
+          pc[-1] = HK_OP_MULTIPLY;
+          if (do_multiply(state) == HK_STATUS_ERROR)
+            goto error;
+          next();
+        }
+        --state->stack_top;
+        slots[state->stack_top] = hk_number_value(hk_as_number(val1) * hk_as_number(val2));
+      }
+      next();
+    instruction(HK_OP_MULTIPLY_UNCHECKED):
+      {
+        hk_value_t val1 = slots[state->stack_top - 1];
+        hk_value_t val2 = slots[state->stack_top];
+        --state->stack_top;
+        slots[state->stack_top] = hk_number_value(hk_as_number(val1) * hk_as_number(val2));
+      }
+      next();
+    instruction(HK_OP_DIVIDE):
+      if (are_numbers(state))
+        pc[-1] = HK_OP_DIVIDE_NUM;
       if (do_divide(state) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_QUOTIENT:
+      next();
+    instruction(HK_OP_DIVIDE_NUM):
+      {
+        hk_value_t val1 = slots[state->stack_top - 1];
+        hk_value_t val2 = slots[state->stack_top];
+        if (!hk_is_number(val1) || !hk_is_number(val2))
+        {
+          pc[-1] = HK_OP_DIVIDE;
+          if (do_divide(state) == HK_STATUS_ERROR)
+            goto error;
+          next();
+        }
+        --state->stack_top;
+        slots[state->stack_top] = hk_number_value(hk_as_number(val1) / hk_as_number(val2));
+      }
+      next();
+    instruction(HK_OP_DIVIDE_UNCHECKED):
+      {
+        hk_value_t val1 = slots[state->stack_top - 1];
+        hk_value_t val2 = slots[state->stack_top];
+        --state->stack_top;
+        slots[state->stack_top] = hk_number_value(hk_as_number(val1) / hk_as_number(val2));
+      }
+      next();
+    instruction(HK_OP_QUOTIENT):
       if (do_quotient(state) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_REMAINDER:
+      next();
+    instruction(HK_OP_REMAINDER):
       if (do_remainder(state) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_NEGATE:
+      next();
+    instruction(HK_OP_NEGATE):
       if (do_negate(state) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_NOT:
+      next();
+    instruction(HK_OP_NOT):
       do_not(state);
-      break;
-    case HK_OP_BITWISE_NOT:
+      next();
+    instruction(HK_OP_BITWISE_NOT):
       if (do_bitwise_not(state) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_INCREMENT:
+      next();
+    instruction(HK_OP_INCREMENT):
       if (do_increment(state) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_DECREMENT:
+      next();
+    instruction(HK_OP_DECREMENT):
       if (do_decrement(state) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_CALL:
-      if (do_call(state, read_byte(&pc)) == HK_STATUS_ERROR)
-        goto error;
-      break;
-    case HK_OP_LOAD_MODULE:
+      next();
+    instruction(HK_OP_CALL):
+      {
+        int32_t num_args = read_byte(&pc);
+        int32_t base = state->stack_top - num_args;
+        hk_value_t val = slots[base];
+        if (!hk_is_callable(val) || hk_is_native(val))
+        {
+          if (do_call(state, num_args) == HK_STATUS_ERROR)
+            goto error;
+          slots = state->stack;
+          locals = &slots[state->frames[state->frames_top].base];
+          next();
+        }
+        hk_closure_t *callee = hk_as_closure(val);
+        if (reserve_function(state, callee->fn, num_args) == HK_STATUS_ERROR)
+        {
+          discard_frame(state, &state->stack[base]);
+          goto error;
+        }
+        adjust_call_args(state, callee->fn->arity, num_args);
+        state->frames[state->frames_top].pc = pc;
+        push_frame(state, callee, base);
+        goto enter;
+      }
+    instruction(HK_OP_TAIL_CALL):
+      {
+        int32_t num_args = read_byte(&pc);
+        int32_t base = state->stack_top - num_args;
+        hk_value_t val = slots[base];
+        if (!hk_is_callable(val) || hk_is_native(val))
+        {
+          if (do_call(state, num_args) == HK_STATUS_ERROR)
+            goto error;
+          slots = state->stack;
+          locals = &slots[state->frames[state->frames_top].base];
+          next();
+        }
+        hk_closure_t *callee = hk_as_closure(val);
+        if (reserve_function(state, callee->fn, num_args) == HK_STATUS_ERROR)
+        {
+          discard_frame(state, &state->stack[base]);
+          goto error;
+        }
+        adjust_call_args(state, callee->fn->arity, num_args);
+        hk_frame_t *frame = &state->frames[state->frames_top];
+        reuse_frame(state, frame, callee, base);
+        goto enter;
+      }
+    instruction(HK_OP_LOAD_MODULE):
       if (load_module(state) == HK_STATUS_ERROR)
         goto error;
-      break;
-    case HK_OP_RETURN:
-      return HK_STATUS_OK;
-    case HK_OP_RETURN_NIL:
-      if (push(state, HK_NIL_VALUE) == HK_STATUS_ERROR)
+      slots = state->stack;
+      locals = &slots[state->frames[state->frames_top].base];
+      next();
+    instruction(HK_OP_RETURN):
+      goto leave;
+    instruction(HK_OP_RETURN_NIL):
+      push(state, HK_NIL_VALUE);
+      goto leave;
+    instruction(HK_OP_LOAD_LOAD):
+      {
+        hk_value_t val1 = locals[read_byte(&pc)];
+        hk_value_t val2 = locals[read_byte(&pc)];
+        push(state, val1);
+        hk_value_incr_ref(val1);
+        push(state, val2);
+        hk_value_incr_ref(val2);
+      }
+      next();
+    instruction(HK_OP_INCREMENT_LOCAL):
+      if (do_increment_local(&locals[read_byte(&pc)]) == HK_STATUS_ERROR)
         goto error;
-      return HK_STATUS_OK;
+      next();
+    instruction(HK_OP_DECREMENT_LOCAL):
+      if (do_decrement_local(&locals[read_byte(&pc)]) == HK_STATUS_ERROR)
+        goto error;
+      next();
+    instruction(HK_OP_INCREMENT_NUM):
+      {
+        hk_value_t *slot = &locals[read_byte(&pc)];
+        *slot = hk_number_value(hk_as_number(*slot) + 1);
+      }
+      next();
+    instruction(HK_OP_DECREMENT_NUM):
+      {
+        hk_value_t *slot = &locals[read_byte(&pc)];
+        *slot = hk_number_value(hk_as_number(*slot) - 1);
+      }
+      next();
+    instruction(HK_OP_JUMP_IF_NOT_LESS):
+      {
+        int32_t offset = read_word(&pc);
+        hk_value_t val1 = slots[state->stack_top - 1];
+        hk_value_t val2 = slots[state->stack_top];
+        if (hk_is_number(val1) && hk_is_number(val2))
+        {
+          state->stack_top -= 2;
+          if (!(hk_as_number(val1) < hk_as_number(val2)))
+            pc = &code[offset];
+          next();
+        }
+        if (do_less(state) == HK_STATUS_ERROR)
+          goto error;
+        hk_value_t val = slots[state->stack_top];
+        if (hk_is_falsey(val))
+          pc = &code[offset];
+        hk_value_release(val);
+        --state->stack_top;
+      }
+      next();
     }
   }
+leave:
+  hk_closure_release(state->frames[state->frames_top].cl);
+  move_result(state, locals);
+  if (state->frames_top-- == entry)
+    return HK_STATUS_OK;
+  goto enter;
 error:
-  *line = hk_chunk_get_line(chunk, (int32_t) (pc - code));
-  return HK_STATUS_ERROR;
+  state->frames[state->frames_top].pc = pc;
+  slots = state->stack;
+  if (trace_top == -1)
+    trace_top = state->frames_top;
+  for (;;)
+  {
+    hk_frame_t *frame = &state->frames[state->frames_top];
+    hk_function_t *fn = frame->cl->fn;
+    if (is_traced(state->frames_top))
+      print_frame_trace(fn, (int32_t) (frame->pc - fn->chunk.code));
+    else if (trace_top - state->frames_top == TRACE_HEAD_FRAMES)
+      fprintf(stderr, "  ... %d frames omitted\n", trace_top + 1 - TRACE_HEAD_FRAMES - TRACE_TAIL_FRAMES);
+    discard_frame(state, &slots[frame->base]);
+    if (state->frames_top-- == entry)
+    {
+      if (state->frames_top == -1)
+        trace_top = -1;
+      return HK_STATUS_ERROR;
+    }
+  }
 }
 
+#ifdef HK_COMPUTED_GOTO
+  #pragma GCC diagnostic pop
+#endif
+
 static inline void discard_frame(hk_state_t *state, hk_value_t *slots)
 {
   while (&state->stack[state->stack_top] >= slots)
@@ -1754,29 +2580,275 @@ static inline void move_result(hk_state_t *state, hk_value_t *slots)
     hk_value_release(state->stack[state->stack_top--]);
 }
 
+#ifdef HK_JIT
+static inline bool jit_ready(hk_function_t *fn)
+{
+  if (jit_depth == JIT_MAX_DEPTH)
+    return false;
+  if (fn->jit_code)
+    return true;
+  return jit_enabled && ++fn->num_calls == JIT_CALL_THRESHOLD && jit_compile(fn);
+}
+
+int32_t jit_step(hk_state_t *state, uint8_t *pc)
+{
+  hk_frame_t *frame = &state->frames[state->frames_top];
+  hk_function_t *fn = frame->cl->fn;
+  hk_value_t *consts = fn->chunk.consts->elements;
+  hk_field_cache_t *caches = fn->chunk.caches;
+  hk_value_t *locals = &state->stack[frame->base];
+  switch ((hk_opcode_t) read_byte(&pc))
+  {
+  case HK_OP_RANGE:
+    return do_range(state);
+  case HK_OP_RANGE_LOOP:
+    return do_range_loop(state);
+  case HK_OP_ARRAY:
+    do_array(state, read_byte(&pc));
+    break;
+  case HK_OP_STRUCT:
+    return do_struct(state, read_byte(&pc));
+  case HK_OP_INSTANCE:
+    return do_instance(state, read_byte(&pc));
+  case HK_OP_CONSTRUCT:
+    return do_construct(state, read_byte(&pc));
+  case HK_OP_ITERATOR:
+    return do_iterator(state);
+  case HK_OP_CLOSURE:
+    do_closure(state, fn->functions[read_byte(&pc)]);
+    break;
+  case HK_OP_UNPACK_ARRAY:
+    return do_unpack_array(state, read_byte(&pc));
+  case HK_OP_UNPACK_STRUCT:
+    return do_unpack_struct(state, read_byte(&pc));
+  case HK_OP_ADD_ELEMENT:
+    return do_add_element(state);
+  case HK_OP_GET_ELEMENT:
+    return do_get_element(state);
+  case HK_OP_LOAD_ELEMENT:
+    {
+      hk_value_t val1 = locals[read_byte(&pc)];
+      hk_value_t val2 = locals[read_byte(&pc)];
+      return do_load_element(state, val1, val2);
+    }
+  case HK_OP_NONLOCAL_ELEMENT:
+    {
+      hk_value_t val1 = frame->cl->nonlocals[read_byte(&pc)];
+      hk_value_t val2 = locals[read_byte(&pc)];
+      return do_load_element(state, val1, val2);
+    }
+  case HK_OP_FETCH_ELEMENT:
+    return do_fetch_element(state);
+  case HK_OP_SET_ELEMENT:
+    do_set_element(state);
+    break;
+  case HK_OP_PUT_ELEMENT:
+    return do_put_element(state);
+  case HK_OP_DELETE_ELEMENT:
+    return do_delete_element(state);
+  case HK_OP_INPLACE_ADD_ELEMENT:
+    return do_inplace_add_element(state);
+  case HK_OP_INPLACE_PUT_ELEMENT:
+    return do_inplace_put_element(state);
+  case HK_OP_INPLACE_DELETE_ELEMENT:
+    return do_inplace_delete_element(state);
+  case HK_OP_GET_FIELD:
+    {
+      hk_string_t *name = hk_as_string(consts[read_byte(&pc)]);
+      return do_get_field(state, name, &caches[read_word(&pc)]);
+    }
+  case HK_OP_LOAD_FIELD:
+    {
+      hk_value_t val = locals[read_byte(&pc)];
+      hk_string_t *name = hk_as_string(consts[read_byte(&pc)]);
+      return do_load_field(state, val, name, &caches[read_word(&pc)]);
+    }
+  case HK_OP_NONLOCAL_FIELD:
+    {
+      hk_value_t val = frame->cl->nonlocals[read_byte(&pc)];
+      hk_string_t *name = hk_as_string(consts[read_byte(&pc)]);
+      return do_load_field(state, val, name, &caches[read_word(&pc)]);
+    }
+  case HK_OP_FETCH_FIELD:
+    {
+      hk_string_t *name = hk_as_string(consts[read_byte(&pc)]);
+      return do_fetch_field(state, name, &caches[read_word(&pc)]);
+    }
+  case HK_OP_SET_FIELD:
+    do_set_field(state);
+    break;
+  case HK_OP_PUT_FIELD:
+    {
+      hk_string_t *name = hk_as_string(consts[read_byte(&pc)]);
+      return do_put_field(state, name, &caches[read_word(&pc)]);
+    }
+  case HK_OP_INPLACE_PUT_FIELD:
+    {
+      hk_string_t *name = hk_as_string(consts[read_byte(&pc)]);
+      return do_inplace_put_field(state, name, &caches[read_word(&pc)]);
+    }
+  case HK_OP_CURRENT:
+    do_current(state);
+    break;
+  case HK_OP_NEXT:
+    do_next(state);
+    break;
+  case HK_OP_EQUAL:
+    do_equal(state);
+    break;
+  case HK_OP_GREATER:
+  case HK_OP_GREATER_NUM:
+  case HK_OP_GREATER_UNCHECKED:
+    return do_greater(state);
+  case HK_OP_LESS:
+  case HK_OP_LESS_NUM:
+  case HK_OP_LESS_UNCHECKED:
+  case HK_OP_JUMP_IF_NOT_LESS:
+    return do_less(state);
+  case HK_OP_NOT_EQUAL:
+    do_not_equal(state);
+    break;
+  case HK_OP_NOT_GREATER:
+  case HK_OP_NOT_GREATER_NUM:
+  case HK_OP_NOT_GREATER_UNCHECKED:
+    return do_not_greater(state);
+  case HK_OP_NOT_LESS:
+  case HK_OP_NOT_LESS_NUM:
+  case HK_OP_NOT_LESS_UNCHECKED:
+    return do_not_less(state);
+  case HK_OP_BITWISE_OR:
+    return do_bitwise_or(state);
+  case HK_OP_BITWISE_XOR:
+    return do_bitwise_xor(state);
+  case HK_OP_BITWISE_AND:
+    return do_bitwise_and(state);
+  case HK_OP_LEFT_SHIFT:
+    return do_left_shift(state);
+  case HK_OP_RIGHT_SHIFT:
+    return do_right_shift(state);
+  case HK_OP_ADD:
+  case HK_OP_ADD_NUM:
+  case HK_OP_ADD_UNCHECKED:
+    return do_add(state);
+  case HK_OP_SUBTRACT:
+  case HK_OP_SUBTRACT_NUM:
+  case HK_OP_SUBTRACT_UNCHECKED:
+    return do_subtract(state);
+  case HK_OP_MULTIPLY:
+  case HK_OP_MULTIPLY_NUM:
+  case HK_OP_MULTIPLY_UNCHECKED:
+    return do_multiply(state);
+  case HK_OP_DIVIDE:
+  case HK_OP_DIVIDE_NUM:
+  case HK_OP_DIVIDE_UNCHECKED:
+    return do_divide(state);
+  case HK_OP_QUOTIENT:
+    return do_quotient(state);
+  case HK_OP_REMAINDER:
+    return do_remainder(state);
+  case HK_OP_NEGATE:
+    return do_negate(state);
+  case HK_OP_NOT:
+    do_not(state);
+    break;
+  case HK_OP_BITWISE_NOT:
+    return do_bitwise_not(state);
+  case HK_OP_INCREMENT:
+    return do_increment(state);
+  case HK_OP_DECREMENT:
+    return do_decrement(state);
+  case HK_OP_INCREMENT_LOCAL:
+  case HK_OP_INCREMENT_NUM:
+    return do_increment_local(&locals[read_byte(&pc)]);
+  case HK_OP_DECREMENT_LOCAL:
+  case HK_OP_DECREMENT_NUM:
+    return do_decrement_local(&locals[read_byte(&pc)]);
+  case HK_OP_CALL:
+  case HK_OP_TAIL_CALL:
+    return do_call(state, read_byte(&pc));
+  case HK_OP_LOAD_MODULE:
+    return load_module(state);
+  case HK_OP_WIDE:
+    {
+      hk_opcode_t op = (hk_opcode_t) read_byte(&pc);
+      int32_t index = read_word(&pc);
+      switch (op)
+      {
+      case HK_OP_CONSTANT:
+        push(state, consts[index]);
+        hk_value_incr_ref(consts[index]);
+        break;
+      case HK_OP_CLOSURE:
+        do_closure(state, fn->functions[index]);
+        break;
+      case HK_OP_LOAD:
+        push(state, locals[index]);
+        hk_value_incr_ref(locals[index]);
+        break;
+      case HK_OP_STORE:
+        {
+          hk_value_t val = state->stack[state->stack_top];
+          --state->stack_top;
+          hk_value_release(locals[index]);
+          locals[index] = val;
+        }
+        break;
+      case HK_OP_GET_FIELD:
+        return do_get_field(state, hk_as_string(consts[index]), &caches[read_word(&pc)]);
+      case HK_OP_FETCH_FIELD:
+        return do_fetch_field(state, hk_as_string(consts[index]), &caches[read_word(&pc)]);
+      case HK_OP_PUT_FIELD:
+        return do_put_field(state, hk_as_string(consts[index]), &caches[read_word(&pc)]);
+      case HK_OP_INPLACE_PUT_FIELD:
+        return do_inplace_put_field(state, hk_as_string(consts[index]), &caches[read_word(&pc)]);
+      default:
+        break;
+      }
+    }
+    break;
+  default:
+    break;
+  }
+  return HK_STATUS_OK;
+}
+#endif
+
 void hk_state_init(hk_state_t *state, int32_t min_capacity)
 {
   int32_t capacity = min_capacity < HK_STACK_MIN_CAPACITY ? HK_STACK_MIN_CAPACITY : min_capacity;
   capacity = hk_power_of_two_ceil(capacity);
+  state->stack_limit = capacity < HK_STACK_MAX_CAPACITY ? HK_STACK_MAX_CAPACITY : capacity;
   state->stack_end = capacity - 1;
   state->stack_top = -1;
   state->stack = (hk_value_t *) hk_allocate(sizeof(*state->stack) * capacity);
+  state->frames_end = HK_FRAMES_MIN_CAPACITY - 1;
+  state->frames_top = -1;
+  state->frames = (hk_frame_t *) hk_allocate(sizeof(*state->frames) * HK_FRAMES_MIN_CAPACITY);
+  state->num_inplace_next = 0;
+  state->num_copying_next = 0;
   load_globals(state);
   init_module_cache();
 }
 
+void hk_state_set_stack_limit(hk_state_t *state, int32_t max_capacity)
+{
+  int32_t capacity = state->stack_end + 1;
+  state->stack_limit = max_capacity < capacity ? capacity : max_capacity;
+}
+
 void hk_state_free(hk_state_t *state)
 {
   free_module_cache();
   hk_assert(state->stack_top == num_globals() - 1, "stack must contain the globals");
   while (state->stack_top > -1)
     hk_value_release(state->stack[state->stack_top--]);
-  free(state->stack);
+  hk_free(state->stack);
+  hk_free(state->frames);
 }
 
 int32_t hk_state_push(hk_state_t *state, hk_value_t val)
 {
-  if (push(state, val) == HK_STATUS_ERROR)
+  if (push_or_grow(state, val) == HK_STATUS_ERROR)
     return HK_STATUS_ERROR;
   hk_value_incr_ref(val);
   return HK_STATUS_OK;
@@ -1784,22 +2856,22 @@ int32_t hk_state_push(hk_state_t *state, hk_value_t val)
 
 int32_t hk_state_push_nil(hk_state_t *state)
 {
-  return push(state, HK_NIL_VALUE);
+  return push_or_grow(state, HK_NIL_VALUE);
 }
 
 int32_t hk_state_push_bool(hk_state_t *state, bool data)
 {
-  return push(state, data ? HK_TRUE_VALUE : HK_FALSE_VALUE);
+  return push_or_grow(state, data ? HK_TRUE_VALUE : HK_FALSE_VALUE);
 }
 
 int32_t hk_state_push_number(hk_state_t *state, double data)
 {
-  return push(state, hk_number_value(data));
+  return push_or_grow(state, hk_number_value(data));
 }
 
 int32_t hk_state_push_string(hk_state_t *state, hk_string_t *str)
 {
-  if (push(state, hk_string_value(str)) == HK_STATUS_ERROR)
+  if (push_or_grow(state, hk_string_value(str)) == HK_STATUS_ERROR)
     return HK_STATUS_ERROR;
   hk_incr_ref(str);
   return HK_STATUS_OK;
@@ -1829,7 +2901,7 @@ int32_t hk_state_push_string_from_stream(hk_state_t *state, FILE *stream, const
 
 int32_t hk_state_push_range(hk_state_t *state, hk_range_t *range)
 {
-  if (push(state, hk_range_value(range)) == HK_STATUS_ERROR)
+  if (push_or_grow(state, hk_range_value(range)) == HK_STATUS_ERROR)
     return HK_STATUS_ERROR;
   hk_incr_ref(range);
   return HK_STATUS_OK;
@@ -1837,7 +2909,7 @@ int32_t hk_state_push_range(hk_state_t *state, hk_range_t *range)
 
 int32_t hk_state_push_array(hk_state_t *state, hk_array_t *arr)
 {
-  if (push(state, hk_array_value(arr)) == HK_STATUS_ERROR)
+  if (push_or_grow(state, hk_array_value(arr)) == HK_STATUS_ERROR)
     return HK_STATUS_ERROR;
   hk_incr_ref(arr);
   return HK_STATUS_OK;
@@ -1845,7 +2917,7 @@ int32_t hk_state_push_array(hk_state_t *state, hk_array_t *arr)
 
 int32_t hk_state_push_struct(hk_state_t *state, hk_struct_t *ztruct)
 {
-  if (push(state, hk_struct_value(ztruct)) == HK_STATUS_ERROR)
+  if (push_or_grow(state, hk_struct_value(ztruct)) == HK_STATUS_ERROR)
     return HK_STATUS_ERROR;
   hk_incr_ref(ztruct);
   return HK_STATUS_OK;
@@ -1853,7 +2925,7 @@ int32_t hk_state_push_struct(hk_state_t *state, hk_struct_t *ztruct)
 
 int32_t hk_state_push_instance(hk_state_t *state, hk_instance_t *inst)
 {
-  if (push(state, hk_instance_value(inst)) == HK_STATUS_ERROR)
+  if (push_or_grow(state, hk_instance_value(inst)) == HK_STATUS_ERROR)
     return HK_STATUS_ERROR;
   hk_incr_ref(inst);
   return HK_STATUS_OK;
@@ -1861,7 +2933,7 @@ int32_t hk_state_push_instance(hk_state_t *state, hk_instance_t *inst)
 
 int32_t hk_state_push_iterator(hk_state_t *state, hk_iterator_t *it)
 {
-  if (push(state, hk_iterator_value(it)) == HK_STATUS_ERROR)
+  if (push_or_grow(state, hk_iterator_value(it)) == HK_STATUS_ERROR)
     return HK_STATUS_ERROR;
   hk_incr_ref(it);
   return HK_STATUS_OK;
@@ -1869,7 +2941,7 @@ int32_t hk_state_push_iterator(hk_state_t *state, hk_iterator_t *it)
 
 int32_t hk_state_push_closure(hk_state_t *state, hk_closure_t *cl)
 {
-  if (push(state, hk_closure_value(cl)) == HK_STATUS_ERROR)
+  if (push_or_grow(state, hk_closure_value(cl)) == HK_STATUS_ERROR)
     return HK_STATUS_ERROR;
   hk_incr_ref(cl);
   return HK_STATUS_OK;
@@ -1877,7 +2949,7 @@ int32_t hk_state_push_closure(hk_state_t *state, hk_closure_t *cl)
 
 int32_t hk_state_push_native(hk_state_t *state, hk_native_t *native)
 {
-  if (push(state, hk_native_value(native)) == HK_STATUS_ERROR)
+  if (push_or_grow(state, hk_native_value(native)) == HK_STATUS_ERROR)
     return HK_STATUS_ERROR;
   hk_incr_ref(native);
   return HK_STATUS_OK;
@@ -1896,7 +2968,7 @@ int32_t hk_state_push_new_native(hk_state_t *state, const char *name, int32_t ar
 
 int32_t hk_state_push_userdata(hk_state_t *state, hk_userdata_t *udata)
 {
-  if (push(state, hk_userdata_value(udata)) == HK_STATUS_ERROR)
+  if (push_or_grow(state, hk_userdata_value(udata)) == HK_STATUS_ERROR)
     return HK_STATUS_ERROR;
   hk_incr_ref(udata);
   return HK_STATUS_OK;
@@ -1904,7 +2976,8 @@ int32_t hk_state_push_userdata(hk_state_t *state, hk_userdata_t *udata)
 
 int32_t hk_state_array(hk_state_t *state, int32_t length)
 {
-  return do_array(state, length);
+  do_array(state, length);
+  return HK_STATUS_OK;
 }
 
 int32_t hk_state_struct(hk_state_t *state, int32_t length)
@@ -1936,13 +3009,13 @@ int32_t hk_state_compare(hk_value_t val1, hk_value_t val2, int32_t *result)
 {
   if (!hk_is_comparable(val1))
   {
-    hk_runtime_error("type error: value of type %s is not comparable", hk_type_name(val1.type));
+    hk_runtime_error("type error: value of type %s is not comparable", hk_type_name(hk_type(val1)));
     return HK_STATUS_ERROR;
   }
-  if (val1.type != val2.type)
+  if (hk_type(val1) != hk_type(val2))
   {
-    hk_runtime_error("type error: cannot compare %s and %s", hk_type_name(val1.type),
-      hk_type_name(val2.type));
+    hk_runtime_error("type error: cannot compare %s and %s", hk_type_name(hk_type(val1)),
+      hk_type_name(hk_type(val2)));
     return HK_STATUS_ERROR;
   }
   hk_assert(hk_value_compare(val1, val2, result), "hk_value_compare failed");
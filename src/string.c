@@ -11,23 +11,124 @@
 #include <hook/memory.h>
 #include <hook/utils.h>
 
+#define MIN_NODES (1 << 3)
+
+typedef struct
+{
+  int32_t capacity;
+  int32_t length;
+  hk_string_t **nodes;
+} node_stack_t;
+
+static hk_string_t **interned_strings = NULL;
+static int32_t interned_capacity = 0;
+static int32_t interned_length = 0;
+
 static inline hk_string_t *string_allocate(int32_t min_capacity);
+static inline bool is_inline(hk_string_t *str);
+static inline hk_string_t **rope_children(hk_string_t *str);
+static inline void push_node(node_stack_t *stack, hk_string_t *str);
+static inline void free_rope(hk_string_t *str);
+static inline void grow_interned_strings(void);
 static inline void add_char(hk_string_t *str, char c);
 static inline uint32_t hash(int32_t length, char *chars);
 
 static inline hk_string_t *string_allocate(int32_t min_capacity)
 {
-  hk_string_t *str = (hk_string_t *) hk_allocate(sizeof(*str));
   ++min_capacity;
   int32_t capacity = min_capacity < HK_STRING_MIN_CAPACITY ? HK_STRING_MIN_CAPACITY : min_capacity;
   capacity = hk_power_of_two_ceil(capacity);
+  hk_string_t *str;
+  if (min_capacity <= HK_STRING_INLINE_CAPACITY)
+  {
+    capacity = capacity < HK_STRING_INLINE_CAPACITY ? capacity : HK_STRING_INLINE_CAPACITY;
+    str = (hk_string_t *) hk_allocate(sizeof(*str) + capacity);
+    str->chars = (char *) &str[1];
+  }
+  else
+  {
+    str = (hk_string_t *) hk_allocate(sizeof(*str));
+    str->chars = (char *) hk_allocate(capacity);
+    hk_memory_tag(str->chars, HK_TYPE_STRING);
+  }
+  hk_memory_tag(str, HK_TYPE_STRING | HK_MEMORY_OBJECT);
   str->ref_count = 0;
   str->capacity = capacity;
-  str->chars = (char *) hk_allocate(capacity);
+  str->interned = false;
   str->hash = -1;
   return str;
 }
 
+static inline bool is_inline(hk_string_t *str)
+{
+  return str->chars == (char *) &str[1];
+}
+
+static inline hk_string_t **rope_children(hk_string_t *str)
+{
+  return (hk_string_t **) &str[1];
+}
+
+static inline void push_node(node_stack_t *stack, hk_string_t *str)
+{
+  if (stack->length == stack->capacity)
+  {
+    stack->capacity = stack->capacity ? stack->capacity << 1 : MIN_NODES;
+    stack->nodes = (hk_string_t **) hk_reallocate(stack->nodes,
+      sizeof(*stack->nodes) * stack->capacity);
+  }
+  stack->nodes[stack->length++] = str;
+}
+
+static inline void free_rope(hk_string_t *str)
+{
+  node_stack_t stack = {0, 0, NULL};
+  push_node(&stack, str);
+  while (stack.length)
+  {
+    hk_string_t *node = stack.nodes[--stack.length];
+    if (node->chars)
+    {
+      hk_string_free(node);
+      continue;
+    }
+    hk_string_t **children = rope_children(node);
+    for (int32_t i = 0; i < 2; ++i)
+    {
+      hk_string_t *child = children[i];
+      hk_decr_ref(child);
+      if (hk_is_unreachable(child))
+        push_node(&stack, child);
+    }
+    hk_free(node);
+  }
+  hk_free(stack.nodes);
+}
+
+static inline void grow_interned_strings(void)
+{
+  if (interned_length < interned_capacity - (interned_capacity >> 2))
+    return;
+  int32_t capacity = interned_capacity ? interned_capacity << 1 : HK_STRING_INTERN_CAPACITY;
+  int32_t mask = capacity - 1;
+  hk_string_t **strings = (hk_string_t **) hk_allocate(sizeof(*strings) * capacity);
+  for (int32_t i = 0; i < capacity; ++i)
+    strings[i] = NULL;
+  for (int32_t i = 0; i < interned_capacity; ++i)
+  {
+    hk_string_t *str = interned_strings[i];
+    if (!str)
+      continue;
+    int32_t j = str->hash & mask;
+    while (strings[j])
+      j = (j + 1) & mask;
+    strings[j] = str;
+  }
+  hk_free(interned_strings);
+  interned_strings = strings;
+  interned_capacity = capacity;
+}
+
 static inline void add_char(hk_string_t *str, char c)
 {
   hk_string_ensure_capacity(str, str->length + 1);
@@ -91,19 +192,59 @@ hk_string_t *hk_string_from_stream(FILE *stream, const char terminal)
   return str;
 }
 
+hk_string_t *hk_string_intern(hk_string_t *str)
+{
+  if (str->interned)
+    return str;
+  grow_interned_strings();
+  int32_t mask = interned_capacity - 1;
+  int32_t i = hk_string_hash(str) & mask;
+  for (;;)
+  {
+    hk_string_t *entry = interned_strings[i];
+    if (!entry)
+      break;
+    if (hk_string_equal(str, entry))
+      return entry;
+    i = (i + 1) & mask;
+  }
+  hk_incr_ref(str);
+  str->interned = true;
+  interned_strings[i] = str;
+  ++interned_length;
+  return str;
+}
+
 void hk_string_ensure_capacity(hk_string_t *str, int32_t min_capacity)
 {
+  if (!str->chars)
+    hk_string_flatten(str);
   if (min_capacity <= str->capacity)
     return;
   int32_t capacity = hk_power_of_two_ceil(min_capacity);
+  if (is_inline(str))
+  {
+    char *chars = (char *) hk_allocate(capacity);
+    hk_memory_tag(chars, HK_TYPE_STRING);
+    memcpy(chars, str->chars, str->capacity);
+    str->capacity = capacity;
+    str->chars = chars;
+    return;
+  }
   str->capacity = capacity;
   str->chars = (char *) hk_reallocate(str->chars, capacity);
 }
 
 void hk_string_free(hk_string_t *str)
 {
-  free(str->chars);
-  free(str);
+  if (!str->chars)
+  {
+    free_rope(str);
+    return;
+  }
+  if (!is_inline(str))
+    hk_free(str->chars);
+  hk_free(str);
 }
 
 void hk_string_release(hk_string_t *str)
@@ -117,13 +258,67 @@ hk_string_t *hk_string_concat(hk_string_t *str1, hk_string_t *str2)
 {
   int32_t length = str1->length + str2->length;
   hk_string_t *result = string_allocate(length);
-  memcpy(result->chars, str1->chars, str1->length);
-  memcpy(&result->chars[str1->length], str2->chars, str2->length);
+  memcpy(result->chars, hk_string_chars(str1), str1->length);
+  memcpy(&result->chars[str1->length], hk_string_chars(str2), str2->length);
   result->length = length;
   result->chars[length] = '\0';
   return result;
 }
 
+hk_string_t *hk_string_rope(hk_string_t *str1, hk_string_t *str2)
+{
+  int32_t length = str1->length + str2->length;
+  if (length < HK_STRING_INLINE_CAPACITY)
+    return hk_string_concat(str1, str2);
+  hk_string_t *str = (hk_string_t *) hk_allocate(sizeof(*str) + sizeof(hk_string_t *) * 2);
+  hk_memory_tag(str, HK_TYPE_STRING | HK_MEMORY_OBJECT);
+  str->ref_count = 0;
+  str->capacity = 0;
+  str->length = length;
+  str->interned = false;
+  str->chars = NULL;
+  str->hash = -1;
+  hk_string_t **children = rope_children(str);
+  hk_incr_ref(str1);
+  hk_incr_ref(str2);
+  children[0] = str1;
+  children[1] = str2;
+  return str;
+}
+
+char *hk_string_flatten(hk_string_t *str)
+{
+  if (str->chars)
+    return str->chars;
+  int32_t length = str->length;
+  int32_t capacity = hk_power_of_two_ceil(length + 1);
+  char *chars = (char *) hk_allocate(capacity);
+  hk_memory_tag(chars, HK_TYPE_STRING);
+  chars[length] = '\0';
+  node_stack_t stack = {0, 0, NULL};
+  push_node(&stack, str);
+  while (stack.length)
+  {
+    hk_string_t *node = stack.nodes[--stack.length];
+    if (node->chars)
+    {
+      length -= node->length;
+      memcpy(&chars[length], node->chars, node->length);
+      continue;
+    }
+    hk_string_t **children = rope_children(node);
+    push_node(&stack, children[0]);
+    push_node(&stack, children[1]);
+  }
+  hk_free(stack.nodes);
+  hk_string_t **children = rope_children(str);
+  hk_string_release(children[0]);
+  hk_string_release(children[1]);
+  str->capacity = capacity;
+  str->chars = chars;
+  return chars;
+}
+
 void hk_string_inplace_concat_char(hk_string_t *dest, char c)
 {
   int32_t length = dest->length;
@@ -131,6 +326,7 @@ void hk_string_inplace_concat_char(hk_string_t *dest, char c)
   dest->chars[length] = c;
   dest->chars[length + 1] = '\0';
   dest->length += 1;
+  dest->hash = -1;
 }
 
 void hk_string_inplace_concat_chars(hk_string_t *dest, int32_t length, const char *chars)
@@ -149,7 +345,7 @@ void hk_string_inplace_concat(hk_string_t *dest, hk_string_t *src)
 {
   int32_t length = dest->length + src->length;
   hk_string_ensure_capacity(dest, length + 1);
-  memcpy(&dest->chars[dest->length], src->chars, src->length);
+  memcpy(&dest->chars[dest->length], hk_string_chars(src), src->length);
   dest->length = length;
   dest->chars[length] = '\0';
   dest->hash = -1;
@@ -157,35 +353,41 @@ void hk_string_inplace_concat(hk_string_t *dest, hk_string_t *src)
 
 void hk_string_print(hk_string_t *str, bool quoted)
 {
-  printf(quoted ? "\"%.*s\"" : "%.*s", str->length, str->chars);
+  printf(quoted ? "\"%.*s\"" : "%.*s", str->length, hk_string_chars(str));
 }
 
 uint32_t hk_string_hash(hk_string_t *str)
 {
   if (str->hash == -1)
-    str->hash = hash(str->length, str->chars);
+    str->hash = hash(str->length, hk_string_chars(str));
   return (uint32_t) str->hash;
 }
 
 bool hk_string_equal(hk_string_t *str1, hk_string_t *str2)
 {
-  return str1 == str2 || (str1->length == str2->length
-    && !memcmp(str1->chars, str2->chars, str1->length));
+  if (str1 == str2)
+    return true;
+  if (str1->length != str2->length)
+    return false;
+  if (str1->hash != -1 && str2->hash != -1 && str1->hash != str2->hash)
+    return false;
+  return !memcmp(hk_string_chars(str1), hk_string_chars(str2), str1->length);
 }
 
 int32_t hk_string_compare(hk_string_t *str1, hk_string_t *str2)
 {
-  int32_t result = strcmp(str1->chars, str2->chars);
+  int32_t result = strcmp(hk_string_chars(str1), hk_string_chars(str2));
   return result > 0 ? 1 : (result < 0 ? -1 : 0);
 }
 
 hk_string_t *hk_string_lower(hk_string_t *str)
 {
   int32_t length = str->length;
+  char *chars = hk_string_chars(str);
   hk_string_t *result = string_allocate(length);
   result->length = length;
   for (int32_t i = 0; i < length; ++i)
-    result->chars[i] = (char) tolower(str->chars[i]);
+    result->chars[i] = (char) tolower(chars[i]);
   result->chars[length] = '\0';
   return result;
 }
@@ -193,10 +395,11 @@ hk_string_t *hk_string_lower(hk_string_t *str)
 hk_string_t *hk_string_upper(hk_string_t *str)
 {
   int32_t length = str->length;
+  char *chars = hk_string_chars(str);
   hk_string_t *result = string_allocate(length);
   result->length = length;
   for (int32_t i = 0; i < length; ++i)
-    result->chars[i] = (char) toupper(str->chars[i]);
+    result->chars[i] = (char) toupper(chars[i]);
   result->chars[length] = '\0';
   return result;
 }
@@ -206,19 +409,20 @@ bool hk_string_trim(hk_string_t *str, hk_string_t **result)
   int32_t length = str->length;
   if (!length)
     return false;
+  char *chars = hk_string_chars(str);
   int32_t l = 0;
-  while (isspace(str->chars[l]))
+  while (isspace(chars[l]))
     ++l;
   int32_t high = length - 1;
   int32_t h = high;
-  while (h > l && isspace(str->chars[h]))
+  while (h > l && isspace(chars[h]))
     --h;
   if (!l && h == high)
     return false;
   hk_string_t *_result = string_allocate(h - l + 1);
   int32_t j = 0;
   for (int32_t i = l; i <= h; ++i)
-    _result->chars[j++] = str->chars[i];
+    _result->chars[j++] = chars[i];
   _result->chars[j] = '\0';
   _result->length = j;
   *result = _result;
@@ -229,29 +433,32 @@ bool hk_string_starts_with(hk_string_t *str1, hk_string_t *str2)
 {
   if (!str1->length || !str2->length || str1->length < str2->length)
     return false;
-  return !memcmp(str1->chars, str2->chars, str2->length);
+  return !memcmp(hk_string_chars(str1), hk_string_chars(str2), str2->length);
 }
 
 bool hk_string_ends_with(hk_string_t *str1, hk_string_t *str2)
 {
   if (!str1->length || !str2->length || str1->length < str2->length)
     return false;
-  return !memcmp(&str1->chars[str1->length - str2->length], str2->chars, str2->length);
+  return !memcmp(&hk_string_chars(str1)[str1->length - str2->length], hk_string_chars(str2),
+    str2->length);
 }
 
 hk_string_t *hk_string_reverse(hk_string_t *str)
 {
   int32_t length = str->length;
+  char *chars = hk_string_chars(str);
   hk_string_t *result = string_allocate(length);
   result->length = length;
   for (int32_t i = 0; i < length; ++i)
-    result->chars[i] = str->chars[length - i - 1];
+    result->chars[i] = chars[length - i - 1];
   result->chars[length] = '\0';
   return result;
 }
 
 void hk_string_serialize(hk_string_t *str, FILE *stream)
 {
+  hk_string_flatten(str);
   fwrite(&str->capacity, sizeof(str->capacity), 1, stream);
   fwrite(&str->length, sizeof(str->length), 1, stream);
   fwrite(str->chars, str->length + 1, 1, stream);
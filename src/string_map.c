@@ -36,7 +36,7 @@ static inline void grow(string_map_t *map)
     entries[key->hash & mask] = map->entries[i];
     ++j;
   }
-  free(map->entries);
+  hk_free(map->entries);
   map->entries = entries;
   map->capacity = capacity;
   map->mask = mask;
@@ -65,7 +65,7 @@ void string_map_free(string_map_t *map)
     hk_value_release(entry->value);
     ++j;
   }
-  free(map->entries);
+  hk_free(map->entries);
 }
 
 string_map_entry_t *string_map_get_entry(string_map_t *map, hk_string_t *key)
@@ -8,14 +8,19 @@
 #include <string.h>
 #include <hook/string.h>
 #include <hook/memory.h>
+#include "gc.h"
 
 static inline hk_field_t **allocate_table(int32_t capacity);
 static inline hk_field_t *add_field(hk_struct_t *ztruct, hk_string_t *name);
 static inline void grow(hk_struct_t *ztruct);
+static inline hk_instance_t *instance_allocate(hk_struct_t *ztruct);
+static inline bool recycle_instance(hk_instance_t *inst);
+static inline void free_pool(hk_struct_t *ztruct);
 
 static inline hk_field_t **allocate_table(int32_t capacity)
 {
   hk_field_t **table = (hk_field_t **) hk_allocate(sizeof(*table) * capacity);
+  hk_memory_tag(table, HK_TYPE_STRUCT);
   for (int32_t i = 0; i < capacity; ++i)
     table[i] = NULL;
   return table;
@@ -43,7 +48,7 @@ static inline void grow(hk_struct_t *ztruct)
   ztruct->fields = (hk_field_t *) hk_reallocate(ztruct->fields,
     sizeof(*ztruct->fields) * capacity);
   hk_field_t **table = allocate_table(capacity);
-  free(ztruct->table);
+  hk_free(ztruct->table);
   ztruct->table = table;
   hk_field_t *fields = ztruct->fields;
   for (int32_t i = 0; i < length; i++)
@@ -56,6 +61,41 @@ static inline void grow(hk_struct_t *ztruct)
   }
 }
 
+static inline hk_instance_t *instance_allocate(hk_struct_t *ztruct)
+{
+  if (ztruct->pool_length)
+  {
+    --ztruct->pool_length;
+    return ztruct->pool[ztruct->pool_length];
+  }
+  int32_t size = sizeof(hk_instance_t) + sizeof(hk_value_t) * (ztruct->length - 1);
+  hk_instance_t *inst = (hk_instance_t *) hk_allocate(size);
+  hk_memory_tag(inst, HK_TYPE_INSTANCE | HK_MEMORY_OBJECT);
+  return inst;
+}
+
+static inline bool recycle_instance(hk_instance_t *inst)
+{
+  hk_struct_t *ztruct = inst->ztruct;
+  if (ztruct->pool_length == STRUCT_POOL_CAPACITY)
+    return false;
+  if (!ztruct->pool)
+  {
+    ztruct->pool = (hk_instance_t **) hk_allocate(sizeof(*ztruct->pool) * STRUCT_POOL_CAPACITY);
+    hk_memory_tag(ztruct->pool, HK_TYPE_STRUCT);
+  }
+  ztruct->pool[ztruct->pool_length] = inst;
+  ++ztruct->pool_length;
+  return true;
+}
+
+static inline void free_pool(hk_struct_t *ztruct)
+{
+  for (int32_t i = 0; i < ztruct->pool_length; ++i)
+    hk_free(ztruct->pool[i]);
+  ztruct->pool_length = 0;
+}
+
 hk_struct_t *hk_struct_new(hk_string_t *name)
 {
   int32_t capacity = STRUCT_MIN_CAPACITY;
@@ -69,6 +109,10 @@ hk_struct_t *hk_struct_new(hk_string_t *name)
   ztruct->name = name;
   ztruct->fields = (hk_field_t *) hk_allocate(sizeof(*ztruct->fields) * capacity);
   ztruct->table = allocate_table(capacity);
+  ztruct->pool_length = 0;
+  ztruct->pool = NULL;
+  hk_memory_tag(ztruct, HK_TYPE_STRUCT | HK_MEMORY_OBJECT);
+  hk_memory_tag(ztruct->fields, HK_TYPE_STRUCT);
   return ztruct;
 }
 
@@ -80,9 +124,11 @@ void hk_struct_free(hk_struct_t *ztruct)
   hk_field_t *fields = ztruct->fields;
   for (int32_t i = 0; i < ztruct->length; ++i)
     hk_string_release(fields[i].name);
-  free(ztruct->fields);
-  free(ztruct->table);
-  free(ztruct);
+  hk_free(ztruct->fields);
+  hk_free(ztruct->table);
+  free_pool(ztruct);
+  hk_free(ztruct->pool);
+  hk_free(ztruct);
 }
 
 void hk_struct_release(hk_struct_t *ztruct)
@@ -122,6 +168,7 @@ bool hk_struct_define_field(hk_struct_t *ztruct, hk_string_t *name)
     {
       table[i] = add_field(ztruct, name);
       grow(ztruct);
+      free_pool(ztruct);
       return true;
     }
     if (hk_string_equal(name, field->name))
@@ -145,9 +192,9 @@ bool hk_struct_equal(hk_struct_t *ztruct1, hk_struct_t *ztruct2)
 
 hk_instance_t *hk_instance_new(hk_struct_t *ztruct)
 {
-  int32_t size = sizeof(hk_instance_t) + sizeof(hk_value_t) * (ztruct->length - 1);
-  hk_instance_t *inst = (hk_instance_t *) hk_allocate(size);
+  hk_instance_t *inst = instance_allocate(ztruct);
   inst->ref_count = 0;
+  inst->gc_flags = 0;
   hk_incr_ref(ztruct);
   inst->ztruct = ztruct;
   return inst;
@@ -157,17 +204,22 @@ void hk_instance_free(hk_instance_t *inst)
 {
   hk_struct_t *ztruct = inst->ztruct;
   int32_t length = ztruct->length;
-  hk_struct_release(ztruct);
   for (int32_t i = 0; i < length; ++i)
     hk_value_release(inst->values[i]);
-  free(inst);
+  if (!gc_is_buffered(inst) && !recycle_instance(inst))
+    hk_free(inst);
+  hk_struct_release(ztruct);
 }
 
 void hk_instance_release(hk_instance_t *inst)
 {
   hk_decr_ref(inst);
   if (hk_is_unreachable(inst))
+  {
     hk_instance_free(inst);
+    return;
+  }
+  gc_possible_root(hk_instance_value(inst));
 }
 
 hk_instance_t *hk_instance_set_field(hk_instance_t *inst, int32_t index, hk_value_t value)
@@ -4,17 +4,23 @@
 //
 
 #include <hook/userdata.h>
-#include <stdlib.h>
+#include <hook/memory.h>
+#include "gc.h"
 
 void hk_userdata_init(hk_userdata_t *udata, void (*deinit)(struct hk_userdata *))
 {
+  hk_memory_tag(udata, HK_TYPE_USERDATA | HK_MEMORY_OBJECT);
   udata->ref_count = 0;
+  udata->gc_flags = 0;
   udata->deinit = deinit;
+  udata->traverse = NULL;
 }
 
 void hk_userdata_free(hk_userdata_t *udata)
 {
   if (udata->deinit)
     udata->deinit(udata);
-  free(udata);
+  if (gc_is_buffered(udata))
+    return;
+  hk_free(udata);
 }
@@ -12,10 +12,11 @@
 #include <hook/status.h>
 #include <hook/error.h>
 #include <hook/utils.h>
+#include "gc.h"
 
 void hk_value_free(hk_value_t val)
 {
-  switch (val.type)
+  switch (hk_type(val))
   {
   case HK_TYPE_NIL:
   case HK_TYPE_BOOL:
@@ -103,12 +104,16 @@ void hk_value_release(hk_value_t val)
   hk_object_t *obj = hk_as_object(val);
   hk_decr_ref(obj);
   if (hk_is_unreachable(obj))
+  {
     hk_value_free(val);
+    return;
+  }
+  gc_possible_root(val);
 }
 
 void hk_value_print(hk_value_t val, bool quoted)
 {
-  switch (val.type)
+  switch (hk_type(val))
   {
   case HK_TYPE_NIL:
     printf("nil");
@@ -133,41 +138,42 @@ void hk_value_print(hk_value_t val, bool quoted)
       hk_string_t *name = hk_as_struct(val)->name;
       if (name)
       {
-        printf("<struct %.*s at %p>", name->length, name->chars, val.as.pointer_value);
+        printf("<struct %.*s at %p>", name->length, hk_string_chars(name),
+          (void *) hk_as_object(val));
         break;
       }
-      printf("<struct at %p>", val.as.pointer_value);
+      printf("<struct at %p>", (void *) hk_as_object(val));
     }
     break;
   case HK_TYPE_INSTANCE:
     hk_instance_print(hk_as_instance(val));
     break;
   case HK_TYPE_ITERATOR:
-    printf("<iterator at %p>", val.as.pointer_value);
+    printf("<iterator at %p>", (void *) hk_as_object(val));
     break;
   case HK_TYPE_CALLABLE:
     {
       hk_string_t *name = hk_is_native(val) ? hk_as_native(val)->name : hk_as_closure(val)->fn->name;
       if (name)
       {
-        printf("<callable %.*s at %p>", name->length, name->chars, val.as.pointer_value);
+        printf("<callable %.*s at %p>", name->length, name->chars, (void *) hk_as_object(val));
         break;
       }
-      printf("<callable at %p>", val.as.pointer_value);
+      printf("<callable at %p>", (void *) hk_as_object(val));
     }
     break;
   case HK_TYPE_USERDATA:
-    printf("<userdata at %p>", val.as.pointer_value);
+    printf("<userdata at %p>", (void *) hk_as_object(val));
     break;
   }
 }
 
 bool hk_value_equal(hk_value_t val1, hk_value_t val2)
 {
-  if (val1.type != val2.type)
+  if (hk_type(val1) != hk_type(val2))
     return false;
   bool result = true;
-  switch (val1.type)
+  switch (hk_type(val1))
   {
   case HK_TYPE_NIL:
     break;
@@ -193,7 +199,7 @@ bool hk_value_equal(hk_value_t val1, hk_value_t val2)
     result = hk_instance_equal(hk_as_instance(val1), hk_as_instance(val2));
     break;
   default:
-    result = val1.as.pointer_value == val2.as.pointer_value;
+    result = hk_as_object(val1) == hk_as_object(val2);
     break;
   }
   return result;
@@ -201,9 +207,9 @@ bool hk_value_equal(hk_value_t val1, hk_value_t val2)
 
 bool hk_value_compare(hk_value_t val1, hk_value_t val2, int32_t *result)
 {
-  if (val1.type != val2.type)
+  if (hk_type(val1) != hk_type(val2))
     return false;
-  switch (val1.type)
+  switch (hk_type(val1))
   {
   case HK_TYPE_NIL:
     *result = 0;
@@ -240,13 +246,14 @@ bool hk_value_compare(hk_value_t val1, hk_value_t val2, int32_t *result)
 
 void hk_value_serialize(hk_value_t val, FILE *stream)
 {
-  hk_type_t type = val.type;
-  int32_t flags = val.flags;
+  hk_type_t type = hk_type(val);
+  int32_t flags = hk_flags(val);
   fwrite(&type, sizeof(type), 1, stream);
   fwrite(&flags, sizeof(flags), 1, stream);
   if (type == HK_TYPE_NUMBER)
   {
-    fwrite(&val.as.number_value, sizeof(val.as.number_value), 1, stream);
+    double data = hk_as_number(val);
+    fwrite(&data, sizeof(data), 1, stream);
     return;
   }
   if (type == HK_TYPE_STRING)
@@ -277,6 +284,9 @@ bool hk_value_deserialize(FILE *stream, hk_value_t *result)
   hk_string_t *str = hk_string_deserialize(stream);
   if (!str)
     return false;
-  *result = hk_string_value(str);
+  hk_string_t *interned = hk_string_intern(str);
+  if (interned != str)
+    hk_string_free(str);
+  *result = hk_string_value(interned);
   return true;
 }